@@ -0,0 +1,245 @@
+#include <cmath>
+#include <complex>
+#include <limits>
+#include "audiocheck.h"
+
+namespace {
+
+// Окно спектра: 93 мс при 44100 Гц, полоса ~11 Гц
+const int windowFrames = 4096;
+// Окна, в которых эталон тише этого (СКЗ), не анализируются
+const qreal silentRms = 1.0e-4;
+// Полосы вокруг гармоники, которые относятся к ней (главный лепесток окна
+// Блэкмана-Харриса - 4 полосы, боковые ниже -92 дБ)
+const int harmonicBins = 6;
+// Паразитные составляющие ниже этого уровня - шум вычислений, они не сравниваются
+const qreal floorLimitDb = -120.0;
+// Окрестность события, в которой ищется щелчок (атака и затухание огибающей)
+const int clickBefore = 64;
+const int clickAfter = 512;
+// Скачок меньше этого не считается щелчком при любом эталоне
+const qreal clickFloor = 1.0e-3;
+
+typedef std::complex<double> Complex;
+
+// Быстрое преобразование Фурье по основанию 2 на месте
+void fft(QVector<Complex> &data)
+{
+    const int n = data.size();
+    for (int i = 1, j = 0; i < n; ++i) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(data[i], data[j]);
+        }
+    }
+    for (int length = 2; length <= n; length <<= 1) {
+        const double angle = -2.0 * M_PI / length;
+        const Complex step(std::cos(angle), std::sin(angle));
+        for (int start = 0; start < n; start += length) {
+            Complex w(1.0, 0.0);
+            for (int k = 0; k < length / 2; ++k) {
+                const Complex a = data[start + k];
+                const Complex b = data[start + k + length / 2] * w;
+                data[start + k] = a + b;
+                data[start + k + length / 2] = a - b;
+                w *= step;
+            }
+        }
+    }
+}
+
+struct WindowAnalysis
+{
+    bool sounding;
+    qreal frequency; // Самая сильная составляющая, Гц
+    qreal floorDb; // Сильнейшая составляющая вне ее гармоник относительно нее
+};
+
+WindowAnalysis analyze(const float *data, int frames, int sampleRate)
+{
+    WindowAnalysis result = {false, 0.0, floorLimitDb};
+    double energy = 0.0;
+    for (int i = 0; i < frames; ++i) {
+        energy += double(data[i]) * data[i];
+    }
+    if (std::sqrt(energy / frames) < silentRms) {
+        return result;
+    }
+    result.sounding = true;
+
+    // Амплитудный спектр с окном Блэкмана-Харриса
+    QVector<Complex> bins(frames);
+    for (int i = 0; i < frames; ++i) {
+        const double phase = 2.0 * M_PI * i / frames;
+        const double window = 0.35875 - 0.48829 * std::cos(phase) + 0.14128 * std::cos(2.0 * phase)
+                              - 0.01168 * std::cos(3.0 * phase);
+        bins[i] = Complex(data[i] * window, 0.0);
+    }
+    fft(bins);
+    const int half = frames / 2;
+    QVector<double> magnitude(half);
+    int peak = 1;
+    for (int i = 0; i < half; ++i) {
+        magnitude[i] = std::abs(bins.at(i));
+        if (i > 0 && magnitude.at(i) > magnitude.at(peak)) {
+            peak = i;
+        }
+    }
+    // Положение пика между полосами - по параболе через логарифмы соседних полос
+    double offset = 0.0;
+    if (peak + 1 < half) {
+        const double a = std::log(magnitude.at(peak - 1) + 1e-30);
+        const double b = std::log(magnitude.at(peak) + 1e-30);
+        const double c = std::log(magnitude.at(peak + 1) + 1e-30);
+        const double denominator = a - 2.0 * b + c;
+        offset = (denominator != 0.0) ? 0.5 * (a - c) / denominator : 0.0;
+    }
+    const double peakBin = peak + offset;
+    result.frequency = peakBin * sampleRate / frames;
+
+    double floor = 0.0;
+    for (int i = 1; i < half; ++i) {
+        const double harmonic = std::max(1.0, std::round(i / peakBin));
+        if (std::fabs(i - harmonic * peakBin) > harmonicBins) {
+            floor = std::max(floor, magnitude.at(i));
+        }
+    }
+    if (floor > 0.0) {
+        result.floorDb = std::max(floorLimitDb, 20.0 * std::log10(floor / magnitude.at(peak)));
+    }
+    return result;
+}
+
+// Наибольшая вторая разность на отрезке [from, to): мера разрыва сигнала
+double jump(const QVector<float> &data, qint64 from, qint64 to)
+{
+    double result = 0.0;
+    for (qint64 i = qMax<qint64>(2, from); i < to; ++i) {
+        const double d = double(data.at(int(i))) - 2.0 * data.at(int(i - 1)) + data.at(int(i - 2));
+        result = std::max(result, std::fabs(d));
+    }
+    return result;
+}
+
+} // namespace
+
+AudioCheck::Tolerances AudioCheck::defaultTolerances()
+{
+    // Ошибка ~ -80 дБ: допускает другой порядок сложения (SIMD, потоки),
+    // но не другой алгоритм
+    return {1.0e-4f, 90.0, 1.0, 3.0, 2.0};
+}
+
+AudioCheck::Report AudioCheck::compare(const QVector<float> &output,
+                                       const QVector<float> &reference,
+                                       int sampleRate,
+                                       const QVector<quint64> &eventFrames,
+                                       const Tolerances &tolerances)
+{
+    Report report;
+    report.frames = qMin(output.size(), reference.size());
+    report.maxError = 0.0f;
+    report.maxErrorFrame = 0;
+    report.windows = 0;
+    report.maxCents = 0.0;
+    report.floorDb = floorLimitDb;
+    report.referenceFloorDb = floorLimitDb;
+    report.events = 0;
+    report.clicks = 0;
+    if (output.size() != reference.size()) {
+        report.failures << QString("length %1 frames, reference %2").arg(output.size()).arg(reference.size());
+    }
+
+    // Поточечная разница
+    double signal = 0.0;
+    double noise = 0.0;
+    for (int i = 0; i < report.frames; ++i) {
+        const float error = std::fabs(output.at(i) - reference.at(i));
+        if (error > report.maxError) {
+            report.maxError = error;
+            report.maxErrorFrame = i;
+        }
+        signal += double(reference.at(i)) * reference.at(i);
+        noise += double(error) * error;
+    }
+    report.snrDb = (noise > 0.0) ? 10.0 * std::log10(signal / noise) : std::numeric_limits<qreal>::infinity();
+    if (report.maxError > tolerances.maxError) {
+        report.failures << QString("max error %1 at frame %2 (limit %3)")
+                               .arg(report.maxError)
+                               .arg(report.maxErrorFrame)
+                               .arg(tolerances.maxError);
+    }
+    if (report.snrDb < tolerances.minSnrDb) {
+        report.failures << QString("SNR %1 dB (limit %2 dB)").arg(report.snrDb, 0, 'f', 1).arg(tolerances.minSnrDb);
+    }
+
+    // Спектр по окнам, в которых эталон звучит
+    qreal worstExcess = -std::numeric_limits<qreal>::infinity();
+    qint64 worstFloorFrame = -1;
+    qint64 worstCentsFrame = -1;
+    for (int pos = 0; pos + windowFrames <= report.frames; pos += windowFrames) {
+        const WindowAnalysis expected = analyze(reference.constData() + pos, windowFrames, sampleRate);
+        if (!expected.sounding) {
+            continue;
+        }
+        const WindowAnalysis actual = analyze(output.constData() + pos, windowFrames, sampleRate);
+        report.windows++;
+        const qreal cents = (actual.frequency > 0.0)
+                                ? std::fabs(1200.0 * std::log2(actual.frequency / expected.frequency))
+                                : std::numeric_limits<qreal>::infinity();
+        if (cents > report.maxCents) {
+            report.maxCents = cents;
+            worstCentsFrame = pos;
+        }
+        const qreal excess = actual.floorDb - expected.floorDb;
+        if (excess > worstExcess) {
+            worstExcess = excess;
+            worstFloorFrame = pos;
+            report.floorDb = actual.floorDb;
+            report.referenceFloorDb = expected.floorDb;
+        }
+    }
+    if (report.maxCents > tolerances.maxCents) {
+        report.failures << QString("dominant frequency off by %1 cents at frame %2 (limit %3)")
+                               .arg(report.maxCents, 0, 'f', 2)
+                               .arg(worstCentsFrame)
+                               .arg(tolerances.maxCents);
+    }
+    if (report.floorDb > floorLimitDb && report.floorDb > report.referenceFloorDb + tolerances.floorMarginDb) {
+        report.failures << QString("spurious floor %1 dB at frame %2, reference %3 dB")
+                               .arg(report.floorDb, 0, 'f', 1)
+                               .arg(worstFloorFrame)
+                               .arg(report.referenceFloorDb, 0, 'f', 1);
+    }
+
+    // Щелчки: скачок около события заметно больше эталонного
+    QStringList clickFrames;
+    for (quint64 frame : eventFrames) {
+        if (qint64(frame) >= report.frames) {
+            continue;
+        }
+        const qint64 from = qint64(frame) - clickBefore;
+        const qint64 to = qMin(report.frames, qint64(frame) + clickAfter);
+        const double actual = jump(output, from, to);
+        const double expected = jump(reference, from, to);
+        report.events++;
+        if (actual > clickFloor && actual > expected * tolerances.clickRatio) {
+            report.clicks++;
+            clickFrames << QString::number(frame);
+        }
+    }
+    if (report.clicks > 0) {
+        report.failures << QString("clicks near events at frames %1").arg(clickFrames.join(", "));
+    }
+    return report;
+}
+
+qreal AudioCheck::dominantFrequency(const float *data, int frames, int sampleRate)
+{
+    const WindowAnalysis analysis = analyze(data, frames, sampleRate);
+    return analysis.sounding ? analysis.frequency : 0.0;
+}
@@ -0,0 +1,60 @@
+#ifndef AUDIOCHECK_H
+#define AUDIOCHECK_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QtGlobal>
+
+// Сравнение сгенерированного звука с эталонной записью (minisynth-render
+// --compare): оптимизация генерации не должна менять звук. Кроме поточечной
+// разницы (наибольшая ошибка и отношение сигнал/шум) проверяются свойства,
+// которые разница плохо показывает: частота основного тона и уровень
+// паразитных составляющих (отражений) по окнам спектра, щелчки около
+// включений и выключений нот
+namespace AudioCheck {
+
+struct Tolerances
+{
+    float maxError; // Наибольшая разница сэмплов
+    qreal minSnrDb; // Эталон к разнице
+    qreal maxCents; // Отклонение основного тона в окне
+    qreal floorMarginDb; // Превышение паразитных составляющих над эталоном
+    qreal clickRatio; // Во сколько раз скачок у события может превысить эталонный
+};
+
+struct Report
+{
+    qint64 frames;
+    float maxError;
+    qint64 maxErrorFrame;
+    qreal snrDb; // Бесконечность - совпадение
+    int windows; // Окна спектра со звуком
+    qreal maxCents;
+    qreal floorDb; // Худшее окно: паразитные составляющие относительно основного тона
+    qreal referenceFloorDb; // Эталон в том же окне
+    int events; // Проверенные включения и выключения нот
+    int clicks;
+    QStringList failures; // Пусто - эталон совпал
+
+    bool passed() const { return failures.isEmpty(); }
+};
+
+Tolerances defaultTolerances();
+
+// eventFrames - сэмплы включений и выключений нот (окрестности проверяются на щелчки).
+// Уровень паразитных составляющих считается вне гармоник самой сильной
+// составляющей, поэтому отражения видны в сценариях из отдельных нот, а не аккордов
+Report compare(const QVector<float> &output,
+               const QVector<float> &reference,
+               int sampleRate,
+               const QVector<quint64> &eventFrames,
+               const Tolerances &tolerances);
+
+// Частота самой сильной составляющей окна в Гц (интерполяция по соседним
+// полосам), 0 - тишина. frames - степень двойки
+qreal dominantFrequency(const float *data, int frames, int sampleRate);
+
+} // namespace AudioCheck
+
+#endif // AUDIOCHECK_H
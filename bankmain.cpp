@@ -0,0 +1,129 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+
+#include "soundbank.h" // Банк таблиц и сэмплов
+#include "wavfile.h" // Чтение исходных файлов
+
+// Сборка банка волновых таблиц и сэмплов из WAV-файлов и просмотр готового банка.
+// Таблица - файл с одним периодом волны любой длины; сэмпл - файл целиком
+// (многоканальный сводится в моно)
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("minisynth-bank");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Sound bank builder for the minimal synthesizer");
+    parser.addHelpOption();
+    parser.addPositionalArgument("bank", "Bank file to write (or to print with --list).");
+    QCommandLineOption wavetableOption("wavetable",
+                                       "Add a wavetable from a single-cycle WAV file.",
+                                       "name=file");
+    QCommandLineOption sampleOption("sample",
+                                    "Add a sample: root note (default 60) and loop points "
+                                    "in frames (default: no loop).",
+                                    "name=file[,root[,start,end]]");
+    QCommandLineOption listOption("list", "Print the entries of an existing bank.");
+    parser.addOptions({wavetableOption, sampleOption, listOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 1) {
+        parser.showHelp(1);
+    }
+    QString error;
+
+    if (parser.isSet(listOption)) {
+        SoundBank bank;
+        if (!bank.open(args.at(0), &error)) {
+            err << error << Qt::endl;
+            return 1;
+        }
+        for (int i = 0; i < bank.count(); ++i) {
+            const SoundBank::Entry &entry = bank.entry(i);
+            out << SoundBank::kindName(entry.kind) << " " << entry.name;
+            if (entry.kind == SoundBank::Kind::sample) {
+                out << ": " << entry.frames << " frames, " << entry.sampleRate << " Hz, root "
+                    << entry.rootNote;
+                if (entry.loopEnd != 0) {
+                    out << ", loop " << entry.loopStart << "-" << entry.loopEnd;
+                }
+            }
+            out << Qt::endl;
+        }
+        return 0;
+    }
+
+    // Имя записи и остальная часть значения опции
+    auto split = [&](const QString &value, QString *name, QStringList *fields) {
+        const int equals = value.indexOf('=');
+        if (equals <= 0) {
+            err << "expected name=file, got '" << value << "'" << Qt::endl;
+            return false;
+        }
+        *name = value.left(equals);
+        *fields = value.mid(equals + 1).split(',');
+        return true;
+    };
+
+    SoundBankWriter writer;
+    for (const QString &value : parser.values(wavetableOption)) {
+        QString name;
+        QStringList fields;
+        WavFileReader wav;
+        if (!split(value, &name, &fields)) {
+            return 1;
+        }
+        if (!wav.load(fields.at(0), &error)) {
+            err << error << Qt::endl;
+            return 1;
+        }
+        const QVector<float> cycle = wav.mono();
+        if (cycle.size() < 4) {
+            err << fields.at(0) << ": a wavetable cycle needs at least 4 frames" << Qt::endl;
+            return 1;
+        }
+        writer.addWavetable(name, cycle.constData(), cycle.size());
+    }
+    for (const QString &value : parser.values(sampleOption)) {
+        QString name;
+        QStringList fields;
+        WavFileReader wav;
+        if (!split(value, &name, &fields)) {
+            return 1;
+        }
+        if (!wav.load(fields.at(0), &error)) {
+            err << error << Qt::endl;
+            return 1;
+        }
+        const QVector<float> samples = wav.mono();
+        bool ok = true;
+        const int root = (fields.size() > 1) ? fields.at(1).toInt(&ok) : 60;
+        quint32 loopStart = 0;
+        quint32 loopEnd = 0;
+        if (ok && fields.size() > 3) {
+            loopStart = fields.at(2).toUInt(&ok);
+            loopEnd = ok ? fields.at(3).toUInt(&ok) : 0;
+        }
+        if (!ok || root < 0 || root > 127 || samples.isEmpty() || loopEnd > quint32(samples.size())
+            || (loopEnd != 0 && loopStart >= loopEnd)) {
+            err << "bad sample '" << value << "'" << Qt::endl;
+            return 1;
+        }
+        writer.addSample(name, samples.constData(), quint32(samples.size()), wav.sampleRate(), root, loopStart, loopEnd);
+    }
+    if (writer.count() == 0) {
+        err << "nothing to write: add --wavetable or --sample entries" << Qt::endl;
+        return 1;
+    }
+    if (!writer.write(args.at(0), &error)) {
+        err << error << Qt::endl;
+        return 1;
+    }
+    out << "wrote " << writer.count() << " entries to " << args.at(0) << Qt::endl;
+    return 0;
+}
@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QVector>
+
+#include <QAudioFormat>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define BENCH_HAVE_TSC 1
+#endif
+
+#include "tonesynth.h" // Синтезатор
+
+// Подсчет выделений памяти: на пути генерации звука выделений быть не должно.
+// Контейнеры Qt (QArrayData) выделяют память прямо через malloc/realloc, поэтому
+// с glibc считается семейство malloc (подмена поверх __libc_malloc), а operator
+// new попадает в счет через malloc. На других системах считаются только
+// глобальные operator new
+namespace {
+std::atomic<quint64> g_allocations(0);
+}
+
+#if defined(__GLIBC__)
+#define BENCH_COUNT_MALLOC 1
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *p, size_t size);
+
+void *malloc(size_t size) noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *p, size_t size) noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(p, size);
+}
+}
+#endif
+
+void *operator new(std::size_t size)
+{
+#if !defined(BENCH_COUNT_MALLOC)
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+#endif
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+// Сценарии нагрузки
+enum class Scenario : int { silence, sustain, transitions, voices };
+
+const char *scenarioName(Scenario scenario)
+{
+    switch (scenario) {
+    case Scenario::silence:
+        return "silence";
+    case Scenario::sustain:
+        return "sustain";
+    case Scenario::transitions:
+        return "transitions";
+    case Scenario::voices:
+        return "voices";
+    }
+    return "";
+}
+
+// Строка JSON в кавычках: кавычки, обратная косая черта и управляющие символы
+// экранируются (метка задается пользователем)
+QString jsonString(const QString &text)
+{
+    QString result = "\"";
+    for (const QChar c : text) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (c == '\n') {
+            result += "\\n";
+        } else if (c == '\t') {
+            result += "\\t";
+        } else if (c.unicode() < 0x20) {
+            result += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+        } else {
+            result += c;
+        }
+    }
+    return result + '"';
+}
+
+// Поле CSV (RFC 4180): поле с запятой, кавычкой или переводом строки
+// берется в кавычки, кавычки внутри удваиваются
+QString csvField(const QString &text)
+{
+    if (!text.contains(',') && !text.contains('"') && !text.contains('\n') && !text.contains('\r')) {
+        return text;
+    }
+    QString result = text;
+    result.replace("\"", "\"\"");
+    return '"' + result + '"';
+}
+
+quint64 readCycles()
+{
+#if defined(BENCH_HAVE_TSC)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+SynthEvent noteEvent(SynthEvent::Type type, int note)
+{
+    SynthEvent event;
+    event.frame = 0; // Применяется в начале следующего вызова
+    event.type = type;
+    event.note = quint8(note);
+    event.value = 1.0f;
+    return event;
+}
+
+struct Result
+{
+    qint64 calls;
+    qreal nsPerSample;
+    qreal cyclesPerSample;
+    qreal allocationsPerCall;
+    int voices;
+};
+
+// Один замер: лучший из нескольких повторов (наименее зашумленный)
+Result measure(const QAudioFormat &format,
+               int threads,
+               int oversampling,
+               const QString &effects,
+               Scenario scenario,
+               int frames,
+               qint64 budgetNs)
+{
+    ToneSynthesizer synth(format);
+    synth.setRenderThreads(threads);
+    synth.setOversampling(oversampling);
+    synth.effects().parseChain(effects);
+    synth.start();
+    const qint64 bytes = qint64(frames) * format.bytesPerFrame();
+    QVector<float> buffer(int((bytes + qint64(sizeof(float)) - 1) / qint64(sizeof(float))));
+    char *data = reinterpret_cast<char *>(buffer.data());
+
+    switch (scenario) {
+    case Scenario::silence:
+        break;
+    case Scenario::sustain:
+        synth.postEvent(noteEvent(SynthEvent::Type::noteOn, 69));
+        break;
+    case Scenario::transitions:
+        break;
+    case Scenario::voices:
+        for (int i = 0; i < ToneSynthesizer::MaxVoices; ++i) {
+            synth.postEvent(noteEvent(SynthEvent::Type::noteOn, 36 + i));
+        }
+        break;
+    }
+    // Прогрев: атака завершается, кэши заполняются
+    for (int i = 0; i < 64; ++i) {
+        synth.read(data, bytes);
+    }
+
+    Result best{0, 0.0, 0.0, 0.0, synth.activeVoices()};
+    bool noteDown = false;
+    for (int repetition = 0; repetition < 5; ++repetition) {
+        qint64 calls = 0;
+        qint64 elapsed = 0;
+        quint64 cycles = 0;
+        const quint64 allocationsBefore = g_allocations.load(std::memory_order_relaxed);
+        QElapsedTimer timer;
+        timer.start();
+        while (elapsed < budgetNs / 5) {
+            if (scenario == Scenario::transitions) {
+                // Каждый вызов начинается с атаки или затухания
+                noteDown = !noteDown;
+                synth.postEvent(noteEvent(noteDown ? SynthEvent::Type::noteOn
+                                                   : SynthEvent::Type::noteOff,
+                                          69));
+            }
+            const quint64 c0 = readCycles();
+            synth.read(data, bytes);
+            cycles += readCycles() - c0;
+            calls++;
+            elapsed = timer.nsecsElapsed();
+        }
+        const quint64 allocations = g_allocations.load(std::memory_order_relaxed)
+                                    - allocationsBefore;
+        const qreal samples = qreal(calls) * frames;
+        const qreal nsPerSample = elapsed / samples;
+        if (best.calls == 0 || nsPerSample < best.nsPerSample) {
+            best.calls = calls;
+            best.nsPerSample = nsPerSample;
+            best.cyclesPerSample = cycles / samples;
+            best.allocationsPerCall = qreal(allocations) / calls;
+        }
+    }
+    synth.stop();
+    return best;
+}
+
+} // namespace
+
+// Микротесты производительности readData(): время и такты на сэмпл, выделения
+// памяти на вызов. Вывод - CSV или JSON Lines для сравнения между коммитами
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("minisynth-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Synthesis hot path microbenchmarks");
+    parser.addHelpOption();
+    QCommandLineOption jsonOption("json", "Print JSON Lines instead of CSV.");
+    QCommandLineOption timeOption({"t", "time"}, "Measurement time per case.", "ms", "300");
+    QCommandLineOption labelOption({"l", "label"}, "Label column (e.g. commit id).", "text");
+    QCommandLineOption rateOption({"r", "rate"}, "Sample rate in Hz.", "hz", "44100");
+    QCommandLineOption formatOption({"f", "format"}, "Output sample format: float, int16, int32.", "name", "float");
+    QCommandLineOption channelsOption({"c", "channels"}, "Output channels (1-8).", "n", "1");
+    QCommandLineOption threadsOption({"j", "threads"}, "Voice rendering threads (1 = serial).", "n", "1");
+    QCommandLineOption effectsOption("fx", "Effect chain after the mixer (see minisynth-render).", "chain");
+    QCommandLineOption oversampleOption("oversample",
+                                        "Voice oversampling factors to measure, e.g. 1,2,4.",
+                                        "list",
+                                        "1");
+    parser.addOptions({jsonOption, timeOption, labelOption, rateOption, formatOption, channelsOption, threadsOption,
+                       effectsOption, oversampleOption});
+    parser.process(app);
+
+    const bool json = parser.isSet(jsonOption);
+    const qint64 budgetNs = qMax(1, parser.value(timeOption).toInt()) * 1000000ll;
+    const QString label = parser.value(labelOption);
+
+    const QString formatName = parser.value(formatOption);
+    RenderKernels::SampleFormat sampleFormat = RenderKernels::SampleFormat::float32;
+    if (formatName == "int16") {
+        sampleFormat = RenderKernels::SampleFormat::int16;
+    } else if (formatName == "int32") {
+        sampleFormat = RenderKernels::SampleFormat::int32;
+    } else if (formatName != "float") {
+        parser.showHelp(1);
+    }
+    const int channels = qBound(1, parser.value(channelsOption).toInt(), int(ToneSynthesizer::MaxChannels));
+    const int threads = qMax(1, parser.value(threadsOption).toInt());
+    const QString effects = parser.value(effectsOption);
+    // Цена каждой кратности передискретизации - отдельные строки результата
+    QVector<int> oversamplings;
+    for (const QString &value : parser.value(oversampleOption).split(',')) {
+        const int factor = value.toInt();
+        if (factor != 1 && factor != 2 && factor != 4) {
+            parser.showHelp(1);
+        }
+        oversamplings.append(factor);
+    }
+    {
+        EffectGraph graph;
+        QString error;
+        if (!graph.parseChain(effects, &error)) {
+            QTextStream(stderr) << error << Qt::endl;
+            return 1;
+        }
+    }
+    const QAudioFormat format = ToneSynthesizer::makeFormat(qMax(1, parser.value(rateOption).toInt()),
+                                                            channels,
+                                                            sampleFormat);
+
+    QTextStream out(stdout);
+    if (!json) {
+        out << "label,kernel,format,channels,threads,oversample,scenario,frames,voices,calls,ns_per_sample,"
+               "cycles_per_sample,allocs_per_call"
+            << Qt::endl;
+    }
+    const Scenario scenarios[] = {Scenario::silence,
+                                  Scenario::sustain,
+                                  Scenario::transitions,
+                                  Scenario::voices};
+    for (int oversampling : oversamplings) {
+        for (Scenario scenario : scenarios) {
+            for (int frames = 64; frames <= 8192; frames *= 2) {
+                const Result r = measure(format, threads, oversampling, effects, scenario, frames, budgetNs);
+                if (json) {
+                    out << "{\"label\":" << jsonString(label) << ",\"kernel\":\""
+                        << RenderKernels::oscillatorName() << "\",\"format\":\"" << formatName
+                        << "\",\"channels\":" << channels << ",\"threads\":" << threads
+                        << ",\"oversample\":" << oversampling << ",\"scenario\":\""
+                        << scenarioName(scenario) << "\",\"frames\":" << frames
+                        << ",\"voices\":" << r.voices << ",\"calls\":" << r.calls
+                        << ",\"ns_per_sample\":" << r.nsPerSample
+                        << ",\"cycles_per_sample\":" << r.cyclesPerSample
+                        << ",\"allocs_per_call\":" << r.allocationsPerCall << "}" << Qt::endl;
+                } else {
+                    out << csvField(label) << ',' << RenderKernels::oscillatorName() << ',' << formatName << ','
+                        << channels << ',' << threads << ',' << oversampling << ',' << scenarioName(scenario) << ','
+                        << frames << ',' << r.voices << ','
+                        << r.calls << ',' << r.nsPerSample << ',' << r.cyclesPerSample << ','
+                        << r.allocationsPerCall << Qt::endl;
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "controlsocket.h"
+#include "notescript.h" // Команды
+
+namespace {
+// Наибольшая датаграмма команд
+const int datagramBytes = 4096;
+
+// Файл сокета остался от упавшего процесса: это сокет, но к нему никто
+// не привязан (подключение отклоняется). Сокет работающего экземпляра
+// и посторонние файлы не трогаются
+bool isStaleSocket(const sockaddr_un &address)
+{
+    struct stat info;
+    if (lstat(address.sun_path, &info) != 0 || !S_ISSOCK(info.st_mode)) {
+        return false;
+    }
+    const int probe = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (probe < 0) {
+        return false;
+    }
+    const bool refused = connect(probe, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0
+                         && errno == ECONNREFUSED;
+    ::close(probe);
+    return refused;
+}
+} // namespace
+
+ControlSocket::ControlSocket(ToneSynthesizer *synth, QObject *parent)
+    : MidiInput(synth, parent)
+    , m_socket(-1)
+    , m_badCommands(0)
+{}
+
+ControlSocket::~ControlSocket()
+{
+    stopInput();
+    if (m_socket >= 0) {
+        ::close(m_socket);
+        unlink(m_path.toLocal8Bit().constData());
+    }
+}
+
+bool ControlSocket::open(const QString &path, QString *error)
+{
+    const QByteArray file = path.toLocal8Bit();
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (size_t(file.size()) >= sizeof(address.sun_path)) {
+        if (error) {
+            *error = QString("socket path too long: %1").arg(path);
+        }
+        return false;
+    }
+    std::memcpy(address.sun_path, file.constData(), size_t(file.size()));
+    m_socket = socket(AF_UNIX, SOCK_DGRAM, 0);
+    auto bindSocket = [&]() {
+        return (bind(m_socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0) ? 0 : errno;
+    };
+    int failure = (m_socket < 0) ? errno : bindSocket();
+    if (failure == EADDRINUSE && isStaleSocket(address)) {
+        unlink(file.constData());
+        failure = bindSocket();
+    }
+    if (failure != 0) {
+        if (error) {
+            *error = (failure == EADDRINUSE)
+                         ? QString("socket name %1 is in use").arg(path)
+                         : QString("cannot create socket %1: %2").arg(path, QString::fromLocal8Bit(std::strerror(failure)));
+        }
+        if (m_socket >= 0) {
+            ::close(m_socket);
+            m_socket = -1;
+        }
+        return false;
+    }
+    m_path = path;
+    return true;
+}
+
+quint64 ControlSocket::badCommands() const
+{
+    return m_badCommands.load(std::memory_order_relaxed);
+}
+
+// Ожидание датаграмм с коротким тайм-аутом, как у входа ALSA: метка ставится
+// сразу после пробуждения, все команды датаграммы пришли одновременно
+void ControlSocket::run()
+{
+    if (m_socket < 0) {
+        return;
+    }
+    char buffer[datagramBytes];
+    pollfd fd = {m_socket, POLLIN, 0};
+    while (!stopRequested()) {
+        if (poll(&fd, 1, 20) <= 0) {
+            continue;
+        }
+        sockaddr_un sender;
+        socklen_t senderLength = sizeof(sender);
+        const ssize_t length = recvfrom(m_socket,
+                                        buffer,
+                                        sizeof(buffer),
+                                        MSG_DONTWAIT,
+                                        reinterpret_cast<sockaddr *>(&sender),
+                                        &senderLength);
+        if (length < 0) {
+            continue;
+        }
+        const qint64 timeNs = ToneSynthesizer::monotonicNs();
+        QString reply = "ok";
+        const QStringList lines = QString::fromUtf8(buffer, int(length)).split('\n');
+        for (QString line : lines) {
+            const int comment = line.indexOf('#');
+            if (comment >= 0) {
+                line.truncate(comment);
+            }
+            const QStringList fields = line.simplified().split(' ', Qt::SkipEmptyParts);
+            if (fields.isEmpty()) {
+                continue;
+            }
+            SynthEvent event;
+            QString error;
+            if (NoteScript::parseCommand(fields, &event, &error)) {
+                deliver(event, timeNs);
+            } else {
+                m_badCommands.fetch_add(1, std::memory_order_relaxed);
+                if (reply == "ok") {
+                    reply = "error: " + error;
+                }
+            }
+        }
+        // Безымянный отправитель ответа не получит
+        if (senderLength > socklen_t(offsetof(sockaddr_un, sun_path))) {
+            const QByteArray bytes = reply.toUtf8();
+            sendto(m_socket,
+                   bytes.constData(),
+                   size_t(bytes.size()),
+                   MSG_DONTWAIT,
+                   reinterpret_cast<sockaddr *>(&sender),
+                   senderLength);
+        }
+    }
+}
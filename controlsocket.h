@@ -0,0 +1,39 @@
+#ifndef CONTROLSOCKET_H
+#define CONTROLSOCKET_H
+
+#include <atomic>
+#include <QString>
+#include "midiinput.h" // Поток источника событий
+
+// Управление экземпляром без GUI через локальный сокет (AF_UNIX, датаграммы).
+// Датаграмма - одна или несколько строк с командами сценария нот без времени
+// (NoteScript::parseCommand): "on C4 0.8", "off 60", "set volume 0.5",
+// "program 2", "alloff". Событие получает сэмпл момента приема и идет в очередь
+// MIDI синтезатора, поэтому сокет заменяет, а не дополняет другой вход MIDI.
+// Отправителю со своим адресом (клиент сделал bind) отвечается "ok" или
+// "error: ..." - по первой ошибочной строке датаграммы
+class ControlSocket : public MidiInput
+{
+    Q_OBJECT
+
+public:
+    explicit ControlSocket(ToneSynthesizer *synth, QObject *parent = nullptr);
+    ~ControlSocket() override;
+
+    // Создание сокета по пути файловой системы. Файл сокета, оставшийся
+    // от упавшего процесса, заменяется; если сокет слушает работающий
+    // экземпляр - ошибка "in use"
+    bool open(const QString &path, QString *error);
+    // Строки, которые не удалось разобрать
+    quint64 badCommands() const;
+
+protected:
+    void run() override;
+
+private:
+    int m_socket;
+    QString m_path;
+    std::atomic<quint64> m_badCommands;
+};
+
+#endif // CONTROLSOCKET_H
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cstring>
+#include "decimator.h"
+
+Decimator::Decimator(int factor)
+    : m_factor(1)
+    , m_kernel(RenderKernels::halfBand())
+{
+    setFactor(factor);
+}
+
+void Decimator::setFactor(int factor)
+{
+    m_factor = (factor >= 4) ? 4 : (factor >= 2) ? 2 : 1;
+    reset();
+}
+
+int Decimator::factor() const
+{
+    return m_factor;
+}
+
+void Decimator::reset()
+{
+    m_first.reset();
+    m_last.reset();
+}
+
+void Decimator::process(const float *in, float *out, int frames)
+{
+    switch (m_factor) {
+    case 4:
+        m_first.process(m_kernel, in, m_middle, 2 * frames);
+        m_last.process(m_kernel, m_middle, out, frames);
+        break;
+    case 2:
+        m_last.process(m_kernel, in, out, frames);
+        break;
+    default:
+        std::memcpy(out, in, size_t(frames) * sizeof(float));
+        break;
+    }
+}
+
+// Выход ступени запаздывает на History сэмплов ее входной частоты (центр фильтра)
+qreal Decimator::latency(int factor)
+{
+    const qreal last = Stage<20, MaxFrames>::History / 2.0;
+    if (factor >= 4) {
+        return last + Stage<5, 2 * MaxFrames>::History / 4.0;
+    }
+    return (factor >= 2) ? last : 0.0;
+}
+
+template <int Pairs, int MaxOutput>
+void Decimator::Stage<Pairs, MaxOutput>::reset()
+{
+    std::fill(m_even, m_even + History, 0.0f);
+    std::fill(m_odd, m_odd + Pairs, 0.0f);
+}
+
+// Разделение входа на четные и нечетные сэмплы после хвостов ветвей, фильтр
+// по четным, задержка нечетных на Pairs, затем хвосты переносятся в начало
+template <int Pairs, int MaxOutput>
+void Decimator::Stage<Pairs, MaxOutput>::process(RenderKernels::HalfBandKernel kernel,
+                                                  const float *in,
+                                                  float *out,
+                                                  int frames)
+{
+    for (int i = 0; i < frames; ++i) {
+        m_even[History + i] = in[2 * i];
+        m_odd[Pairs + i] = in[2 * i + 1];
+    }
+    kernel(out, frames, m_even, m_odd, coefficients.data(), Pairs);
+    std::memmove(m_even, m_even + frames, History * sizeof(float));
+    std::memmove(m_odd, m_odd + frames, Pairs * sizeof(float));
+}
@@ -0,0 +1,116 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <array>
+#include <QtGlobal>
+#include "renderkernels.h" // Векторное ядро ступени
+
+// Расчет полуполосных фильтров во время компиляции: идеальный полуполосный
+// фильтр (sinc с нулями на четных отступах) с окном Кайзера. Центральный
+// коэффициент - 0.5, остальные ненулевые стоят на нечетных отступах от центра
+namespace HalfBand {
+
+constexpr double pi = 3.14159265358979323846;
+// Окно Кайзера для подавления ~80 дБ
+constexpr double kaiserBeta = 7.857;
+
+constexpr double squareRoot(double x)
+{
+    double root = (x > 1.0) ? x : 1.0;
+    for (int i = 0; i < 64; ++i) {
+        root = 0.5 * (root + x / root);
+    }
+    return root;
+}
+
+// Модифицированная функция Бесселя нулевого порядка (ряд)
+constexpr double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 64; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Коэффициенты при отступах 1, 3, 5, ... от центра фильтра длины 4 * Pairs - 1.
+// Сумма нормируется к 0.25: вместе с центром постоянная составляющая проходит
+// без изменения. beta - параметр окна Кайзера (подавление ~ beta / 0.1102 + 8.7 дБ)
+template <int Pairs>
+constexpr std::array<float, Pairs> design(double beta)
+{
+    double side[Pairs] = {};
+    double sum = 0.0;
+    const double center = 2 * Pairs - 1;
+    for (int k = 0; k < Pairs; ++k) {
+        const double offset = 2 * k + 1;
+        const double r = offset / center;
+        const double window = besselI0(beta * squareRoot(1.0 - r * r)) / besselI0(beta);
+        side[k] = ((k % 2 == 0) ? 1.0 : -1.0) / (pi * offset) * window;
+        sum += side[k];
+    }
+    std::array<float, Pairs> coefficients{};
+    for (int k = 0; k < Pairs; ++k) {
+        coefficients[k] = float(side[k] * 0.25 / sum);
+    }
+    return coefficients;
+}
+
+} // namespace HalfBand
+
+// Понижение частоты дискретизации в 2 или 4 раза после генерации
+// с передискретизацией. Каскад полуполосных фильтров, каждая ступень делит
+// частоту на 2 в полифазной форме: фильтр считается только для выходных
+// сэмплов, ветвь нечетных входных сэмплов - чистая задержка. Последняя
+// ступень пропускает до 0.43 выходной частоты (19 кГц при 44100 Гц) и
+// подавляет отражения на ~80 дБ. Первая ступень 4x короче: ее отражения
+// ложатся в полосу, которую срезает последняя. Коэффициенты рассчитываются
+// при компиляции, буферы - часть объекта, process() не выделяет память
+class Decimator
+{
+public:
+    static const int MaxFactor = 4;
+    // Наибольший выходной блок process()
+    static const int MaxFrames = 256;
+
+    explicit Decimator(int factor = 1);
+
+    // 1, 2 или 4; состояние фильтров сбрасывается
+    void setFactor(int factor);
+    int factor() const;
+    void reset();
+    // in - frames * factor() сэмплов, out - frames (frames <= MaxFrames).
+    // При factor() 1 вход копируется
+    void process(const float *in, float *out, int frames);
+
+    // Групповая задержка в сэмплах выходной частоты
+    static qreal latency(int factor);
+
+private:
+    // Ступень 2:1 с Pairs парами коэффициентов, не больше MaxOutput выходных
+    // сэмплов за вызов. Буферы ветвей начинаются с хвоста предыдущего вызова
+    template <int Pairs, int MaxOutput>
+    class Stage
+    {
+    public:
+        static const int History = 2 * Pairs - 1;
+        static constexpr std::array<float, Pairs> coefficients = HalfBand::design<Pairs>(HalfBand::kaiserBeta);
+
+        void reset();
+        void process(RenderKernels::HalfBandKernel kernel, const float *in, float *out, int frames);
+
+    private:
+        float m_even[History + MaxOutput];
+        float m_odd[Pairs + MaxOutput];
+    };
+
+    int m_factor;
+    RenderKernels::HalfBandKernel m_kernel;
+    Stage<5, 2 * MaxFrames> m_first; // 4x -> 2x
+    Stage<20, MaxFrames> m_last; // 2x -> 1x
+    float m_middle[2 * MaxFrames];
+};
+
+#endif // DECIMATOR_H
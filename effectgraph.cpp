@@ -0,0 +1,701 @@
+#include <algorithm>
+#include <cstring>
+#include <QStringList>
+#include <QtMath>
+#include "effectgraph.h"
+
+namespace {
+
+const char *const kindNames[] = {"filter", "delay", "reverb"};
+const char *const modeNames[] = {"lowpass", "highpass", "bandpass", "notch"};
+
+// Постоянная добавка к сигналу в обратных связях: затухающие хвосты не доходят
+// до денормализованных чисел, которые обрабатываются в десятки раз медленнее
+const float denormalGuard = 1e-18f;
+
+// Задержки Freeverb для 44100 Гц
+const int combTunings[Reverb::Combs] = {1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617};
+const int allpassTunings[Reverb::Allpasses] = {556, 441, 341, 225};
+const float reverbInputGain = 0.015f;
+const float reverbWetGain = 3.0f;
+const float allpassFeedback = 0.5f;
+// Хвост узла длится, пока отклик не ослабнет в 10^6 раз (-120 дБ, порог
+// тишины синтезатора); ln(10^6)
+const qreal tailDecayLog = 13.815510557964274;
+
+// Число проходов петли с усилением gain до ослабления на tailDecayLog
+qint64 decayPasses(qreal gain)
+{
+    return (gain <= 0.0) ? 0 : qint64(qCeil(tailDecayLog / -qLn(qMin(gain, 0.999999))));
+}
+
+} // namespace
+
+QString EffectNode::kindName(Kind kind)
+{
+    return QString(kindNames[int(kind)]);
+}
+
+StateVariableFilter::StateVariableFilter(Mode mode, qreal cutoffHz, qreal resonance)
+    : m_mode(mode)
+    , m_cutoffHz(cutoffHz)
+    , m_resonance(resonance)
+    , m_sampleRate(44100)
+    , m_ic1eq(0.0f)
+    , m_ic2eq(0.0f)
+{
+    updateCoefficients();
+}
+
+void StateVariableFilter::setSampleRate(int sampleRate)
+{
+    m_sampleRate = qMax(1, sampleRate);
+    updateCoefficients();
+}
+
+void StateVariableFilter::reset()
+{
+    m_ic1eq = 0.0f;
+    m_ic2eq = 0.0f;
+}
+
+void StateVariableFilter::setMode(Mode mode)
+{
+    m_mode = mode;
+    updateCoefficients();
+}
+
+void StateVariableFilter::setCutoff(qreal cutoffHz)
+{
+    m_cutoffHz = cutoffHz;
+    updateCoefficients();
+}
+
+void StateVariableFilter::setResonance(qreal resonance)
+{
+    m_resonance = resonance;
+    updateCoefficients();
+}
+
+// Режим задается весами выходов, поэтому в цикле по сэмплам нет ветвлений
+void StateVariableFilter::updateCoefficients()
+{
+    const qreal cutoff = qBound(10.0, m_cutoffHz, 0.49 * m_sampleRate);
+    const qreal g = qTan(M_PI * cutoff / m_sampleRate);
+    const qreal k = 1.0 / qMax(0.5, m_resonance);
+    const qreal a1 = 1.0 / (1.0 + g * (g + k));
+    m_a1 = float(a1);
+    m_a2 = float(g * a1);
+    m_a3 = float(g * g * a1);
+    switch (m_mode) {
+    case Mode::lowpass:
+        m_m0 = 0.0f, m_m1 = 0.0f, m_m2 = 1.0f;
+        break;
+    case Mode::highpass:
+        m_m0 = 1.0f, m_m1 = float(-k), m_m2 = -1.0f;
+        break;
+    case Mode::bandpass:
+        m_m0 = 0.0f, m_m1 = 1.0f, m_m2 = 0.0f;
+        break;
+    case Mode::notch:
+        m_m0 = 1.0f, m_m1 = float(-k), m_m2 = 0.0f;
+        break;
+    }
+}
+
+void StateVariableFilter::process(float *buffer, int frames)
+{
+    // Состояние в локальных переменных: компилятор держит его в регистрах
+    const float a1 = m_a1, a2 = m_a2, a3 = m_a3;
+    const float m0 = m_m0, m1 = m_m1, m2 = m_m2;
+    float ic1eq = m_ic1eq, ic2eq = m_ic2eq;
+    for (int i = 0; i < frames; ++i) {
+        const float v0 = buffer[i] + denormalGuard;
+        const float v3 = v0 - ic2eq;
+        const float v1 = a1 * ic1eq + a2 * v3;
+        const float v2 = ic2eq + a2 * ic1eq + a3 * v3;
+        ic1eq = 2.0f * v1 - ic1eq;
+        ic2eq = 2.0f * v2 - ic2eq;
+        buffer[i] = m0 * v0 + m1 * v1 + m2 * v2;
+    }
+    m_ic1eq = ic1eq;
+    m_ic2eq = ic2eq;
+}
+
+// Резонанс звенит с постоянной времени 2Q / w
+qint64 StateVariableFilter::tailFrames() const
+{
+    const qreal cutoff = qBound(10.0, m_cutoffHz, 0.49 * m_sampleRate);
+    return qint64(qCeil(2.0 * qMax(0.5, m_resonance) * tailDecayLog * m_sampleRate / (2.0 * M_PI * cutoff)));
+}
+
+QString StateVariableFilter::modeName(Mode mode)
+{
+    return QString(modeNames[int(mode)]);
+}
+
+bool StateVariableFilter::parseMode(const QString &name, Mode *mode)
+{
+    for (int i = 0; i < 4; ++i) {
+        if (name == modeNames[i]) {
+            *mode = Mode(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+FeedbackDelay::FeedbackDelay(qreal timeMs, qreal feedback, qreal mix)
+    : m_mask(0)
+    , m_write(0)
+    , m_delayFrames(1)
+    , m_timeMs(timeMs)
+    , m_sampleRate(0)
+    , m_feedback(0.0f)
+    , m_mix(0.0f)
+{
+    setFeedback(feedback);
+    setMix(mix);
+}
+
+// Выделение линии на наибольшую задержку (вне потока звука)
+void FeedbackDelay::setSampleRate(int sampleRate)
+{
+    m_sampleRate = qMax(1, sampleRate);
+    const qint64 maxFrames = qint64(MaxTimeMs) * m_sampleRate / 1000 + 1;
+    int size = 1;
+    while (size < maxFrames) {
+        size *= 2;
+    }
+    m_line.fill(0.0f, size);
+    m_mask = size - 1;
+    m_write = 0;
+    setTime(m_timeMs);
+}
+
+void FeedbackDelay::reset()
+{
+    std::fill(m_line.begin(), m_line.end(), 0.0f);
+    m_write = 0;
+}
+
+void FeedbackDelay::setTime(qreal timeMs)
+{
+    m_timeMs = qBound(0.0, timeMs, qreal(MaxTimeMs));
+    m_delayFrames = qMax(1, qRound(m_timeMs * m_sampleRate / 1000.0));
+}
+
+void FeedbackDelay::setFeedback(qreal feedback)
+{
+    m_feedback = float(qBound(0.0, feedback, 0.98));
+}
+
+void FeedbackDelay::setMix(qreal mix)
+{
+    m_mix = float(qBound(0.0, mix, 1.0));
+}
+
+void FeedbackDelay::process(float *buffer, int frames)
+{
+    if (m_line.isEmpty()) {
+        return; // Частота дискретизации еще не задана
+    }
+    float *line = m_line.data();
+    const int mask = m_mask;
+    const float feedback = m_feedback;
+    const float wet = m_mix;
+    const float dry = 1.0f - m_mix;
+    int write = m_write;
+    int read = (write - m_delayFrames) & mask;
+    for (int i = 0; i < frames; ++i) {
+        const float x = buffer[i];
+        const float y = line[read];
+        line[write] = x + feedback * y + denormalGuard;
+        buffer[i] = dry * x + wet * y;
+        write = (write + 1) & mask;
+        read = (read + 1) & mask;
+    }
+    m_write = write;
+}
+
+// Каждый отзвук тише предыдущего в feedback раз; первый приходит через время задержки
+qint64 FeedbackDelay::tailFrames() const
+{
+    return qint64(m_delayFrames) * (1 + decayPasses(m_feedback));
+}
+
+Reverb::Reverb(qreal roomSize, qreal damping, qreal mix)
+    : m_feedback(0.0f)
+    , m_damping(0.0f)
+    , m_mix(0.0f)
+{
+    for (int i = 0; i < Combs; ++i) {
+        m_combs[i] = Line{0, 0, 0, 0.0f};
+    }
+    for (int i = 0; i < Allpasses; ++i) {
+        m_allpasses[i] = Line{0, 0, 0, 0.0f};
+    }
+    setRoomSize(roomSize);
+    setDamping(damping);
+    setMix(mix);
+}
+
+// Выделение всех линий одним куском (вне потока звука)
+void Reverb::setSampleRate(int sampleRate)
+{
+    const qreal scale = qMax(1, sampleRate) / 44100.0;
+    int offset = 0;
+    for (int i = 0; i < Combs; ++i) {
+        m_combs[i] = Line{offset, qMax(1, qRound(combTunings[i] * scale)), 0, 0.0f};
+        offset += m_combs[i].length;
+    }
+    for (int i = 0; i < Allpasses; ++i) {
+        m_allpasses[i] = Line{offset, qMax(1, qRound(allpassTunings[i] * scale)), 0, 0.0f};
+        offset += m_allpasses[i].length;
+    }
+    m_storage.fill(0.0f, offset);
+}
+
+void Reverb::reset()
+{
+    std::fill(m_storage.begin(), m_storage.end(), 0.0f);
+    for (int i = 0; i < Combs; ++i) {
+        m_combs[i].pos = 0;
+        m_combs[i].filter = 0.0f;
+    }
+    for (int i = 0; i < Allpasses; ++i) {
+        m_allpasses[i].pos = 0;
+    }
+}
+
+void Reverb::setRoomSize(qreal roomSize)
+{
+    m_feedback = float(0.7 + 0.28 * qBound(0.0, roomSize, 1.0));
+}
+
+void Reverb::setDamping(qreal damping)
+{
+    m_damping = float(0.4 * qBound(0.0, damping, 1.0));
+}
+
+void Reverb::setMix(qreal mix)
+{
+    m_mix = float(qBound(0.0, mix, 1.0));
+}
+
+// Самая длинная гребенчатая линия затухает с усилением feedback за проход
+// (фильтр затухания не усиливает), за ней звенят всепропускающие
+qint64 Reverb::tailFrames() const
+{
+    qint64 combFrames = 0;
+    for (int i = 0; i < Combs; ++i) {
+        combFrames = qMax<qint64>(combFrames, m_combs[i].length);
+    }
+    qint64 allpassFrames = 0;
+    for (int i = 0; i < Allpasses; ++i) {
+        allpassFrames += m_allpasses[i].length;
+    }
+    return combFrames * decayPasses(m_feedback) + allpassFrames * decayPasses(allpassFeedback);
+}
+
+// Каждая линия проходит блок целиком: ее состояние остается в регистрах,
+// а сама линия - в кэше, пока не обработан весь блок
+void Reverb::process(float *buffer, int frames)
+{
+    if (m_storage.isEmpty()) {
+        return; // Частота дискретизации еще не задана
+    }
+    Q_ASSERT(frames <= MaxBlockFrames);
+    float *storage = m_storage.data();
+    for (int i = 0; i < frames; ++i) {
+        m_input[i] = buffer[i] * reverbInputGain + denormalGuard;
+        m_wet[i] = 0.0f;
+    }
+    const float feedback = m_feedback;
+    const float damp1 = m_damping;
+    const float damp2 = 1.0f - m_damping;
+    for (int c = 0; c < Combs; ++c) {
+        Line &comb = m_combs[c];
+        float *line = storage + comb.offset;
+        int pos = comb.pos;
+        float filter = comb.filter;
+        for (int i = 0; i < frames; ++i) {
+            const float out = line[pos];
+            filter = out * damp2 + filter * damp1;
+            line[pos] = m_input[i] + filter * feedback;
+            m_wet[i] += out;
+            if (++pos == comb.length) {
+                pos = 0;
+            }
+        }
+        comb.pos = pos;
+        comb.filter = filter;
+    }
+    for (int a = 0; a < Allpasses; ++a) {
+        Line &allpass = m_allpasses[a];
+        float *line = storage + allpass.offset;
+        int pos = allpass.pos;
+        for (int i = 0; i < frames; ++i) {
+            const float delayed = line[pos];
+            line[pos] = m_wet[i] + delayed * allpassFeedback;
+            m_wet[i] = delayed - m_wet[i];
+            if (++pos == allpass.length) {
+                pos = 0;
+            }
+        }
+        allpass.pos = pos;
+    }
+    const float wet = m_mix * reverbWetGain;
+    const float dry = 1.0f - m_mix;
+    for (int i = 0; i < frames; ++i) {
+        buffer[i] = dry * buffer[i] + wet * m_wet[i];
+    }
+}
+
+EffectGraph::EffectGraph()
+    : m_toOutput(0)
+    , m_dry(false)
+    , m_sampleRate(0)
+    , m_stepCount(0)
+    , m_outputCount(0)
+    , m_bypass(true)
+{
+    for (int i = 0; i < MaxNodes; ++i) {
+        m_nodes[i] = nullptr;
+        m_edges[i] = 0;
+        m_fromInput[i] = false;
+    }
+}
+
+EffectGraph::~EffectGraph()
+{
+    clear();
+}
+
+int EffectGraph::addNode(EffectNode *node)
+{
+    for (int i = 0; i < MaxNodes; ++i) {
+        if (!m_nodes[i]) {
+            m_nodes[i] = node;
+            m_edges[i] = 0;
+            m_fromInput[i] = false;
+            if (m_sampleRate > 0) {
+                node->setSampleRate(m_sampleRate);
+            }
+            compile();
+            return i;
+        }
+    }
+    delete node;
+    return -1;
+}
+
+void EffectGraph::removeNode(int id)
+{
+    if (!node(id)) {
+        return;
+    }
+    delete m_nodes[id];
+    m_nodes[id] = nullptr;
+    m_edges[id] = 0;
+    m_fromInput[id] = false;
+    for (int i = 0; i < MaxNodes; ++i) {
+        m_edges[i] &= ~(1u << id);
+    }
+    m_toOutput &= ~(1u << id);
+    compile();
+}
+
+void EffectGraph::clear()
+{
+    for (int i = 0; i < MaxNodes; ++i) {
+        delete m_nodes[i];
+        m_nodes[i] = nullptr;
+        m_edges[i] = 0;
+        m_fromInput[i] = false;
+    }
+    m_toOutput = 0;
+    m_dry = false;
+    compile();
+}
+
+EffectNode *EffectGraph::node(int id) const
+{
+    return (id >= 0 && id < MaxNodes) ? m_nodes[id] : nullptr;
+}
+
+int EffectGraph::nodeCount() const
+{
+    int count = 0;
+    for (int i = 0; i < MaxNodes; ++i) {
+        count += m_nodes[i] ? 1 : 0;
+    }
+    return count;
+}
+
+bool EffectGraph::connect(int from, int to)
+{
+    if ((from != Input && !node(from)) || (to != Output && !node(to))) {
+        return false;
+    }
+    if (from == Input && to == Output) {
+        m_dry = true;
+    } else if (from == Input) {
+        m_fromInput[to] = true;
+    } else if (to == Output) {
+        m_toOutput |= 1u << from;
+    } else {
+        const quint32 previous = m_edges[to];
+        m_edges[to] |= 1u << from;
+        if (!compile()) {
+            m_edges[to] = previous; // Цикл: ребро не добавляется
+            compile();
+            return false;
+        }
+    }
+    compile();
+    return true;
+}
+
+void EffectGraph::disconnect(int from, int to)
+{
+    if (from == Input && to == Output) {
+        m_dry = false;
+    } else if (from == Input && node(to)) {
+        m_fromInput[to] = false;
+    } else if (to == Output && node(from)) {
+        m_toOutput &= ~(1u << from);
+    } else if (node(from) && node(to)) {
+        m_edges[to] &= ~(1u << from);
+    }
+    compile();
+}
+
+void EffectGraph::connectChain()
+{
+    for (int i = 0; i < MaxNodes; ++i) {
+        m_edges[i] = 0;
+        m_fromInput[i] = false;
+    }
+    m_toOutput = 0;
+    m_dry = false;
+    int previous = Input;
+    for (int i = 0; i < MaxNodes; ++i) {
+        if (m_nodes[i]) {
+            if (previous == Input) {
+                m_fromInput[i] = true;
+            } else {
+                m_edges[i] = 1u << previous;
+            }
+            previous = i;
+        }
+    }
+    if (previous == Input) {
+        m_dry = true;
+    } else {
+        m_toOutput = 1u << previous;
+    }
+    compile();
+}
+
+void EffectGraph::setSampleRate(int sampleRate)
+{
+    m_sampleRate = sampleRate;
+    for (int i = 0; i < MaxNodes; ++i) {
+        if (m_nodes[i]) {
+            m_nodes[i]->setSampleRate(sampleRate);
+        }
+    }
+}
+
+void EffectGraph::reset()
+{
+    for (int i = 0; i < MaxNodes; ++i) {
+        if (m_nodes[i]) {
+            m_nodes[i]->reset();
+        }
+    }
+}
+
+bool EffectGraph::isEmpty() const
+{
+    return m_bypass;
+}
+
+qint64 EffectGraph::tailFrames() const
+{
+    qint64 frames = 0;
+    for (int i = 0; i < m_stepCount; ++i) {
+        frames += m_steps[i].node->tailFrames();
+    }
+    return frames;
+}
+
+// Построение расписания. Топологическая сортировка (алгоритм Кана) по всем
+// узлам, чтобы цикл обнаруживался сразу при соединении; в расписание попадают
+// только узлы, от которых есть путь к выходу. false - в графе цикл
+bool EffectGraph::compile()
+{
+    // Узлы, влияющие на выход: обратный обход от выхода
+    quint32 live = m_toOutput;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int i = 0; i < MaxNodes; ++i) {
+            if ((live & (1u << i)) && (live | m_edges[i]) != live) {
+                live |= m_edges[i];
+                changed = true;
+            }
+        }
+    }
+
+    int order[MaxNodes];
+    int ordered = 0;
+    int nodes = 0;
+    quint32 done = 0;
+    for (int i = 0; i < MaxNodes; ++i) {
+        nodes += m_nodes[i] ? 1 : 0;
+    }
+    while (ordered < nodes) {
+        int ready = -1;
+        for (int i = 0; i < MaxNodes && ready < 0; ++i) {
+            if (m_nodes[i] && !(done & (1u << i)) && (m_edges[i] & ~done) == 0) {
+                ready = i;
+            }
+        }
+        if (ready < 0) {
+            return false; // Остались только узлы на цикле
+        }
+        done |= 1u << ready;
+        order[ordered++] = ready;
+    }
+
+    m_stepCount = 0;
+    for (int n = 0; n < ordered; ++n) {
+        const int id = order[n];
+        if (!(live & (1u << id))) {
+            continue;
+        }
+        Step &step = m_steps[m_stepCount++];
+        step.node = m_nodes[id];
+        step.buffer = m_buffers[id];
+        step.inputCount = 0;
+        if (m_fromInput[id]) {
+            step.inputs[step.inputCount++] = m_input;
+        }
+        for (int i = 0; i < MaxNodes; ++i) {
+            if (m_edges[id] & (1u << i)) {
+                step.inputs[step.inputCount++] = m_buffers[i];
+            }
+        }
+    }
+    m_outputCount = 0;
+    if (m_dry) {
+        m_outputs[m_outputCount++] = m_input;
+    }
+    for (int i = 0; i < MaxNodes; ++i) {
+        if (m_toOutput & (1u << i)) {
+            m_outputs[m_outputCount++] = m_buffers[i];
+        }
+    }
+    m_bypass = (nodes == 0);
+    return true;
+}
+
+// Сумма входов в out (без входов - тишина)
+void EffectGraph::mix(float *out, const float *const *inputs, int count, int frames)
+{
+    if (count == 0) {
+        std::fill(out, out + frames, 0.0f);
+        return;
+    }
+    std::memcpy(out, inputs[0], size_t(frames) * sizeof(float));
+    for (int n = 1; n < count; ++n) {
+        const float *input = inputs[n];
+        for (int i = 0; i < frames; ++i) {
+            out[i] += input[i];
+        }
+    }
+}
+
+void EffectGraph::process(float *buffer, int frames)
+{
+    if (m_bypass) {
+        return;
+    }
+    Q_ASSERT(frames <= MaxBlockFrames);
+    std::memcpy(m_input, buffer, size_t(frames) * sizeof(float));
+    for (int s = 0; s < m_stepCount; ++s) {
+        Step &step = m_steps[s];
+        mix(step.buffer, step.inputs, step.inputCount, frames);
+        step.node->process(step.buffer, frames);
+    }
+    mix(buffer, m_outputs, m_outputCount, frames);
+}
+
+bool EffectGraph::parseChain(const QString &spec, QString *error)
+{
+    clear();
+    const QStringList items = spec.split(';', Qt::SkipEmptyParts);
+    for (const QString &item : items) {
+        const QString kind = item.section(':', 0, 0).trimmed();
+        const QStringList params = item.section(':', 1).split(',', Qt::SkipEmptyParts);
+        QVector<qreal> values;
+        QString modeText;
+        for (int i = 0; i < params.size(); ++i) {
+            bool ok = false;
+            const qreal value = params.at(i).trimmed().toDouble(&ok);
+            if (kind == "filter" && i == 0) {
+                // Режим фильтра - по имени; без него (lowpass) первое число -
+                // уже частота среза, а не место режима
+                values << 0.0;
+                if (!ok) {
+                    modeText = params.at(i).trimmed();
+                    continue;
+                }
+            }
+            if (!ok) {
+                if (error) {
+                    *error = QString("bad effect parameter '%1'").arg(params.at(i));
+                }
+                clear();
+                return false;
+            }
+            values << value;
+        }
+        // Недостающие параметры - значения по умолчанию
+        const auto value = [&values](int index, qreal fallback) {
+            return index < values.size() ? values.at(index) : fallback;
+        };
+        EffectNode *node = nullptr;
+        if (kind == "filter") {
+            StateVariableFilter::Mode mode = StateVariableFilter::Mode::lowpass;
+            if (!modeText.isEmpty() && !StateVariableFilter::parseMode(modeText, &mode)) {
+                if (error) {
+                    *error = QString("unknown filter mode '%1'").arg(modeText);
+                }
+                clear();
+                return false;
+            }
+            node = new StateVariableFilter(mode, value(1, 1000.0), value(2, 0.707));
+        } else if (kind == "delay") {
+            node = new FeedbackDelay(value(0, 350.0), value(1, 0.35), value(2, 0.3));
+        } else if (kind == "reverb") {
+            node = new Reverb(value(0, 0.7), value(1, 0.5), value(2, 0.25));
+        } else {
+            if (error) {
+                *error = QString("unknown effect '%1'").arg(kind);
+            }
+            clear();
+            return false;
+        }
+        if (addNode(node) < 0) {
+            if (error) {
+                *error = QString("too many effects (at most %1)").arg(MaxNodes);
+            }
+            clear();
+            return false;
+        }
+    }
+    connectChain();
+    return true;
+}
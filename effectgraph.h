@@ -0,0 +1,218 @@
+#ifndef EFFECTGRAPH_H
+#define EFFECTGRAPH_H
+
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+// Узел обработки. Обрабатывает блок целиком на месте: один виртуальный вызов
+// на блок, внутренний цикл по сэмплам без косвенных вызовов. Память (линии
+// задержки) выделяется в setSampleRate(), вне потока звука
+class EffectNode
+{
+public:
+    enum class Kind : int { filter, delay, reverb };
+
+    virtual ~EffectNode() {}
+
+    virtual Kind kind() const = 0;
+    virtual void setSampleRate(int sampleRate) = 0;
+    // Очистка внутреннего состояния (хвосты задержки и реверберации)
+    virtual void reset() = 0;
+    virtual void process(float *buffer, int frames) = 0;
+    // Длина хвоста в сэмплах: сколько после тишины на входе выход еще может
+    // быть громче -120 дБ (между отзвуками задержки выход бывает ровно нулем)
+    virtual qint64 tailFrames() const = 0;
+
+    static QString kindName(Kind kind);
+};
+
+// Фильтр с переменными состояниями (топология TPT, Simper): устойчив при любой
+// частоте среза, выходы всех режимов получаются из одних и тех же переменных
+class StateVariableFilter : public EffectNode
+{
+public:
+    enum class Mode : int { lowpass, highpass, bandpass, notch };
+
+    StateVariableFilter(Mode mode = Mode::lowpass, qreal cutoffHz = 1000.0, qreal resonance = 0.707);
+
+    Kind kind() const override { return Kind::filter; }
+    void setSampleRate(int sampleRate) override;
+    void reset() override;
+    void process(float *buffer, int frames) override;
+    qint64 tailFrames() const override;
+
+    void setMode(Mode mode);
+    // Частота среза ограничивается чуть ниже половины частоты дискретизации,
+    // resonance - добротность Q (0.5 и выше)
+    void setCutoff(qreal cutoffHz);
+    void setResonance(qreal resonance);
+
+    static QString modeName(Mode mode);
+    static bool parseMode(const QString &name, Mode *mode);
+
+private:
+    void updateCoefficients();
+
+    Mode m_mode;
+    qreal m_cutoffHz;
+    qreal m_resonance;
+    int m_sampleRate;
+    float m_a1, m_a2, m_a3; // Коэффициенты шага
+    float m_m0, m_m1, m_m2; // Выход = m0 * вход + m1 * полоса + m2 * НЧ
+    float m_ic1eq, m_ic2eq; // Состояние интеграторов
+};
+
+// Задержка с обратной связью. Линия выделяется на MaxTimeMs при смене частоты
+// дискретизации, длина - степень двойки (индекс по маске)
+class FeedbackDelay : public EffectNode
+{
+public:
+    static const int MaxTimeMs = 2000;
+
+    FeedbackDelay(qreal timeMs = 350.0, qreal feedback = 0.35, qreal mix = 0.3);
+
+    Kind kind() const override { return Kind::delay; }
+    void setSampleRate(int sampleRate) override;
+    void reset() override;
+    void process(float *buffer, int frames) override;
+    qint64 tailFrames() const override;
+
+    void setTime(qreal timeMs);
+    // Обратная связь ограничивается 0.98, чтобы хвост всегда затихал
+    void setFeedback(qreal feedback);
+    // Доля задержанного сигнала в выходе (0 - только прямой)
+    void setMix(qreal mix);
+
+private:
+    QVector<float> m_line;
+    int m_mask;
+    int m_write; // Позиция записи
+    int m_delayFrames;
+    qreal m_timeMs;
+    int m_sampleRate;
+    float m_feedback;
+    float m_mix;
+};
+
+// Алгоритмическая реверберация по схеме Шредера - Мурера (Freeverb):
+// параллельные гребенчатые фильтры с затуханием в обратной связи и
+// последовательные всепропускающие. Задержки подобраны для 44100 Гц
+// и масштабируются под текущую частоту
+class Reverb : public EffectNode
+{
+public:
+    static const int Combs = 8;
+    static const int Allpasses = 4;
+    // Наибольший блок process() (временные буферы внутри узла)
+    static const int MaxBlockFrames = 256;
+
+    Reverb(qreal roomSize = 0.7, qreal damping = 0.5, qreal mix = 0.25);
+
+    Kind kind() const override { return Kind::reverb; }
+    void setSampleRate(int sampleRate) override;
+    void reset() override;
+    void process(float *buffer, int frames) override;
+    qint64 tailFrames() const override;
+
+    // Размер помещения и затухание высоких частот 0..1
+    void setRoomSize(qreal roomSize);
+    void setDamping(qreal damping);
+    void setMix(qreal mix);
+
+private:
+    struct Line
+    {
+        int offset; // Начало линии в m_storage
+        int length;
+        int pos;
+        float filter; // Состояние фильтра затухания (только гребенчатые)
+    };
+
+    QVector<float> m_storage; // Все линии одним куском
+    Line m_combs[Combs];
+    Line m_allpasses[Allpasses];
+    float m_feedback;
+    float m_damping;
+    float m_mix;
+    float m_input[MaxBlockFrames]; // Вход, ослабленный перед гребенчатыми
+    float m_wet[MaxBlockFrames]; // Сумма гребенчатых
+};
+
+// Граф обработки после смесителя голосов. Узлы соединяются ребрами, вход
+// графа - смесь голосов, выход - сумма узлов, соединенных с Output. Узел
+// получает сумму своих входов. Порядок обработки (топологическая сортировка)
+// и списки входов вычисляются при каждом изменении графа, а не в потоке звука:
+// process() только проходит готовое расписание. Узлы, не влияющие на выход,
+// в расписание не попадают. Пустой граф пропускает сигнал без изменений.
+// Менять граф можно только пока устройство не читает данные
+class EffectGraph
+{
+public:
+    static const int MaxNodes = 16;
+    static const int MaxBlockFrames = 256;
+    // Концы графа в connect()
+    static const int Input = -1;
+    static const int Output = -2;
+
+    EffectGraph();
+    ~EffectGraph();
+
+    // Граф становится владельцем узла; -1 - узлов уже MaxNodes
+    int addNode(EffectNode *node);
+    void removeNode(int id);
+    void clear();
+    EffectNode *node(int id) const;
+    int nodeCount() const;
+    // Ребро from -> to (узлы или концы графа); false - неверные концы
+    // или ребро образует цикл
+    bool connect(int from, int to);
+    void disconnect(int from, int to);
+    // Последовательная цепочка: Input -> узлы в порядке добавления -> Output
+    void connectChain();
+
+    void setSampleRate(int sampleRate);
+    void reset();
+    bool isEmpty() const;
+    // Обработка блока на месте, frames <= MaxBlockFrames
+    void process(float *buffer, int frames);
+    // Хвост графа: сумма хвостов узлов расписания (с запасом для цепочки)
+    qint64 tailFrames() const;
+
+    // Цепочка из описания "filter:lowpass,1200,0.7;delay:350,0.4,0.3;reverb:0.7,0.5,0.25"
+    // (параметры по порядку, недостающие - по умолчанию; режим фильтра можно
+    // опустить: "filter:1200,0.7" - lowpass). false - ошибка в описании
+    bool parseChain(const QString &spec, QString *error = nullptr);
+
+private:
+    Q_DISABLE_COPY(EffectGraph)
+
+    // Шаг расписания: узел, его буфер и буферы входов
+    struct Step
+    {
+        EffectNode *node;
+        float *buffer;
+        int inputCount;
+        const float *inputs[MaxNodes + 1];
+    };
+
+    bool compile();
+    static void mix(float *out, const float *const *inputs, int count, int frames);
+
+    EffectNode *m_nodes[MaxNodes];
+    quint32 m_edges[MaxNodes]; // Бит i - ребро от узла i
+    bool m_fromInput[MaxNodes]; // Ребро от входа графа
+    quint32 m_toOutput; // Бит i - ребро от узла i к выходу
+    bool m_dry; // Ребро от входа прямо к выходу
+    int m_sampleRate;
+    // Расписание
+    Step m_steps[MaxNodes];
+    int m_stepCount;
+    const float *m_outputs[MaxNodes + 1];
+    int m_outputCount;
+    bool m_bypass;
+    float m_buffers[MaxNodes][MaxBlockFrames];
+    float m_input[MaxBlockFrames]; // Копия входа (буфер вывода перезаписывается)
+};
+
+#endif // EFFECTGRAPH_H
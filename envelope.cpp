@@ -0,0 +1,214 @@
+#include <cmath>
+#include "envelope.h"
+
+namespace {
+
+// Экспонента стремится не к уровню ступени, а к асимптоте за ним, и достигает
+// уровня ступени за ее время. Отношение - запас асимптоты к высоте ступени:
+// атака выпуклая (запас 0.3), спад и затухание - почти -60 дБ к концу ступени
+const float risingRatio = 0.3f;
+const float fallingRatio = 0.001f;
+
+const char *const curveNames[] = {"linear", "exponential"};
+
+} // namespace
+
+EnvelopeShape::EnvelopeShape()
+    : m_count(0)
+    , m_sustain(-1)
+    , m_sampleRate(44100)
+{
+    addStage(1.0f, 20.0, Curve::exponential);
+    addStage(1.0f, 0.0, Curve::exponential);
+    addStage(0.0f, 20.0, Curve::exponential);
+    setSustainStage(1);
+}
+
+EnvelopeShape EnvelopeShape::adsr(qreal attackMs, qreal decayMs, qreal sustainLevel, qreal releaseMs, Curve curve)
+{
+    EnvelopeShape shape;
+    shape.clear();
+    const float sustain = float(qBound(0.0, sustainLevel, 1.0));
+    shape.addStage(1.0f, attackMs, curve);
+    shape.addStage(sustain, decayMs, curve);
+    shape.addStage(0.0f, releaseMs, curve);
+    shape.setSustainStage(1);
+    return shape;
+}
+
+void EnvelopeShape::clear()
+{
+    m_count = 0;
+    m_sustain = -1;
+}
+
+bool EnvelopeShape::addStage(float level, qreal timeMs, Curve curve)
+{
+    if (m_count == MaxStages) {
+        return false;
+    }
+    Stage &stage = m_stages[m_count++];
+    stage.level = qBound(0.0f, level, 1.0f);
+    stage.timeMs = qMax(0.0, timeMs);
+    stage.curve = curve;
+    stage.frames = quint32(stage.timeMs * m_sampleRate / 1000.0 + 0.5);
+    return true;
+}
+
+void EnvelopeShape::setSustainStage(int stage)
+{
+    m_sustain = (stage >= 0 && stage < m_count) ? stage : -1;
+}
+
+// Пересчет длительностей ступеней в сэмплы
+void EnvelopeShape::setSampleRate(int sampleRate)
+{
+    m_sampleRate = qMax(1, sampleRate);
+    for (int i = 0; i < m_count; ++i) {
+        m_stages[i].frames = quint32(m_stages[i].timeMs * m_sampleRate / 1000.0 + 0.5);
+    }
+}
+
+QString EnvelopeShape::curveName(Curve curve)
+{
+    return QString(curveNames[int(curve)]);
+}
+
+bool EnvelopeShape::parseCurve(const QString &name, Curve *curve)
+{
+    for (int i = 0; i < 2; ++i) {
+        if (name == curveNames[i]) {
+            *curve = Curve(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+Envelope::Envelope()
+{
+    reset();
+}
+
+void Envelope::reset()
+{
+    m_stage = -1;
+    m_released = false;
+    m_level = 0.0f;
+    m_end = 0.0f;
+    m_target = 0.0f;
+    m_slope = 0.0f;
+    m_logFactor = 0.0f;
+    m_blockFactor = 1.0f;
+    m_blockFrames = 0;
+    m_remaining = 0;
+}
+
+// Нажатие: первая ступень с текущего уровня (повторное нажатие и кража голоса
+// продолжают огибающую без скачка)
+void Envelope::trigger(const EnvelopeShape &shape, int blockFrames)
+{
+    m_released = false;
+    if (shape.stageCount() == 0) {
+        m_stage = -1;
+        m_level = 0.0f;
+        return;
+    }
+    enterStage(shape, 0, blockFrames);
+}
+
+// Отпускание: ступени после точки удержания с текущего уровня. Огибающая
+// без удержания доигрывает свои ступени
+void Envelope::release(const EnvelopeShape &shape, int blockFrames)
+{
+    if (m_released || m_stage < 0) {
+        return;
+    }
+    m_released = true;
+    const int sustain = shape.sustainStage();
+    if (sustain < 0) {
+        return;
+    }
+    if (sustain + 1 < shape.stageCount()) {
+        enterStage(shape, sustain + 1, blockFrames);
+    } else {
+        reset();
+    }
+}
+
+// Вход в ступень. Время ступени пропорционально оставшемуся расстоянию до ее
+// уровня (скорость ступени постоянна); ступени нулевой длины проходятся сразу
+void Envelope::enterStage(const EnvelopeShape &shape, int stage, int blockFrames)
+{
+    const int sustain = shape.sustainStage();
+    for (; stage < shape.stageCount(); ++stage) {
+        const EnvelopeShape::Stage &s = shape.stage(stage);
+        const float nominalStart = (stage == 0) ? 0.0f : shape.stage(stage - 1).level;
+        const float nominalDistance = std::fabs(s.level - nominalStart);
+        const float distance = std::fabs(s.level - m_level);
+        quint32 frames = s.frames;
+        if (nominalDistance > 0.0f) {
+            frames = quint32(qMin(1.0f, distance / nominalDistance) * float(frames) + 0.5f);
+        }
+        if (frames > 0) {
+            m_stage = stage;
+            m_end = s.level;
+            m_remaining = frames;
+            m_blockFrames = blockFrames;
+            if (s.curve == EnvelopeShape::Curve::exponential && distance > 0.0f) {
+                // y[n+1] = target + (y[n] - target) * k, за frames сэмплов y доходит до уровня
+                const float ratio = (s.level > m_level) ? risingRatio : fallingRatio;
+                m_target = s.level + (s.level - m_level) * ratio;
+                m_logFactor = float(std::log(ratio / (1.0 + ratio)) / frames);
+                m_blockFactor = float(std::exp(qreal(m_logFactor) * blockFrames));
+                m_slope = 0.0f;
+            } else {
+                m_target = s.level;
+                m_logFactor = 0.0f;
+                m_blockFactor = 1.0f;
+                m_slope = (s.level - m_level) / float(frames);
+            }
+            return;
+        }
+        m_level = s.level;
+        if (stage == sustain && !m_released) {
+            break; // Удержание на уровне ступени
+        }
+    }
+    if (stage < shape.stageCount() && stage == sustain && !m_released) {
+        m_stage = stage;
+        m_end = m_level;
+        m_remaining = 0;
+        m_slope = 0.0f;
+        m_logFactor = 0.0f;
+        return;
+    }
+    // Ступени кончились
+    reset();
+}
+
+float Envelope::advance(const EnvelopeShape &shape, int frames)
+{
+    if (m_remaining == 0) {
+        return m_level; // Удержание
+    }
+    if (m_logFactor != 0.0f) {
+        const float factor = (frames == m_blockFrames) ? m_blockFactor
+                                                      : float(std::exp(qreal(m_logFactor) * frames));
+        m_level = m_target + (m_level - m_target) * factor;
+    } else {
+        m_level += m_slope * float(frames);
+    }
+    m_remaining -= quint32(frames);
+    if (m_remaining == 0) {
+        // Конец ступени: точный уровень, затем удержание или следующая ступень
+        m_level = m_end;
+        if (m_stage == shape.sustainStage() && !m_released) {
+            m_slope = 0.0f;
+            m_logFactor = 0.0f;
+        } else {
+            enterStage(shape, m_stage + 1, m_blockFrames);
+        }
+    }
+    return m_level;
+}
@@ -0,0 +1,108 @@
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#include <QString>
+#include <QtGlobal>
+
+// Описание многоступенчатой огибающей. Каждая ступень - переход к своему уровню
+// за заданное время, линейный или экспоненциальный. Ступени до точки удержания
+// включительно проходятся после нажатия, остальные - после отпускания.
+// ADSR - частный случай: атака, спад, затухание
+class EnvelopeShape
+{
+public:
+    static const int MaxStages = 8;
+
+    enum class Curve : int { linear, exponential };
+
+    struct Stage
+    {
+        float level;    // Уровень в конце ступени (0..1)
+        qreal timeMs;   // Длительность перехода от уровня предыдущей ступени
+        Curve curve;
+        quint32 frames; // Длительность в сэмплах при текущей частоте дискретизации
+    };
+
+    // По умолчанию - ADSR 20 мс / 0 / 1.0 / 20 мс с экспоненциальными ступенями
+    EnvelopeShape();
+
+    static EnvelopeShape adsr(qreal attackMs,
+                              qreal decayMs,
+                              qreal sustainLevel,
+                              qreal releaseMs,
+                              Curve curve = Curve::exponential);
+
+    void clear();
+    // false - ступеней уже MaxStages
+    bool addStage(float level, qreal timeMs, Curve curve);
+    // Ступень, на уровне которой огибающая держится до отпускания, -1 - без
+    // удержания (огибающая проходит все ступени и затихает сама)
+    void setSustainStage(int stage);
+    void setSampleRate(int sampleRate);
+
+    int stageCount() const { return m_count; }
+    const Stage &stage(int index) const { return m_stages[index]; }
+    int sustainStage() const { return m_sustain; }
+
+    static QString curveName(Curve curve);
+    // Форма по имени, false - имя неизвестно
+    static bool parseCurve(const QString &name, Curve *curve);
+
+private:
+    Stage m_stages[MaxStages];
+    int m_count;
+    int m_sustain;
+    int m_sampleRate;
+};
+
+// Огибающая одного голоса. Уровень вычисляется на границах отрезков (блоков):
+// экспоненциальная ступень - рекуррентно, одним умножением на блок, линейная -
+// одним сложением. Внутри отрезка уровень интерполируется линейно, и этот наклон
+// получает векторное ядро генератора. Новое нажатие и отпускание начинаются
+// с текущего уровня, поэтому огибающая не прыгает (нет щелчков)
+class Envelope
+{
+public:
+    Envelope();
+
+    // Переход в тишину с нулевым уровнем
+    void reset();
+    // Нажатие и отпускание. blockFrames - обычная длина отрезка, для нее
+    // множитель экспоненты вычисляется заранее
+    void trigger(const EnvelopeShape &shape, int blockFrames);
+    void release(const EnvelopeShape &shape, int blockFrames);
+
+    bool isActive() const { return m_stage >= 0; }
+    bool isReleased() const { return m_released; }
+    float level() const { return m_level; }
+    // Огибающая на последней ступени спадает и уже тише level: остаток
+    // неслышен, голос можно освободить досрочно
+    bool hasFaded(const EnvelopeShape &shape, float level) const
+    {
+        return m_stage >= 0 && m_stage == shape.stageCount() - 1 && m_end <= m_level && m_level < level;
+    }
+
+    // Длина отрезка до смены ступени, не больше frames
+    int segment(int frames) const
+    {
+        return (m_remaining == 0 || quint32(frames) < m_remaining) ? frames : int(m_remaining);
+    }
+    // Продвижение на frames сэмплов (не больше segment()), возвращает новый уровень
+    float advance(const EnvelopeShape &shape, int frames);
+
+private:
+    void enterStage(const EnvelopeShape &shape, int stage, int blockFrames);
+
+    int m_stage;          // Текущая ступень, -1 - тишина
+    bool m_released;      // Отпускание уже было
+    float m_level;        // Уровень на текущей границе отрезка
+    float m_end;          // Уровень в конце ступени
+    float m_target;       // Асимптота экспоненты
+    float m_slope;        // Приращение за сэмпл (линейная ступень)
+    float m_logFactor;    // Логарифм множителя за сэмпл (экспоненциальная ступень)
+    float m_blockFactor;  // Множитель за отрезок длиной m_blockFrames
+    int m_blockFrames;
+    quint32 m_remaining;  // Сэмплов до конца ступени, 0 - удержание
+};
+
+#endif // ENVELOPE_H
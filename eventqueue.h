@@ -0,0 +1,85 @@
+#ifndef EVENTQUEUE_H
+#define EVENTQUEUE_H
+
+#include <atomic>
+#include <QtGlobal>
+
+// Событие синтезатора с временной меткой в сэмплах
+struct SynthEvent
+{
+    enum class Type : quint8 {
+        noteOn,
+        noteOff,
+        allNotesOff,
+        waveform,
+        pitchBend,
+        controlChange,
+        tuning,
+        parameter,
+        program,
+        legato
+    };
+
+    quint64 frame; // Абсолютная позиция сэмпла, с которой событие вступает в силу
+    Type type;     // Тип события
+    quint8 note;   // Номер ноты (MIDI), формы волны, контроллера, строя, параметра
+                   // или программы (NoProgram - встроенная)
+    quint8 source; // Легато: нота, голос которой переходит на note
+    float value;   // Громкость нажатия, значение контроллера (0..1), изгиб (-1..1), частота A4
+                   // или значение параметра
+
+    static const quint8 NoProgram = 0xff;
+};
+
+// Очередь без блокировок для одного писателя и одного читателя (wait-free).
+// Писатель - поток GUI или поток MIDI, читатель - readData(). Емкость - степень двойки
+template <typename T, int Capacity>
+class SpscQueue
+{
+    static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0,
+                  "capacity must be a power of two");
+
+public:
+    SpscQueue()
+        : m_head(0)
+        , m_tail(0)
+    {}
+
+    // Добавление элемента (только писатель). false - очередь заполнена
+    bool push(const T &item)
+    {
+        const quint32 head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == quint32(Capacity)) {
+            return false;
+        }
+        m_items[head & (Capacity - 1)] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Первый элемент без извлечения (только читатель). nullptr - очередь пуста
+    const T *front() const
+    {
+        const quint32 tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &m_items[tail & (Capacity - 1)];
+    }
+
+    // Удаление первого элемента (только читатель, после front() != nullptr)
+    void pop()
+    {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    // Индексы разнесены по разным кэш-линиям, чтобы потоки не мешали друг другу
+    std::atomic<quint32> m_head; // Позиция записи
+    char m_headPad[64 - sizeof(std::atomic<quint32>)];
+    std::atomic<quint32> m_tail; // Позиция чтения
+    char m_tailPad[64 - sizeof(std::atomic<quint32>)];
+    T m_items[Capacity];
+};
+
+#endif // EVENTQUEUE_H
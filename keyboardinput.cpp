@@ -0,0 +1,134 @@
+#include "keyboardinput.h"
+
+KeyboardInput::KeyboardInput(ToneSynthesizer *synth)
+    : m_synth(synth)
+    , m_mode(Mode::poly)
+    , m_orderCount(0)
+    , m_sounding(-1)
+    , m_velocity(1.0f)
+{}
+
+void KeyboardInput::setMode(Mode mode, qint64 timeNs)
+{
+    if (mode != m_mode) {
+        releaseAll(timeNs);
+        m_mode = mode;
+    }
+}
+
+KeyboardInput::Mode KeyboardInput::mode() const
+{
+    return m_mode;
+}
+
+bool KeyboardInput::isHeld(int note) const
+{
+    return note >= 0 && note < NoteTuning::Notes && m_held.test(size_t(note));
+}
+
+int KeyboardInput::heldCount() const
+{
+    return m_orderCount;
+}
+
+// Событие ноты в очередь GUI синтезатора
+void KeyboardInput::post(SynthEvent::Type type, int note, int source, float velocity, quint64 frame)
+{
+    SynthEvent event;
+    event.frame = frame;
+    event.type = type;
+    event.note = quint8(note);
+    event.source = quint8(source);
+    event.value = velocity;
+    m_synth->postEvent(event, ToneSynthesizer::EventPort::gui);
+}
+
+// Нажатие: все события одного нажатия вступают в силу на одном сэмпле,
+// выключение прежней ноты - раньше включения новой
+bool KeyboardInput::press(int note, qint64 timeNs, float velocity)
+{
+    if (note < 0 || note >= NoteTuning::Notes || m_held.test(size_t(note))) {
+        return false;
+    }
+    const quint64 frame = m_synth->frameAtTime(timeNs);
+    if (m_held.none()) {
+        m_synth->probeLatency(timeNs, frame);
+    }
+    m_held.set(size_t(note));
+    m_order[m_orderCount++] = quint8(note);
+    switch (m_mode) {
+    case Mode::poly:
+        post(SynthEvent::Type::noteOn, note, note, velocity, frame);
+        return true;
+    case Mode::mono:
+        if (m_sounding >= 0) {
+            post(SynthEvent::Type::noteOff, m_sounding, m_sounding, 0.0f, frame);
+        }
+        post(SynthEvent::Type::noteOn, note, note, velocity, frame);
+        break;
+    case Mode::legato:
+        if (m_sounding >= 0) {
+            post(SynthEvent::Type::legato, note, m_sounding, velocity, frame);
+        } else {
+            post(SynthEvent::Type::noteOn, note, note, velocity, frame);
+        }
+        break;
+    }
+    m_sounding = note;
+    m_velocity = velocity;
+    return true;
+}
+
+// Отпускание: в одноголосных режимах звучащая нота уступает последней
+// из удерживаемых, отпускание остальных только убирает их из очереди
+bool KeyboardInput::release(int note, qint64 timeNs)
+{
+    if (note < 0 || note >= NoteTuning::Notes || !m_held.test(size_t(note))) {
+        return false;
+    }
+    m_held.reset(size_t(note));
+    int i = 0;
+    while (m_order[i] != note) {
+        ++i;
+    }
+    for (--m_orderCount; i < m_orderCount; ++i) {
+        m_order[i] = m_order[i + 1];
+    }
+    const quint64 frame = m_synth->frameAtTime(timeNs);
+    if (m_mode == Mode::poly) {
+        post(SynthEvent::Type::noteOff, note, note, 0.0f, frame);
+        return true;
+    }
+    if (note != m_sounding) {
+        return true;
+    }
+    if (m_orderCount == 0) {
+        post(SynthEvent::Type::noteOff, note, note, 0.0f, frame);
+        m_sounding = -1;
+        return true;
+    }
+    const int previous = m_order[m_orderCount - 1];
+    if (m_mode == Mode::legato) {
+        post(SynthEvent::Type::legato, previous, note, m_velocity, frame);
+    } else {
+        post(SynthEvent::Type::noteOff, note, note, 0.0f, frame);
+        post(SynthEvent::Type::noteOn, previous, previous, m_velocity, frame);
+    }
+    m_sounding = previous;
+    return true;
+}
+
+void KeyboardInput::releaseAll(qint64 timeNs)
+{
+    const quint64 frame = m_synth->frameAtTime(timeNs);
+    if (m_mode == Mode::poly) {
+        for (int i = 0; i < m_orderCount; ++i) {
+            post(SynthEvent::Type::noteOff, m_order[i], m_order[i], 0.0f, frame);
+        }
+    } else if (m_sounding >= 0) {
+        post(SynthEvent::Type::noteOff, m_sounding, m_sounding, 0.0f, frame);
+    }
+    m_held.reset();
+    m_orderCount = 0;
+    m_sounding = -1;
+}
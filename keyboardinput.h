@@ -0,0 +1,50 @@
+#ifndef KEYBOARDINPUT_H
+#define KEYBOARDINPUT_H
+
+#include <bitset>
+#include <QtGlobal>
+#include "tonesynth.h" // Синтезатор
+
+// Ноты с клавиатуры компьютера и кнопок окна (поток GUI). Нажатые ноты хранятся
+// набором битов: повторное нажатие (автоповтор, та же нота кнопкой) ноту
+// не перезапускает, отпускание выключает только свою ноту. События с номером
+// ноты и сэмплом момента нажатия идут прямо в очередь GUI синтезатора.
+// В одноголосных режимах звучит последняя нажатая нота, после ее отпускания -
+// предыдущая из удерживаемых
+class KeyboardInput
+{
+public:
+    // poly - каждая нота своим голосом; mono - одна нота, каждая смена с атакой;
+    // legato - одна нота, смена без новой атаки с переходом высоты за время glide
+    enum class Mode : int { poly, mono, legato };
+
+    explicit KeyboardInput(ToneSynthesizer *synth);
+
+    // Смена режима отпускает все ноты
+    void setMode(Mode mode, qint64 timeNs);
+    Mode mode() const;
+
+    // Нажатие и отпускание ноты (0..127) в момент timeNs (монотонное время).
+    // false - нота уже нажата (отпущена) или вне диапазона. Нажатие при пустой
+    // клавиатуре заказывает у синтезатора замер задержки
+    bool press(int note, qint64 timeNs, float velocity = 1.0f);
+    bool release(int note, qint64 timeNs);
+    // Отпускание всех нот (окно потеряло фокус, клавиши отпущены вне его)
+    void releaseAll(qint64 timeNs);
+
+    bool isHeld(int note) const;
+    int heldCount() const;
+
+private:
+    void post(SynthEvent::Type type, int note, int source, float velocity, quint64 frame);
+
+    ToneSynthesizer *m_synth;
+    Mode m_mode;
+    std::bitset<NoteTuning::Notes> m_held; // Нажатые ноты
+    quint8 m_order[NoteTuning::Notes];     // Нажатые ноты по порядку нажатия
+    int m_orderCount;
+    int m_sounding; // Звучащая нота одноголосного режима, -1 - нет
+    float m_velocity; // Громкость звучащей ноты (для возврата к удерживаемой)
+};
+
+#endif // KEYBOARDINPUT_H
@@ -0,0 +1,90 @@
+#include "latencycontroller.h"
+
+namespace {
+// Сколько времени без опустошений нужно, чтобы попробовать меньший буфер
+const qint64 shrinkIntervalMs = 5000;
+// Нагрузка, выше которой буфер не уменьшается
+const qreal maxShrinkLoad = 0.5;
+}
+
+LatencyController::LatencyController()
+    : m_minBytes(0)
+    , m_maxBytes(0)
+    , m_bytesPerSecond(1)
+    , m_target(0)
+    , m_lastUnderruns(0)
+    , m_stableSinceMs(-1)
+{
+    for (int i = 0; i < AudioTelemetry::JitterBuckets; ++i) {
+        m_lastJitter[i] = 0;
+    }
+}
+
+void LatencyController::reset(qint64 minBytes, qint64 maxBytes, qint64 bytesPerSecond)
+{
+    m_minBytes = minBytes;
+    m_maxBytes = qMax(minBytes, maxBytes);
+    m_bytesPerSecond = qMax<qint64>(bytesPerSecond, 1);
+    m_target = m_minBytes; // Начинаем с наименьшей задержки
+    m_lastUnderruns = 0;
+    m_stableSinceMs = -1;
+    for (int i = 0; i < AudioTelemetry::JitterBuckets; ++i) {
+        m_lastJitter[i] = 0;
+    }
+}
+
+void LatencyController::setMaximum(qint64 maxBytes)
+{
+    m_maxBytes = qMax(m_minBytes, maxBytes);
+    m_target = qMin(m_target, m_maxBytes);
+}
+
+qint64 LatencyController::update(const AudioTelemetry::Snapshot &s, qint64 nowMs)
+{
+    // Размер порции, которую запрашивает устройство, - нижняя граница: меньше
+    // двух порций буфер опустошается при любой задержке вызова
+    const qint64 period = s.minRequestBytes;
+    const qint64 floor = qBound(m_minBytes, period * 2, m_maxBytes);
+
+    // Худшее отклонение интервала вызовов с прошлого замера
+    qint64 worstJitterUs = 0;
+    for (int i = 0; i < AudioTelemetry::JitterBuckets; ++i) {
+        if (s.jitter[i] < m_lastJitter[i]) {
+            m_lastJitter[i] = 0; // Показатели были сброшены
+        }
+        if (s.jitter[i] > m_lastJitter[i]) {
+            worstJitterUs = (i < AudioTelemetry::JitterBuckets - 1)
+                                ? AudioTelemetry::JitterBounds[i]
+                                : 2 * AudioTelemetry::JitterBounds[i - 1];
+        }
+        m_lastJitter[i] = s.jitter[i];
+    }
+    if (s.underruns < m_lastUnderruns) {
+        m_lastUnderruns = 0;
+    }
+
+    if (m_stableSinceMs < 0) {
+        m_stableSinceMs = nowMs;
+    }
+    if (s.underruns > m_lastUnderruns) {
+        // Опустошение: заметный шаг вверх и новый отсчет устойчивого периода
+        m_target = qMin(m_maxBytes, m_target * 3 / 2 + period);
+        m_stableSinceMs = nowMs;
+    } else if (nowMs - m_stableSinceMs >= shrinkIntervalMs) {
+        // Запас: после уменьшения буфер должен покрывать худшее дрожание и порцию
+        const qint64 jitterBytes = worstJitterUs * m_bytesPerSecond / 1000000;
+        const qint64 candidate = m_target * 9 / 10;
+        if (s.dspLoad < maxShrinkLoad && candidate >= 2 * jitterBytes + period) {
+            m_target = candidate;
+        }
+        m_stableSinceMs = nowMs;
+    }
+    m_lastUnderruns = s.underruns;
+    m_target = qBound(floor, m_target, m_maxBytes);
+    return m_target;
+}
+
+qint64 LatencyController::target() const
+{
+    return m_target;
+}
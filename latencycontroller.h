@@ -0,0 +1,31 @@
+#ifndef LATENCYCONTROLLER_H
+#define LATENCYCONTROLLER_H
+
+#include <QtGlobal>
+#include "telemetry.h"
+
+// Подбор наименьшей устойчивой задержки вывода. Начинает с минимального буфера,
+// увеличивает его после опустошений и медленно уменьшает, пока есть запас
+// по времени генерации и дрожанию вызовов. Размеры - в байтах формата устройства
+class LatencyController
+{
+public:
+    LatencyController();
+
+    void reset(qint64 minBytes, qint64 maxBytes, qint64 bytesPerSecond);
+    void setMaximum(qint64 maxBytes);
+    // Очередной замер показателей; возвращает новый целевой размер буфера
+    qint64 update(const AudioTelemetry::Snapshot &snapshot, qint64 nowMs);
+    qint64 target() const;
+
+private:
+    qint64 m_minBytes;
+    qint64 m_maxBytes;
+    qint64 m_bytesPerSecond;
+    qint64 m_target;
+    quint64 m_lastUnderruns;
+    quint64 m_lastJitter[AudioTelemetry::JitterBuckets];
+    qint64 m_stableSinceMs;
+};
+
+#endif // LATENCYCONTROLLER_H
@@ -8,6 +8,15 @@ int main(int argc, char *argv[])
     QApplication a(argc, argv);
      // Создаем объект главного окна
     MainWindow w;
+    // Набор патчей (.msp) и MIDI-файл из командной строки; файл воспроизводится
+    // вместо входа секвенсора
+    for (const QString &argument : a.arguments().mid(1)) {
+        if (argument.endsWith(".msp", Qt::CaseInsensitive)) {
+            w.loadPatches(argument);
+        } else {
+            w.playMidiFile(argument);
+        }
+    }
     // Отображаем главное окно
     w.show();
      // Запускаем цикл обработки событий приложения
@@ -3,6 +3,12 @@
 #if !defined(Q_OS_WASM)
 #include <QMessageBox> // Для отображения диалоговых окон
 #endif
+#include <QFile>
+#include <QFileDialog> // Выбор файла для сохранения показателей
+#include <QCoreApplication> // Папка программы
+#include <QFileInfo>
+#include <QSignalBlocker>
+#include <QTextStream>
 #include <QTimer>
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 // Для Qt5
@@ -29,20 +35,36 @@ MainWindow::MainWindow(QWidget *parent)
     , m_bufferTime(100) // Размер буфера в мс
 #endif
     , m_running(false) // Изначально аудио не запущено
+    , m_deviceBufferBytes(0)
+    , m_lastXrunNs(0)
 {
     //qDebug() << Q_FUNC_INFO;
     m_ui->setupUi(this); // Настраиваем пользовательский интерфейс
     initializeWindow(); // Инициализируем окно
+    // Набор патчей рядом с программой загружается до запуска вывода
+    const QString patches = QCoreApplication::applicationDirPath() + "/minisynth.msp";
+    if (QFile::exists(patches)) {
+        loadPatches(patches);
+    }
     initializeAudio(); // Инициализируем аудио
+    initializeMidi(); // Подключаем вход MIDI
 }
 
 MainWindow::~MainWindow()
 {
     //qDebug() << Q_FUNC_INFO;
+    m_midiInput.reset(); // Поток MIDI останавливается раньше синтезатора
+    m_telemetryTimer.stop();
+    m_watchdog.stop(); // Наблюдение прекращается до остановки вывода
+    // Вывода может не быть: initializeAudio() не создает его, если формат не подошел
+    if (!m_audioOutput.isNull()) {
+        m_audioOutput->stop();
+    }
 #if !defined(Q_OS_WASM)
-    m_stallDetector.stop(); // Останавливаем таймер stallDetector
+    if (!m_renderThread.isNull()) {
+        m_renderThread->stopRendering(); // Генерация останавливается до синтезатора
+    }
 #endif
-    m_audioOutput->stop();
     if (!m_synth.isNull()) {
         m_synth->stop();
     }
@@ -52,57 +74,70 @@ MainWindow::~MainWindow()
 void MainWindow::initializeWindow()
 {
     //qDebug() << Q_FUNC_INFO;
-    m_format.setSampleRate(44100); // Частота дискретизации
+    // Начальный формат (моно, float, 44100 Гц); при запуске вывода он заменяется
+    // родным форматом выбранного устройства
+    m_format = ToneSynthesizer::makeFormat(44100, 1, RenderKernels::SampleFormat::float32);
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    m_format.setChannelCount(1); // Моно
-    m_format.setSampleSize(sizeof(float) * CHAR_BIT); // Устанавливаем размер сэмпла (float = 32 бита)
-    m_format.setCodec("audio/pcm"); // Устанавливаем кодек PCM
-    m_format.setByteOrder(QAudioFormat::LittleEndian);  // Устанавливаем порядок байт LittleEndian
-    m_format.setSampleType(QAudioFormat::Float); // Устанавливаем тип сэмпла Float
     const QAudioDeviceInfo &defaultDeviceInfo = QAudioDeviceInfo::defaultOutputDevice();
     m_ui->deviceBox->addItem(defaultDeviceInfo.deviceName(), QVariant::fromValue(defaultDeviceInfo));
     for (auto &deviceInfo : QAudioDeviceInfo::availableDevices(QAudio::AudioOutput)) {
-        if (deviceInfo != defaultDeviceInfo && deviceInfo.isFormatSupported(m_format))
+        if (deviceInfo != defaultDeviceInfo && chooseFormat(deviceInfo).isValid())
             m_ui->deviceBox->addItem(deviceInfo.deviceName(), QVariant::fromValue(deviceInfo));
     }
     m_ui->deviceBox->setCurrentText(defaultDeviceInfo.deviceName());
 #else
-    m_format.setChannelConfig(QAudioFormat::ChannelConfigMono);  // Моно
-    m_format.setSampleFormat(QAudioFormat::Float); // Формат сэмпла - float
     const QAudioDevice &defaultDeviceInfo = QMediaDevices::defaultAudioOutput();
     m_ui->deviceBox->addItem(defaultDeviceInfo.description(),
                              QVariant::fromValue(defaultDeviceInfo));
     for (auto &deviceInfo : QMediaDevices::audioOutputs()) {
-        if (deviceInfo != defaultDeviceInfo && deviceInfo.isFormatSupported(m_format))
+        if (deviceInfo != defaultDeviceInfo && chooseFormat(deviceInfo).isValid())
             m_ui->deviceBox->addItem(deviceInfo.description(), QVariant::fromValue(deviceInfo));
     }
     m_ui->deviceBox->setCurrentText(defaultDeviceInfo.description());
 #endif
     m_synth.reset(new ToneSynthesizer(m_format));
+    m_keyboard.reset(new KeyboardInput(m_synth.data()));
+#if !defined(Q_OS_WASM)
+    m_synth->setRecorder(&m_recorder);
+    m_renderThread.reset(new RenderThread(m_synth.data()));
+#endif
     m_ui->bufferSpin->setValue(m_bufferTime);
     connect(m_ui->deviceBox, SIGNAL(activated(int)), this, SLOT(deviceChanged(int)));
     connect(m_ui->volumeSlider, SIGNAL(valueChanged(int)), this, SLOT(volumeChanged(int)));
     connect(m_ui->bufferSpin, SIGNAL(valueChanged(int)), this, SLOT(bufferChanged(int)));
+    connect(m_ui->adaptiveCheck, SIGNAL(toggled(bool)), this, SLOT(adaptiveChanged(bool)));
     connect(m_ui->octaveSpin, SIGNAL(valueChanged(int)), this, SLOT(octaveChanged(int)));
-#if !defined(Q_OS_WASM)
-    connect(this, &MainWindow::underrunDetected, this, &MainWindow::underrunMessage);
-    connect(this, &MainWindow::stallDetected, this, &MainWindow::stallMessage);
-    connect(&m_stallDetector, &QTimer::timeout, this, [=] {
-        if (m_running) {
-            if (m_synth->lastBufferSize() == 0) {
-                emit stallDetected();
-            }
-            m_synth->resetLastBufferSize();
-        }
-    });
+    connect(m_ui->glideSpin, SIGNAL(valueChanged(int)), this, SLOT(glideChanged(int)));
+    connect(m_ui->modeBox, SIGNAL(currentIndexChanged(int)), this, SLOT(keyboardModeChanged(int)));
+    connect(m_ui->waveBox, SIGNAL(currentIndexChanged(int)), this, SLOT(waveformChanged(int)));
+    connect(&m_watchdog, &AudioWatchdog::xrunDetected, this, &MainWindow::xrunDetected);
+    connect(&m_watchdog, &AudioWatchdog::stallChanged, this, &MainWindow::stallChanged);
+    // Показатели звукового потока обновляются четыре раза в секунду
+    connect(&m_telemetryTimer, &QTimer::timeout, this, &MainWindow::updateTelemetry);
+    connect(m_ui->dumpButton, &QPushButton::clicked, this, &MainWindow::dumpTelemetry);
+#if defined(Q_OS_WASM)
+    m_ui->recordButton->hide();
+#else
+    connect(m_ui->recordButton, &QPushButton::toggled, this, &MainWindow::recordToggled);
 #endif
+    m_telemetryClock.start();
+    m_telemetryTimer.start(250);
      // Подключение кнопок к синтезатору
     auto buttons = findChildren<QPushButton *>();
     // Для каждой кнопки
     foreach (const auto btn, buttons) {
-        connect(btn, &QPushButton::pressed, this, [=] { m_synth->noteOn(btn->text()); });
-        // Соединяем сигнал pressed() (нажатие кнопки) с лямбда-функцией, которая вызывает noteOn() синтезатора
-        connect(btn, &QPushButton::released, m_synth.get(), &ToneSynthesizer::noteOff);
+        if (btn == m_ui->dumpButton || btn == m_ui->recordButton) {
+            continue; // Служебная кнопка, не клавиша
+        }
+        // Полутон кнопки определяется один раз, при нажатии остается только сложение
+        const int semitone = semitoneForName(btn->text());
+        // Кнопки идут через тот же учет нажатых нот, что и клавиатура
+        connect(btn, &QPushButton::pressed, this, [=] {
+            m_keyboard->press(noteNumber(semitone), ToneSynthesizer::monotonicNs());
+        });
+        connect(btn, &QPushButton::released, this, [=] {
+            m_keyboard->release(noteNumber(semitone), ToneSynthesizer::monotonicNs());
+        });
     }
 }
 
@@ -117,50 +152,62 @@ void MainWindow::initializeAudio()
     // Для Qt6: получаем объект QAudioDevice из текущего элемента комбобокса deviceBox
     const QAudioDevice deviceInfo = m_ui->deviceBox->currentData().value<QAudioDevice>();
 #endif
-    // Проверяем, поддерживает ли устройство заданный формат
-    if (!deviceInfo.isFormatSupported(m_format)) {
+    // Подбираем формат, который устройство воспроизводит без преобразований
+    const QAudioFormat format = chooseFormat(deviceInfo);
+    // Синтезатор остановлен, формат можно менять
+    if (!format.isValid() || !m_synth->setFormat(format)) {
 #if !defined(Q_OS_WASM)
-        // Если не поддерживает, выводим сообщение об ошибке
+        // Если подходящего формата нет, выводим сообщение об ошибке
         QMessageBox::warning(this,
                              "Audio format not supported",
-                             "The selected audio device does not support the synth's audio format. "
+                             "The selected audio device does not support any of the synth's audio formats. "
                              "Please select another device.");
 #endif
         return;
     }
-    qint64 bufferLength = m_format.bytesForDuration(m_bufferTime * 1000); // Размер буфера в байтах
+    m_format = format;
+    m_ui->deviceBox->setToolTip(formatDescription(m_format));
+    // Буфер устройства открывается с наибольшим допустимым временем, а задержку
+    // определяет ограничение опережения в синтезаторе: его можно менять на ходу,
+    // не пересоздавая вывод
+    qint64 bufferLength = m_format.bytesForDuration(m_ui->bufferSpin->maximum() * 1000); // Размер буфера в байтах
     //    qDebug() << "requested buffer size:" << bufferLength
     //             << "bytes," << m_bufferTime << "milliseconds";
     m_synth->start(); // Запускаем синтезатор
+#if !defined(Q_OS_WASM)
+    m_renderThread->startRendering(); // Генерация идет в своем потоке, вывод только копирует
+#endif
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     // Для Qt5: создаем объект QAudioOutput
     m_audioOutput.reset(new QAudioOutput(deviceInfo, m_format));
-    QObject::connect(m_audioOutput.data(),
-                     &QAudioOutput::stateChanged,
-                     this,
-                     [=](QAudio::State state) {
 #else
     // Для Qt6: создаем объект QAudioSink
     m_audioOutput.reset(new QAudioSink(deviceInfo, m_format));
-    QObject::connect(m_audioOutput.data(), &QAudioSink::stateChanged, this, [=](QAudio::State state) {
-#endif \
-    //qDebug() << "Audio Output state:" << state << "error:" << m_audioOutput->error();
-                         if (m_running && (m_audioOutput->error() == QAudio::UnderrunError)) {
-                             emit underrunDetected();
-                         }
-                     });
+#endif
     m_audioOutput->setBufferSize(bufferLength);
+#if defined(Q_OS_WASM)
     m_audioOutput->start(m_synth.get());
+#else
+    m_audioOutput->start(m_renderThread->stream());
+#endif
     auto bufferTime = m_format.durationForBytes(m_audioOutput->bufferSize()) / 1000; // Вычисляем реальный размер буфера в мс
     //    qDebug() << "applied buffer size:" << m_audioOutput->bufferSize()
     //             << "bytes," << bufferTime << "milliseconds";
+    m_deviceBufferBytes = m_audioOutput->bufferSize();
+    // Адаптивный режим начинает с наименьшей задержки из диапазона bufferSpin
+    m_latency.reset(m_format.bytesForDuration(m_ui->bufferSpin->minimum() * 1000),
+                    m_format.bytesForDuration(m_bufferTime * 1000),
+                    m_format.bytesForDuration(1000000));
+    applyBufferTime();
     volumeChanged(m_ui->volumeSlider->value()); // Устанавливаем начальную громкость
     octaveChanged(m_ui->octaveSpin->value()); // Устанавливаем начальную октаву
+    glideChanged(m_ui->glideSpin->value());
+    // Опустошения вывода определяет наблюдение по часам устройства
+    m_watchdog.start(m_audioOutput.data(), &m_synth->telemetry(), m_format);
 #if !defined(Q_OS_WASM)
-    // Запускаем таймер, который через bufferTime * 2 мс установит флаг m_running в true и запустит таймер m_stallDetector
+    // Запускаем таймер, который через bufferTime * 2 мс установит флаг m_running в true
     QTimer::singleShot(bufferTime * 2, this, [=] {
         m_running = true;
-        m_stallDetector.start(bufferTime * 4);
     });
 #endif
 }
@@ -168,14 +215,29 @@ void MainWindow::initializeAudio()
 void MainWindow::deviceChanged(int index)
 {
     //qDebug() << Q_FUNC_INFO << m_ui->deviceBox->itemText(index);
+    stopAudio();
+    initializeAudio();
+}
+
+// Остановка вывода и генерации перед сменой устройства или набора патчей
+void MainWindow::stopAudio()
+{
+    m_watchdog.stop();
+#if !defined(Q_OS_WASM)
+    m_ui->recordButton->setChecked(false); // Запись идет в формате прежнего устройства
+#endif
+    // Вывода может не быть: initializeAudio() не создает его, если формат не подошел
+    if (!m_audioOutput.isNull()) {
+        m_audioOutput->stop();
+    }
 #if !defined(Q_OS_WASM)
-    m_stallDetector.stop();
+    if (!m_renderThread.isNull()) {
+        m_renderThread->stopRendering(); // Генерация останавливается до синтезатора
+    }
 #endif
-    m_audioOutput->stop();
     if (!m_synth.isNull()) {
         m_synth->stop();
     }
-    initializeAudio();
 }
 
 void MainWindow::volumeChanged(int value)
@@ -185,131 +247,457 @@ void MainWindow::volumeChanged(int value)
     qreal linearVolume = QAudio::convertVolume(value / 100.0,
                                                QAudio::LogarithmicVolumeScale,
                                                QAudio::LinearVolumeScale);
-    m_audioOutput->setVolume(linearVolume);
+    // Громкость меняет синтезатор плавно; громкость вывода зависит от драйвера
+    // и может меняться ступенями
+    m_synth->setParameter(ToneSynthesizer::Parameter::volume, float(linearVolume));
+}
+
+// Формат вывода для устройства: его предпочтительный формат, приведенный
+// к поддерживаемым синтезатором (Int16, Int32 или Float; 1..8 каналов;
+// 44.1, 48 или 96 кГц). Если устройство его не принимает, перебираются остальные
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+QAudioFormat MainWindow::chooseFormat(const QAudioDeviceInfo &deviceInfo)
+#else
+QAudioFormat MainWindow::chooseFormat(const QAudioDevice &deviceInfo)
+#endif
+{
+    const QAudioFormat preferred = deviceInfo.preferredFormat();
+    const int rates[] = {preferred.sampleRate(), 48000, 44100, 96000};
+    const int channelCounts[] = {qBound(1, preferred.channelCount(), ToneSynthesizer::MaxChannels), 2, 1};
+    RenderKernels::SampleFormat sampleFormats[] = {RenderKernels::SampleFormat::float32,
+                                                   RenderKernels::SampleFormat::float32,
+                                                   RenderKernels::SampleFormat::int32,
+                                                   RenderKernels::SampleFormat::int16};
+    if (!ToneSynthesizer::sampleFormat(preferred, &sampleFormats[0])) {
+        sampleFormats[0] = RenderKernels::SampleFormat::float32;
+    }
+    for (int rate : rates) {
+        if (rate != 44100 && rate != 48000 && rate != 96000) {
+            continue;
+        }
+        for (int channels : channelCounts) {
+            for (RenderKernels::SampleFormat sampleFormat : sampleFormats) {
+                const QAudioFormat format = ToneSynthesizer::makeFormat(rate, channels, sampleFormat);
+                if (deviceInfo.isFormatSupported(format)) {
+                    return format;
+                }
+            }
+        }
+    }
+    return QAudioFormat();
 }
 
+// Краткое описание формата для подсказки
+QString MainWindow::formatDescription(const QAudioFormat &format)
+{
+    static const char *const names[] = {"Int16", "Int32", "Float"};
+    RenderKernels::SampleFormat sampleFormat = RenderKernels::SampleFormat::float32;
+    ToneSynthesizer::sampleFormat(format, &sampleFormat);
+    return QString("%1 Hz, %2 ch, %3")
+        .arg(format.sampleRate())
+        .arg(format.channelCount())
+        .arg(names[int(sampleFormat)]);
+}
+
+// Вход MIDI: виртуальный порт секвенсора ALSA, к нему подключается клавиатура
+// или программа (aconnect). Без ALSA ноты приходят только от GUI
+void MainWindow::initializeMidi()
+{
+#if defined(MINISYNTH_HAVE_ALSA)
+    AlsaMidiInput *input = new AlsaMidiInput(m_synth.data());
+    QString error;
+    if (!input->open("minisynth-qt", QString(), &error)) {
+        //qDebug() << error;
+        delete input;
+        return;
+    }
+    m_midiInput.reset(input);
+    m_midiInput->startInput();
+#endif
+}
+
+// Воспроизведение MIDI-файла вместо внешнего входа
+bool MainWindow::playMidiFile(const QString &fileName)
+{
+    MidiFile file;
+    QString error;
+    if (!file.load(fileName, &error)) {
+#if !defined(Q_OS_WASM)
+        QMessageBox::warning(this, "MIDI file", error);
+#endif
+        return false;
+    }
+    m_midiInput.reset(); // У очереди MIDI синтезатора один писатель
+    m_midiInput.reset(new MidiFilePlayer(file, m_synth.data()));
+    m_midiInput->startInput();
+    return true;
+}
+
+// Загрузка набора патчей. Синтезатор хранит указатели на программы, поэтому
+// набор меняется при остановленном выводе, а прежний удаляется после замены
+bool MainWindow::loadPatches(const QString &fileName)
+{
+    QScopedPointer<PatchBank> patches(new PatchBank);
+    QString error;
+    if (!patches->load(fileName, &error)) {
+#if !defined(Q_OS_WASM)
+        QMessageBox::warning(this, "Patches", error);
+#endif
+        return false;
+    }
+    const bool running = !m_audioOutput.isNull();
+    if (running) {
+        stopAudio();
+    }
+    m_synth->setPatchBank(patches.data());
+    m_patches.swap(patches);
+
+    const QSignalBlocker blocker(m_ui->waveBox);
+    while (m_ui->waveBox->count() > Wavetable::WaveformCount) {
+        m_ui->waveBox->removeItem(m_ui->waveBox->count() - 1);
+    }
+    for (int i = 0; i < m_patches->count(); ++i) {
+        m_ui->waveBox->addItem(m_patches->program(i)->name);
+    }
+    m_ui->waveBox->setToolTip(QString("Waveform or Patch (%1)").arg(QFileInfo(fileName).fileName()));
+    if (running) {
+        initializeAudio();
+    }
+    waveformChanged(m_ui->waveBox->currentIndex());
+    return true;
+}
+
+// Время буфера: в ручном режиме - целевая задержка, в адаптивном - ее предел.
+// Вывод не перезапускается, меняется только ограничение опережения
 void MainWindow::bufferChanged(int value)
 {
     if (m_bufferTime != value) {
         m_bufferTime = value;
-        deviceChanged(m_ui->deviceBox->currentIndex());
+        applyBufferTime();
         //qDebug() << Q_FUNC_INFO << value;
     }
 }
 
+void MainWindow::adaptiveChanged(bool enabled)
+{
+    if (enabled) {
+        m_latency.reset(m_format.bytesForDuration(m_ui->bufferSpin->minimum() * 1000),
+                        m_format.bytesForDuration(m_bufferTime * 1000),
+                        m_format.bytesForDuration(1000000));
+    }
+    applyBufferTime();
+}
+
+// Передача целевого заполнения буфера устройства синтезатору
+void MainWindow::applyBufferTime()
+{
+    const qint64 requested = qMin<qint64>(m_format.bytesForDuration(m_bufferTime * 1000),
+                                          m_deviceBufferBytes);
+    qint64 target = requested;
+    if (m_ui->adaptiveCheck->isChecked()) {
+        m_latency.setMaximum(requested);
+        target = m_latency.target();
+    }
+    m_synth->setOutputLimit(m_deviceBufferBytes, target);
+}
+
 void MainWindow::octaveChanged(int value)
 {
     //qDebug() << Q_FUNC_INFO << value;
-    m_synth->setOctave(value);
+    m_synth->setParameter(ToneSynthesizer::Parameter::octave, float(value - KeyboardOctave));
 }
 
-#if !defined(Q_OS_WASM)
-// Слот для вывода сообщения об ошибке Underrun
-void MainWindow::underrunMessage()
+void MainWindow::glideChanged(int value)
 {
-    m_running = false;
-    QMessageBox::warning(this,
-                         "Underrun Error",
-                         "Audio buffer underrun errors have been detected."
-                         " Please increase the buffer time to avoid this problem.");
-    m_running = true;
+    m_synth->setParameter(ToneSynthesizer::Parameter::glide, float(value));
 }
 
-// Слот для вывода сообщения об ошибке Stall
-void MainWindow::stallMessage()
+// Пункты списка в порядке KeyboardInput::Mode
+void MainWindow::keyboardModeChanged(int index)
 {
-    QMessageBox::critical(this,
-                          "Audio Output Stalled",
-                          "Audio output is stalled right now. Sound cannot be produced."
-                          " Please increase the buffer time to avoid this problem.");
-    m_running = false;
-    m_stallDetector.stop();
+    m_keyboard->setMode(KeyboardInput::Mode(index), ToneSynthesizer::monotonicNs());
 }
 
+// Первые пункты списка - встроенные формы волны, за ними программы набора
+void MainWindow::waveformChanged(int index)
+{
+    if (index < Wavetable::WaveformCount) {
+        m_synth->setWaveform(Wavetable::Waveform(index));
+    } else {
+        m_synth->selectProgram(index - Wavetable::WaveformCount);
+    }
+}
 
+// Снятие показателей: строка состояния и запись в журнал
+void MainWindow::updateTelemetry()
+{
+    // Журнал ограничен часом работы
+    static const int maxLogRows = 4 * 3600;
+    AudioTelemetry::Snapshot s = m_synth->telemetry().snapshot();
+    s.timestampMs = m_telemetryClock.elapsed();
+    // Адаптивная задержка подстраивается по тем же показателям
+    qint64 targetBytes = qMin<qint64>(m_format.bytesForDuration(m_bufferTime * 1000),
+                                      m_deviceBufferBytes);
+    if (m_ui->adaptiveCheck->isChecked()) {
+        targetBytes = m_running ? m_latency.update(s, s.timestampMs) : m_latency.target();
+        m_synth->setOutputLimit(m_deviceBufferBytes, targetBytes);
+    }
+    if (m_telemetryLog.size() >= maxLogRows) {
+        m_telemetryLog.remove(0, m_telemetryLog.size() - maxLogRows + 1);
+    }
+    m_telemetryLog.append(s);
 
+    // Корзина гистограммы, в которую попадает 99% интервалов
+    quint64 total = 0;
+    for (int i = 0; i < AudioTelemetry::JitterBuckets; ++i) {
+        total += s.jitter[i];
+    }
+    int p99 = 0;
+    for (quint64 count = 0; p99 < AudioTelemetry::JitterBuckets - 1; ++p99) {
+        count += s.jitter[p99];
+        if (count * 100 >= total * 99) {
+            break;
+        }
+    }
+    const QString jitter = (p99 < AudioTelemetry::JitterBuckets - 1)
+                               ? QString("<%1").arg(AudioTelemetry::JitterBounds[p99] / 1000.0)
+                               : QString(">%1").arg(AudioTelemetry::JitterBounds[p99 - 1] / 1000.0);
+    // Выделение гаснет через секунду после потери, пока вывод не остановлен
+    const qint64 nowNs = ToneSynthesizer::monotonicNs();
+    if (m_watchdog.isStalled()) {
+        m_ui->telemetryLabel->setToolTip("Audio output stalled: the device is not taking data");
+        return;
+    }
+    if (m_lastXrunNs == 0 || nowNs - m_lastXrunNs > 1000000000) {
+        m_ui->telemetryLabel->setStyleSheet(QString());
+    }
+    m_ui->telemetryLabel->setText(QString("DSP %1% (max %2%)  jitter99 %3 ms  "
+                                          "req %4-%5 B  xrun %6  voices %7  buf %8 ms")
+                                      .arg(s.dspLoad * 100.0, 0, 'f', 1)
+                                      .arg(s.maxDspLoad * 100.0, 0, 'f', 1)
+                                      .arg(jitter)
+                                      .arg(s.minRequestBytes)
+                                      .arg(s.maxRequestBytes)
+                                      .arg(s.underruns)
+                                      .arg(s.activeVoices)
+                                      .arg(m_format.durationForBytes(targetBytes) / 1000));
+    QString toolTip = QString("Render time %1 us (max %2 us), %3 callbacks")
+                          .arg(s.renderNs / 1000.0, 0, 'f', 1)
+                          .arg(s.maxRenderNs / 1000.0, 0, 'f', 1)
+                          .arg(s.callbacks);
+    if (m_watchdog.xruns() > 0) {
+        toolTip += QString("\nLost %1 frames (%2 ms) in %3 xruns, last %4 s ago")
+                       .arg(m_watchdog.framesLost())
+                       .arg(m_watchdog.framesLost() * 1000.0 / m_format.sampleRate(), 0, 'f', 1)
+                       .arg(m_watchdog.xruns())
+                       .arg((nowNs - m_lastXrunNs) / 1e9, 0, 'f', 1);
+    }
+#if !defined(Q_OS_WASM)
+    // Удалось ли получить приоритет реального времени и закрепить память
+    toolTip += QString("\nRender thread: %1, %2")
+                   .arg(m_renderThread->isRealtime() ? "real-time" : "normal priority")
+                   .arg(m_renderThread->isMemoryLocked() ? "memory locked" : "memory not locked");
+    if (m_recorder.isRecording()) {
+        // Отброшенные блоки - диск не успевает за записью
+        toolTip += QString("\nRecording: %1 s written, %2 blocks dropped")
+                       .arg(m_recorder.recordedFrames() / qreal(m_format.sampleRate()), 0, 'f', 1)
+                       .arg(m_recorder.droppedBlocks());
+    }
 #endif
+    if (m_synth->streamUnderruns() > 0) {
+        // Подкачка сэмплов не успевает: диск медленнее, чем нужно голосам
+        toolTip += QString("\nSample streaming: %1 late chunks").arg(m_synth->streamUnderruns());
+    }
+    if (s.inputLatencies > 0) {
+        // От обработчика нажатия до первого сэмпла ноты; до слуха еще буфер вывода
+        toolTip += QString("\nKey to first sample: %1 ms (max %2 ms, %3 notes) + %4 ms buffer")
+                       .arg(s.inputLatencyNs / 1e6, 0, 'f', 2)
+                       .arg(s.maxInputLatencyNs / 1e6, 0, 'f', 2)
+                       .arg(s.inputLatencies)
+                       .arg(m_format.durationForBytes(targetBytes) / 1000);
+    }
+    m_ui->telemetryLabel->setToolTip(toolTip);
+}
 
-// Обработчик нажатия клавиш
-void MainWindow::keyPressEvent(QKeyEvent *event)
+// Сохранение журнала показателей в CSV
+void MainWindow::dumpTelemetry()
 {
-    QString note;
+    const QString fileName = QFileDialog::getSaveFileName(this,
+                                                          "Save Audio Performance Log",
+                                                          "minisynth-telemetry.csv",
+                                                          "CSV files (*.csv)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+#if !defined(Q_OS_WASM)
+        QMessageBox::warning(this, "Save Failed", file.errorString());
+#endif
+        return;
+    }
+    QTextStream stream(&file);
+    stream << AudioTelemetry::csvHeader() << '\n';
+    const QVector<AudioTelemetry::Snapshot> &log = m_telemetryLog;
+    for (const AudioTelemetry::Snapshot &s : log) {
+        stream << AudioTelemetry::csvRow(s) << '\n';
+    }
+}
 
-    // Определяем, какая клавиша нажата
-    switch (event->key()) {
+#if !defined(Q_OS_WASM)
+// Запуск и остановка записи исполнения
+void MainWindow::recordToggled(bool checked)
+{
+    QString error;
+    if (!checked) {
+        const quint64 dropped = m_recorder.droppedBlocks();
+        if (!m_recorder.stopRecording(&error)) {
+            QMessageBox::warning(this, "Recording Failed", error);
+        } else if (dropped > 0) {
+            QMessageBox::warning(this,
+                                 "Recording Incomplete",
+                                 QString("%1 audio blocks were dropped because the disk could not "
+                                         "keep up.")
+                                     .arg(dropped));
+        }
+        return;
+    }
+    QString filters = "WAV files (*.wav)";
+    if (AudioRecorder::isFlacSupported()) {
+        filters += ";;FLAC files (*.flac)";
+    }
+    const QString fileName = QFileDialog::getSaveFileName(this,
+                                                          "Record Performance",
+                                                          "minisynth-recording.wav",
+                                                          filters);
+    if (fileName.isEmpty()
+        || !m_recorder.startRecording(fileName,
+                                      m_format,
+                                      AudioRecorder::containerForFile(fileName),
+                                      &error)) {
+        if (!fileName.isEmpty()) {
+            QMessageBox::warning(this, "Recording Failed", error);
+        }
+        const QSignalBlocker blocker(m_ui->recordButton);
+        m_ui->recordButton->setChecked(false);
+    }
+}
+#else
+void MainWindow::recordToggled(bool checked)
+{
+    Q_UNUSED(checked);
+}
+#endif
+
+// Потеря звука: строка показателей выделяется, подробности - в подсказке
+void MainWindow::xrunDetected(qint64 framesLost, qint64 timestampNs)
+{
+    Q_UNUSED(framesLost);
+    m_lastXrunNs = timestampNs;
+    m_ui->telemetryLabel->setStyleSheet("color: #c00000");
+}
+
+void MainWindow::stallChanged(bool stalled, qint64 timestampNs)
+{
+    Q_UNUSED(timestampNs);
+    if (stalled) {
+        m_ui->telemetryLabel->setStyleSheet("color: #c00000");
+        m_ui->telemetryLabel->setText("Audio output stalled: the device is not taking data");
+    }
+}
+
+// Полутон от C текущей октавы по подписи кнопки (C .. C'), -1 если подпись не нота
+int MainWindow::semitoneForName(const QString &name)
+{
+    static const char *const names[] = {"C", "C#", "D", "D#", "E", "F", "F#",
+                                        "G", "G#", "A", "A#", "B", "C'"};
+    for (int i = 0; i < int(sizeof(names) / sizeof(names[0])); ++i) {
+        if (name == names[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Номер ноты MIDI для полутона октавы клавиатуры (октава 3 начинается с C3 = 48),
+// -1 вне диапазона 0..127
+int MainWindow::noteNumber(int semitone)
+{
+    const int note = 12 * (KeyboardOctave + 1) + semitone;
+    return (semitone < 0 || note < 0 || note > 127) ? -1 : note;
+}
+
+// Полутон, соответствующий клавише компьютерной клавиатуры (-1, если нет)
+int MainWindow::semitoneForKey(int key)
+{
+    switch (key) {
     case Qt::Key_Q:
-        note = "C";
-        break;
+        return 0;
     case Qt::Key_W:
-        note = "D";
-        break;
+        return 2;
     case Qt::Key_E:
-        note = "E";
-        break;
+        return 4;
     case Qt::Key_R:
-        note = "F";
-        break;
+        return 5;
     case Qt::Key_T:
-        note = "G";
-        break;
+        return 7;
     case Qt::Key_Y:
-        note = "A";
-        break;
+        return 9;
     case Qt::Key_U:
-        note = "B";
-        break;
+        return 11;
     case Qt::Key_I:
-        note = "C'";
-        break;
+        return 12;
     case Qt::Key_2:
-        note = "C#";
-        break;
+        return 1;
     case Qt::Key_3:
-        note = "D#";
-        break;
+        return 3;
     case Qt::Key_5:
-        note = "F#";
-        break;
+        return 6;
     case Qt::Key_6:
-        note = "G#";
-        break;
+        return 8;
     case Qt::Key_7:
-        note = "A#";
-        break;
+        return 10;
     default:
+        return -1;
+    }
+}
+
+// Обработчик нажатия клавиш
+void MainWindow::keyPressEvent(QKeyEvent *event)
+{
+    const qint64 timeNs = ToneSynthesizer::monotonicNs(); // Время нажатия для метки события
+    // Определяем, какая клавиша нажата
+    const int semitone = semitoneForKey(event->key());
+    if (semitone < 0) {
         QMainWindow::keyPressEvent(event);
         return;
     }
-    // Если нажата клавиша, соответствующая ноте, отправляем сигнал
-    if(!note.isEmpty())
-    {
-        m_synth->noteOn(note); // Включаем ноту в синтезаторе
+    // Автоповтор удерживаемой клавиши не перезапускает атаку
+    if (!event->isAutoRepeat()) {
+        m_keyboard->press(noteNumber(semitone), timeNs);
     }
 }
 
 // Обработчик отпускания клавиш
 void MainWindow::keyReleaseEvent(QKeyEvent *event)
 {
-    // Определяем, какая клавиша отпущена (для всех клавиш, которые могут включать ноты)
-    switch (event->key()) {
-    case Qt::Key_Q:
-    case Qt::Key_W:
-    case Qt::Key_E:
-    case Qt::Key_R:
-    case Qt::Key_T:
-    case Qt::Key_Y:
-    case Qt::Key_U:
-    case Qt::Key_I:
-    case Qt::Key_2:
-    case Qt::Key_3:
-    case Qt::Key_5:
-    case Qt::Key_6:
-    case Qt::Key_7:
-        m_synth->noteOff(); // Отпускаем ноту при отпускании клавиши
-    default:
+    // Определяем, какая клавиша отпущена
+    const int semitone = semitoneForKey(event->key());
+    if (semitone < 0) {
         // Если отпущена другая клавиша, вызываем обработчик по умолчанию
         QMainWindow::keyReleaseEvent(event);
         return;
     }
+    // При автоповторе между повторами приходят отпускания, клавиша же нажата
+    if (!event->isAutoRepeat()) {
+        m_keyboard->release(noteNumber(semitone), ToneSynthesizer::monotonicNs()); // Только нота этой клавиши
+    }
 }
 
+void MainWindow::changeEvent(QEvent *event)
+{
+    if (m_keyboard && event->type() == QEvent::ActivationChange && !isActiveWindow()) {
+        m_keyboard->releaseAll(ToneSynthesizer::monotonicNs());
+    }
+    QMainWindow::changeEvent(event);
+}
@@ -3,6 +3,7 @@
 
 #include <QByteArray> // Для работы с байтовыми массивами
 #include <QComboBox> // Выпадающий список
+#include <QElapsedTimer> // Отсчет времени для журнала показателей
 #include <QIODevice> // Базовый класс для устройств ввода/вывода
 #include <QLabel>  // Текстовая метка
 #include <QMainWindow> // Главное окно приложения
@@ -13,16 +14,28 @@
 #include <QSlider> // Ползунок
 #include <QString> // Строка
 #include <QTimer> // Таймер
+#include <QVector> // Журнал показателей
 #include <QtMath> // Математические функции
 
 #include <QAudioFormat>
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+#include <QAudioDeviceInfo>
 #include <QAudioOutput>
 #else
+#include <QAudioDevice>
 #include <QAudioSink>
 #endif
 
+#include "keyboardinput.h" // Ноты клавиатуры и кнопок
+#include "latencycontroller.h" // Подбор задержки вывода
+#include "midiinput.h" // Вход MIDI
+#include "patch.h" // Набор патчей
+#if !defined(Q_OS_WASM)
+#include "recorder.h" // Запись исполнения
+#include "renderthread.h" // Поток генерации звука
+#endif
 #include "tonesynth.h" // Заголовочный файл синтезатора
+#include "watchdog.h" // Наблюдение за выводом
 
 QT_BEGIN_NAMESPACE // Открываем пространство имен Qt
 namespace Ui {
@@ -39,42 +52,78 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
-signals:
-    void underrunDetected(); // Сигнал о нехватке данных в аудио-буфере
-    void stallDetected(); // Сигнал о "зависании" аудиовывода
+    bool playMidiFile(const QString &fileName);
+    // Программы набора добавляются в список форм волны
+    bool loadPatches(const QString &fileName);
 
 private:
     void initializeWindow();
     void initializeAudio();
+    void stopAudio();
+    void initializeMidi();
+    void applyBufferTime();
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    static QAudioFormat chooseFormat(const QAudioDeviceInfo &deviceInfo);
+#else
+    static QAudioFormat chooseFormat(const QAudioDevice &deviceInfo);
+#endif
+    static QString formatDescription(const QAudioFormat &format);
+    static int semitoneForName(const QString &name);
+    static int semitoneForKey(int key);
+    static int noteNumber(int semitone);
 
 private slots:
     void deviceChanged(int index);
     void volumeChanged(int value);
     void bufferChanged(int value);
+    void adaptiveChanged(bool enabled);
     void octaveChanged(int value);
-#if !defined(Q_OS_WASM)
-    // Слоты для вывода сообщений об ошибках (только для не-WebAssembly платформ)
-    void underrunMessage();
-    void stallMessage();
-#endif
+    void glideChanged(int value);
+    void keyboardModeChanged(int index);
+    void waveformChanged(int index);
+    void updateTelemetry();
+    void dumpTelemetry();
+    void recordToggled(bool checked);
+    // Потери звука отмечаются в строке показателей, игра не прерывается
+    void xrunDetected(qint64 framesLost, qint64 timestampNs);
+    void stallChanged(bool stalled, qint64 timestampNs);
      // Переопределенные методы обработки событий клавиатуры
     void keyPressEvent(QKeyEvent *event) override;
     void keyReleaseEvent(QKeyEvent *event) override;
+    // Окно потеряло фокус: отпускание клавиш до него не дойдет
+    void changeEvent(QEvent *event) override;
 
 private:
+    // Октава кнопок и клавиатуры. Выбор октавы транспонирует синтезатор,
+    // а номера нот не меняются: отпускание всегда выключает нажатую ноту
+    static const int KeyboardOctave = 3;
+
     Ui::MainWindow *m_ui;
     QAudioFormat m_format;
     int m_bufferTime;
     bool m_running;
+    qint64 m_deviceBufferBytes; // Фактический размер буфера устройства
+    LatencyController m_latency; // Адаптивная задержка
+#if !defined(Q_OS_WASM)
+    AudioRecorder m_recorder; // Запись исполнения (удаляется после синтезатора)
+#endif
+    QScopedPointer<PatchBank> m_patches; // Программы и банк (удаляются после синтезатора)
     QScopedPointer<ToneSynthesizer> m_synth; // Умный указатель на объект синтезатора тона
+    QScopedPointer<KeyboardInput> m_keyboard; // Нажатые ноты (удаляются до синтезатора)
+    QScopedPointer<MidiInput> m_midiInput; // Поток входа MIDI (удаляется до синтезатора)
+#if !defined(Q_OS_WASM)
+    QScopedPointer<RenderThread> m_renderThread; // Поток генерации (удаляется до синтезатора)
+#endif
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     QScopedPointer<QAudioOutput> m_audioOutput;
 #else
     QScopedPointer<QAudioSink> m_audioOutput;
 #endif
-#if !defined(Q_OS_WASM)
-    QTimer m_stallDetector; // Таймер для определения "зависания" аудио(не для WebAssembly)
-#endif
+    AudioWatchdog m_watchdog; // Потери и остановки вывода по часам устройства
+    qint64 m_lastXrunNs; // Время последней потери (0 - не было)
+    QTimer m_telemetryTimer; // Таймер обновления показателей
+    QElapsedTimer m_telemetryClock; // Время от запуска для журнала
+    QVector<AudioTelemetry::Snapshot> m_telemetryLog; // Журнал показателей для CSV
 };
 
 #endif // MAINWINDOW_H
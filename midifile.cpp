@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <QFile>
+#include "midifile.h"
+
+// Перевод сообщения канала в событие синтезатора
+bool MidiMessage::toSynthEvent(SynthEvent *event) const
+{
+    event->frame = 0;
+    event->note = data1 & 0x7f;
+    switch (status & 0xf0) {
+    case 0x90:
+        if (data2 != 0) {
+            event->type = SynthEvent::Type::noteOn;
+            event->value = (data2 & 0x7f) / 127.0f;
+            return true;
+        }
+        // Нажатие с нулевой громкостью - отпускание
+        Q_FALLTHROUGH();
+    case 0x80:
+        event->type = SynthEvent::Type::noteOff;
+        event->value = 0.0f;
+        return true;
+    case 0xb0:
+        event->type = SynthEvent::Type::controlChange;
+        event->value = (data2 & 0x7f) / 127.0f;
+        return true;
+    case 0xc0:
+        event->type = SynthEvent::Type::program;
+        event->value = 0.0f;
+        return true;
+    case 0xe0: {
+        // 14-битное значение, 8192 - без изгиба
+        const int bend = (((data2 & 0x7f) << 7) | (data1 & 0x7f)) - 8192;
+        event->type = SynthEvent::Type::pitchBend;
+        event->note = 0;
+        event->value = qMax(-1.0f, bend / 8191.0f);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+namespace {
+
+// Сообщение дорожки с позицией в тиках. Смена темпа хранится вместе с сообщениями,
+// чтобы время считалось за один проход по сведенному списку
+struct TrackEvent
+{
+    quint64 tick;
+    int order; // Порядок в файле для устойчивой сортировки
+    bool tempo;
+    quint32 tempoUs; // Длительность четверти в микросекундах
+    MidiMessage message;
+};
+
+// Чтение чисел из блока файла с проверкой границ
+class Reader
+{
+public:
+    Reader(const uchar *data, qint64 size)
+        : m_pos(data)
+        , m_end(data + size)
+        , m_ok(true)
+    {}
+
+    bool ok() const { return m_ok; }
+    bool atEnd() const { return m_pos >= m_end; }
+    const uchar *pos() const { return m_pos; }
+
+    quint8 byte()
+    {
+        if (m_pos >= m_end) {
+            m_ok = false;
+            return 0;
+        }
+        return *m_pos++;
+    }
+
+    // Целое без знака в порядке big-endian
+    quint32 bigEndian(int bytes)
+    {
+        quint32 value = 0;
+        for (int i = 0; i < bytes; ++i) {
+            value = (value << 8) | byte();
+        }
+        return value;
+    }
+
+    // Число переменной длины (до 4 байт по 7 бит)
+    quint32 varLen()
+    {
+        quint32 value = 0;
+        for (int i = 0; i < 4; ++i) {
+            const quint8 b = byte();
+            value = (value << 7) | (b & 0x7f);
+            if (!(b & 0x80)) {
+                return value;
+            }
+        }
+        m_ok = false;
+        return value;
+    }
+
+    // Вложенный блок длиной bytes (обрезается по концу данных)
+    Reader block(qint64 bytes)
+    {
+        const qint64 size = qMin<qint64>(bytes, m_end - m_pos);
+        Reader result(m_pos, size);
+        m_pos += size;
+        return result;
+    }
+
+    void skip(qint64 bytes)
+    {
+        if (bytes > m_end - m_pos) {
+            m_ok = false;
+            m_pos = m_end;
+            return;
+        }
+        m_pos += bytes;
+    }
+
+private:
+    const uchar *m_pos;
+    const uchar *m_end;
+    bool m_ok;
+};
+
+} // namespace
+
+MidiFile::MidiFile()
+    : m_duration(0.0)
+{}
+
+bool MidiFile::load(const QString &fileName, QString *error)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = QString("cannot open %1: %2").arg(fileName, file.errorString());
+        }
+        return false;
+    }
+    return parse(file.readAll(), error);
+}
+
+bool MidiFile::parse(const QByteArray &data, QString *error)
+{
+    m_messages.clear();
+    m_duration = 0.0;
+    auto fail = [&](const QString &message) {
+        if (error) {
+            *error = message;
+        }
+        return false;
+    };
+
+    Reader file(reinterpret_cast<const uchar *>(data.constData()), data.size());
+    const quint32 magic = file.bigEndian(4);
+    const quint32 headerLength = file.bigEndian(4);
+    if (magic != 0x4d546864 /* MThd */ || headerLength < 6) {
+        return fail("not a standard MIDI file");
+    }
+    const quint32 format = file.bigEndian(2);
+    const quint32 tracks = file.bigEndian(2);
+    const quint32 division = file.bigEndian(2);
+    if (!file.ok() || format > 1 || division == 0) {
+        return fail("unsupported MIDI file format");
+    }
+    file.skip(headerLength - 6); // Заголовок может быть длиннее 6 байт
+
+    QVector<TrackEvent> events;
+    int order = 0;
+    quint64 lastTick = 0;
+    for (quint32 track = 0; track < tracks && !file.atEnd(); ++track) {
+        const quint32 id = file.bigEndian(4);
+        const quint32 length = file.bigEndian(4);
+        if (!file.ok()) {
+            return fail(QString("track %1: truncated header").arg(track));
+        }
+        if (id != 0x4d54726b /* MTrk */) {
+            file.skip(length); // Неизвестные блоки пропускаются
+            --track;
+            continue;
+        }
+        Reader chunk = file.block(length);
+
+        quint64 tick = 0;
+        quint8 runningStatus = 0;
+        while (!chunk.atEnd()) {
+            tick += chunk.varLen();
+            quint8 status = chunk.byte();
+            if (status < 0x80) {
+                // Повтор предыдущего статуса: прочитанный байт - первый байт данных
+                if (runningStatus == 0) {
+                    return fail(QString("track %1: data byte without status").arg(track));
+                }
+                TrackEvent event{tick, order++, false, 0, {runningStatus, status, 0}};
+                const quint8 type = runningStatus & 0xf0;
+                if (type != 0xc0 && type != 0xd0) {
+                    event.message.data2 = chunk.byte();
+                }
+                events.append(event);
+            } else if (status < 0xf0) {
+                runningStatus = status;
+                TrackEvent event{tick, order++, false, 0, {status, chunk.byte(), 0}};
+                const quint8 type = status & 0xf0;
+                if (type != 0xc0 && type != 0xd0) {
+                    event.message.data2 = chunk.byte();
+                }
+                events.append(event);
+            } else if (status == 0xff) {
+                const quint8 type = chunk.byte();
+                const quint32 size = chunk.varLen();
+                if (type == 0x51 && size == 3) {
+                    // Темп
+                    events.append(TrackEvent{tick, order++, true, chunk.bigEndian(3), {0, 0, 0}});
+                } else {
+                    chunk.skip(size);
+                }
+                if (type == 0x2f) {
+                    break; // Конец дорожки
+                }
+            } else if (status == 0xf0 || status == 0xf7) {
+                chunk.skip(chunk.varLen()); // Системные сообщения не используются
+                runningStatus = 0;
+            } else {
+                return fail(QString("track %1: unexpected status 0x%2").arg(track).arg(int(status), 0, 16));
+            }
+            if (!chunk.ok()) {
+                return fail(QString("track %1: truncated event").arg(track));
+            }
+        }
+        lastTick = qMax(lastTick, tick);
+    }
+    if (!file.ok()) {
+        return fail("truncated file");
+    }
+
+    // Сведение дорожек и перевод тиков в секунды
+    std::stable_sort(events.begin(), events.end(), [](const TrackEvent &a, const TrackEvent &b) {
+        return a.tick < b.tick || (a.tick == b.tick && a.order < b.order);
+    });
+    qreal secondsPerTick;
+    const bool smpte = division & 0x8000;
+    if (smpte) {
+        // Кадры в секунду (отрицательное число) и тики на кадр
+        const int fps = -qint8(division >> 8);
+        secondsPerTick = 1.0 / (qMax(fps, 1) * qMax<int>(division & 0xff, 1));
+    } else {
+        secondsPerTick = 0.5 / division; // 120 ударов в минуту по умолчанию
+    }
+    qreal time = 0.0;
+    quint64 tick = 0;
+    for (const TrackEvent &event : events) {
+        time += (event.tick - tick) * secondsPerTick;
+        tick = event.tick;
+        if (event.tempo) {
+            if (!smpte && event.tempoUs > 0) {
+                secondsPerTick = event.tempoUs / 1e6 / division;
+            }
+        } else {
+            m_messages.append(Message{time, event.message});
+        }
+    }
+    m_duration = time + (lastTick - tick) * secondsPerTick;
+    return true;
+}
+
+const QVector<MidiFile::Message> &MidiFile::messages() const
+{
+    return m_messages;
+}
+
+QVector<SynthEvent> MidiFile::events(int sampleRate) const
+{
+    QVector<SynthEvent> result;
+    result.reserve(m_messages.size());
+    for (const Message &message : m_messages) {
+        SynthEvent event;
+        if (message.message.toSynthEvent(&event)) {
+            event.frame = quint64(qRound64(message.time * sampleRate));
+            result.append(event);
+        }
+    }
+    return result;
+}
+
+qreal MidiFile::duration() const
+{
+    return m_duration;
+}
@@ -0,0 +1,48 @@
+#ifndef MIDIFILE_H
+#define MIDIFILE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "eventqueue.h" // SynthEvent
+
+// Сообщение канала MIDI (без системных сообщений)
+struct MidiMessage
+{
+    quint8 status; // Тип сообщения и номер канала
+    quint8 data1;
+    quint8 data2;
+
+    // Перевод в событие синтезатора (метка не заполняется). false - сообщение
+    // синтезатором не используется. Каналы не различаются
+    bool toSynthEvent(SynthEvent *event) const;
+};
+
+// Стандартный MIDI-файл (форматы 0 и 1). Сообщения всех дорожек сводятся
+// в один список с временем в секундах по карте темпа
+class MidiFile
+{
+public:
+    struct Message
+    {
+        qreal time;
+        MidiMessage message;
+    };
+
+    MidiFile();
+
+    bool load(const QString &fileName, QString *error);
+    bool parse(const QByteArray &data, QString *error);
+
+    const QVector<Message> &messages() const;
+    // События с метками в сэмплах для заданной частоты дискретизации
+    QVector<SynthEvent> events(int sampleRate) const;
+    // Время последнего сообщения или конца дорожки в секундах
+    qreal duration() const;
+
+private:
+    QVector<Message> m_messages;
+    qreal m_duration;
+};
+
+#endif // MIDIFILE_H
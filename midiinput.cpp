@@ -0,0 +1,201 @@
+#include <QVarLengthArray>
+#if defined(MINISYNTH_HAVE_ALSA)
+#include <alsa/asoundlib.h>
+#include <poll.h>
+#endif
+#include "midiinput.h"
+
+MidiInput::MidiInput(ToneSynthesizer *synth, QObject *parent)
+    : QThread(parent)
+    , m_synth(synth)
+    , m_stopRequested(false)
+    , m_dropped(0)
+{}
+
+void MidiInput::startInput()
+{
+    m_stopRequested.store(false, std::memory_order_relaxed);
+    start(QThread::TimeCriticalPriority);
+}
+
+void MidiInput::stopInput()
+{
+    m_stopRequested.store(true, std::memory_order_relaxed);
+    wait();
+}
+
+quint64 MidiInput::droppedMessages() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+bool MidiInput::stopRequested() const
+{
+    return m_stopRequested.load(std::memory_order_relaxed);
+}
+
+// Передача сообщения синтезатору: время приема переводится в номер сэмпла
+void MidiInput::deliver(const MidiMessage &message, qint64 timeNs)
+{
+    SynthEvent event;
+    if (message.toSynthEvent(&event)) {
+        deliver(event, timeNs);
+    }
+}
+
+void MidiInput::deliver(SynthEvent event, qint64 timeNs)
+{
+    event.frame = m_synth->frameAtTime(timeNs);
+    if (!m_synth->postEvent(event, ToneSynthesizer::EventPort::midi)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+MidiFilePlayer::MidiFilePlayer(const MidiFile &file, ToneSynthesizer *synth, QObject *parent)
+    : MidiInput(synth, parent)
+    , m_file(file)
+{}
+
+MidiFilePlayer::~MidiFilePlayer()
+{
+    stopInput();
+}
+
+void MidiFilePlayer::run()
+{
+    const qint64 startNs = ToneSynthesizer::monotonicNs();
+    for (const MidiFile::Message &message : m_file.messages()) {
+        const qint64 timeNs = startNs + qint64(message.time * 1e9);
+        // Короткие интервалы сна, чтобы остановка не ждала следующей ноты
+        qint64 remainingNs;
+        while (!stopRequested() && (remainingNs = timeNs - ToneSynthesizer::monotonicNs()) > 0) {
+            QThread::usleep((unsigned long) qMin<qint64>(remainingNs / 1000 + 1, 10000));
+        }
+        if (stopRequested()) {
+            break;
+        }
+        deliver(message.message, timeNs);
+    }
+    // Ноты, не выключенные файлом или прерванные остановкой
+    deliver(MidiMessage{0xb0, 123, 0}, ToneSynthesizer::monotonicNs());
+}
+
+#if defined(MINISYNTH_HAVE_ALSA)
+namespace {
+
+// Перевод события секвенсора в сообщение канала
+bool toMidiMessage(const snd_seq_event_t *event, MidiMessage *message)
+{
+    switch (event->type) {
+    case SND_SEQ_EVENT_NOTEON:
+    case SND_SEQ_EVENT_NOTEOFF:
+        message->status = quint8((event->type == SND_SEQ_EVENT_NOTEON ? 0x90 : 0x80)
+                                 | (event->data.note.channel & 0x0f));
+        message->data1 = event->data.note.note & 0x7f;
+        message->data2 = event->data.note.velocity & 0x7f;
+        return true;
+    case SND_SEQ_EVENT_CONTROLLER:
+        message->status = quint8(0xb0 | (event->data.control.channel & 0x0f));
+        message->data1 = quint8(event->data.control.param & 0x7f);
+        message->data2 = quint8(event->data.control.value & 0x7f);
+        return true;
+    case SND_SEQ_EVENT_PGMCHANGE:
+        message->status = quint8(0xc0 | (event->data.control.channel & 0x0f));
+        message->data1 = quint8(event->data.control.value & 0x7f);
+        message->data2 = 0;
+        return true;
+    case SND_SEQ_EVENT_PITCHBEND: {
+        const int value = qBound(0, event->data.control.value + 8192, 16383);
+        message->status = quint8(0xe0 | (event->data.control.channel & 0x0f));
+        message->data1 = quint8(value & 0x7f);
+        message->data2 = quint8(value >> 7);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+AlsaMidiInput::AlsaMidiInput(ToneSynthesizer *synth, QObject *parent)
+    : MidiInput(synth, parent)
+    , m_seq(nullptr)
+    , m_port(-1)
+{}
+
+AlsaMidiInput::~AlsaMidiInput()
+{
+    stopInput();
+    if (m_seq) {
+        snd_seq_close(m_seq);
+    }
+}
+
+bool AlsaMidiInput::open(const QString &clientName, const QString &source, QString *error)
+{
+    auto fail = [&](const QString &message, int code) {
+        if (error) {
+            *error = QString("%1: %2").arg(message, QString::fromLocal8Bit(snd_strerror(code)));
+        }
+        return false;
+    };
+    int result = snd_seq_open(&m_seq, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK);
+    if (result < 0) {
+        m_seq = nullptr;
+        return fail("cannot open ALSA sequencer", result);
+    }
+    snd_seq_set_client_name(m_seq, clientName.toLocal8Bit().constData());
+    m_port = snd_seq_create_simple_port(m_seq,
+                                        "input",
+                                        SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+                                        SND_SEQ_PORT_TYPE_MIDI_GENERIC
+                                            | SND_SEQ_PORT_TYPE_APPLICATION);
+    if (m_port < 0) {
+        return fail("cannot create sequencer port", m_port);
+    }
+    if (!source.isEmpty()) {
+        snd_seq_addr_t address;
+        result = snd_seq_parse_address(m_seq, &address, source.toLocal8Bit().constData());
+        if (result >= 0) {
+            result = snd_seq_connect_from(m_seq, m_port, address.client, address.port);
+        }
+        if (result < 0) {
+            return fail("cannot connect to " + source, result);
+        }
+    }
+    return true;
+}
+
+// Ожидание событий с коротким тайм-аутом: метка ставится сразу после пробуждения,
+// все события одной пачки пришли одновременно
+void AlsaMidiInput::run()
+{
+    if (!m_seq) {
+        return;
+    }
+    const int count = snd_seq_poll_descriptors_count(m_seq, POLLIN);
+    QVarLengthArray<pollfd, 4> fds(count);
+    snd_seq_poll_descriptors(m_seq, fds.data(), unsigned(count), POLLIN);
+    while (!stopRequested()) {
+        if (poll(fds.data(), nfds_t(count), 20) <= 0) {
+            continue;
+        }
+        const qint64 timeNs = ToneSynthesizer::monotonicNs();
+        for (;;) {
+            snd_seq_event_t *event = nullptr;
+            const int result = snd_seq_event_input(m_seq, &event);
+            if (result == -ENOSPC) {
+                continue; // Переполнение входного буфера: часть событий потеряна
+            }
+            if (result < 0 || !event) {
+                break;
+            }
+            MidiMessage message;
+            if (toMidiMessage(event, &message)) {
+                deliver(message, timeNs);
+            }
+        }
+    }
+}
+#endif
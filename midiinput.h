@@ -0,0 +1,82 @@
+#ifndef MIDIINPUT_H
+#define MIDIINPUT_H
+
+#include <atomic>
+#include <QString>
+#include <QThread>
+#include "midifile.h" // Сообщения и MIDI-файлы
+#include "tonesynth.h" // Синтезатор
+
+// Источник MIDI в отдельном потоке. Сообщения получают метку монотонного времени
+// в момент приема и попадают в очередь MIDI синтезатора с номером сэмпла, поэтому
+// нота начинается с нужного смещения внутри следующего блока независимо
+// от загрузки потока GUI
+class MidiInput : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit MidiInput(ToneSynthesizer *synth, QObject *parent = nullptr);
+
+    // Запуск потока с повышенным приоритетом и его остановка
+    void startInput();
+    void stopInput();
+    // Сообщения, не поместившиеся в очередь синтезатора
+    quint64 droppedMessages() const;
+
+protected:
+    void deliver(const MidiMessage &message, qint64 timeNs);
+    // Событие синтезатора (метка frame заменяется сэмплом момента timeNs)
+    void deliver(SynthEvent event, qint64 timeNs);
+    bool stopRequested() const;
+
+private:
+    ToneSynthesizer *m_synth;
+    std::atomic<bool> m_stopRequested;
+    std::atomic<quint64> m_dropped;
+};
+
+// Воспроизведение MIDI-файла в реальном времени (замена внешнего устройства
+// для проверок). Метка сообщения - его время по файлу, а не момент пробуждения
+// потока, поэтому неточность таймера ОС не влияет на ритм
+class MidiFilePlayer : public MidiInput
+{
+    Q_OBJECT
+
+public:
+    MidiFilePlayer(const MidiFile &file, ToneSynthesizer *synth, QObject *parent = nullptr);
+    ~MidiFilePlayer() override;
+
+protected:
+    void run() override;
+
+private:
+    MidiFile m_file;
+};
+
+#if defined(MINISYNTH_HAVE_ALSA)
+typedef struct _snd_seq snd_seq_t;
+
+// Вход секвенсора ALSA: виртуальный порт, к которому можно подключить
+// клавиатуру или программу (aconnect), и необязательное подключение к источнику
+class AlsaMidiInput : public MidiInput
+{
+    Q_OBJECT
+
+public:
+    explicit AlsaMidiInput(ToneSynthesizer *synth, QObject *parent = nullptr);
+    ~AlsaMidiInput() override;
+
+    // source - адрес источника вида "клиент:порт" или имя клиента, пустой - без подключения
+    bool open(const QString &clientName, const QString &source, QString *error);
+
+protected:
+    void run() override;
+
+private:
+    snd_seq_t *m_seq;
+    int m_port;
+};
+#endif
+
+#endif // MIDIINPUT_H
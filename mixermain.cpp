@@ -0,0 +1,135 @@
+#include <csignal>
+#include <memory>
+#include <vector>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QTimer>
+
+#include <QAudioFormat>
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+#include <QAudioDeviceInfo>
+#include <QAudioOutput>
+#else
+#include <QAudioDevice>
+#include <QAudioSink>
+#include <QMediaDevices>
+#endif
+
+#include "sharedaudio.h" // Разделяемые буферы экземпляров
+#include "tonesynth.h" // Формат вывода
+
+namespace {
+volatile std::sig_atomic_t stopSignal = 0;
+
+void requestStop(int)
+{
+    stopSignal = 1;
+}
+} // namespace
+
+// Вывод нескольких экземпляров minisynth-server через одно устройство:
+// их буферы в разделяемой памяти суммируются на месте в обратном вызове
+// устройства. Показатели - доля времени ЦП каждого экземпляра от длительности
+// звука, который он сгенерировал, и кадры тишины вместо его данных
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("minisynth-mixer");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Plays several headless synthesizer instances on one output device");
+    parser.addHelpOption();
+    parser.addPositionalArgument("names", "Shared memory names of the instances (minisynth-server --name).");
+    QCommandLineOption bufferOption("buffer", "Device buffer length.", "ms", "40");
+    QCommandLineOption statsOption("stats", "Print per-instance CPU use every N seconds (0 = never).", "seconds", "5");
+    parser.addOptions({bufferOption, statsOption});
+    parser.process(app);
+
+    QTextStream err(stderr);
+    const QStringList names = parser.positionalArguments();
+    const qreal bufferMs = parser.value(bufferOption).toDouble();
+    const qreal statsSeconds = parser.value(statsOption).toDouble();
+    if (names.isEmpty()) {
+        parser.showHelp(1);
+    }
+    if (bufferMs <= 0.0 || statsSeconds < 0.0) {
+        err << "invalid option" << Qt::endl;
+        return 1;
+    }
+
+    QString error;
+    std::vector<std::unique_ptr<SharedAudioRing>> rings;
+    SharedAudioMixer mixer;
+    for (const QString &name : names) {
+        rings.emplace_back(new SharedAudioRing);
+        if (!rings.back()->attach(name, &error) || !mixer.addRing(rings.back().get(), &error)) {
+            err << error << Qt::endl;
+            return 1;
+        }
+    }
+
+    const QAudioFormat format = ToneSynthesizer::makeFormat(mixer.sampleRate(),
+                                                            mixer.channels(),
+                                                            RenderKernels::SampleFormat::float32);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    const QAudioDeviceInfo device = QAudioDeviceInfo::defaultOutputDevice();
+#else
+    const QAudioDevice device = QMediaDevices::defaultAudioOutput();
+#endif
+    if (!device.isFormatSupported(format)) {
+        err << "the default device does not accept float " << mixer.sampleRate() << " Hz, " << mixer.channels()
+            << " ch" << Qt::endl;
+        return 1;
+    }
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    QAudioOutput output(device, format);
+#else
+    QAudioSink output(device, format);
+#endif
+    output.setBufferSize(format.bytesForDuration(qint64(bufferMs * 1000.0)));
+    mixer.open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    output.start(&mixer);
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    err << "mixing " << rings.size() << " instances: " << mixer.sampleRate() << " Hz, " << mixer.channels()
+        << " ch" << Qt::endl;
+
+    QTimer timer;
+    qint64 statsNs = ToneSynthesizer::monotonicNs();
+    std::vector<qint64> lastCpuNs(rings.size());
+    std::vector<quint64> lastFrames(rings.size());
+    for (size_t i = 0; i < rings.size(); ++i) {
+        lastCpuNs[i] = rings[i]->cpuTimeNs();
+        lastFrames[i] = rings[i]->writtenFrames();
+    }
+    QObject::connect(&timer, &QTimer::timeout, [&] {
+        if (stopSignal) {
+            app.quit();
+            return;
+        }
+        const qint64 nowNs = ToneSynthesizer::monotonicNs();
+        if (statsSeconds <= 0.0 || nowNs - statsNs < qint64(statsSeconds * 1e9)) {
+            return;
+        }
+        for (size_t i = 0; i < rings.size(); ++i) {
+            const SharedAudioRing &ring = *rings[i];
+            const qint64 cpuNs = ring.cpuTimeNs();
+            const quint64 frames = ring.writtenFrames();
+            const qreal audioNs = qreal(frames - lastFrames[i]) * 1e9 / ring.sampleRate();
+            err << ring.name() << " (pid " << ring.ownerPid() << "): cpu "
+                << (audioNs > 0.0 ? 100.0 * (cpuNs - lastCpuNs[i]) / audioNs : 0.0) << "% of real time, "
+                << ring.underrunFrames() << " underrun frames" << Qt::endl;
+            lastCpuNs[i] = cpuNs;
+            lastFrames[i] = frames;
+        }
+        statsNs = nowNs;
+    });
+    timer.start(50);
+    app.exec();
+
+    output.stop();
+    mixer.close();
+    return 0;
+}
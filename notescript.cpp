@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <QFile>
+#include <QRegularExpression>
+#include <QStringList>
+#include "notescript.h"
+#include "tonesynth.h" // Имена параметров и число программ
+
+NoteScript::NoteScript()
+    : m_duration(0.0)
+{}
+
+// Загрузка сценария из файла ("-" - стандартный ввод)
+bool NoteScript::load(const QString &fileName, QString *error)
+{
+    QFile file;
+    bool opened;
+    if (fileName == "-") {
+        opened = file.open(stdin, QIODevice::ReadOnly | QIODevice::Text);
+    } else {
+        file.setFileName(fileName);
+        opened = file.open(QIODevice::ReadOnly | QIODevice::Text);
+    }
+    if (!opened) {
+        if (error) {
+            *error = QString("cannot open %1: %2").arg(fileName, file.errorString());
+        }
+        return false;
+    }
+    return parse(QString::fromUtf8(file.readAll()), error);
+}
+
+bool NoteScript::parse(const QString &text, QString *error)
+{
+    m_entries.clear();
+    m_duration = 0.0;
+    const QStringList lines = text.split('\n');
+    for (int i = 0; i < lines.size(); ++i) {
+        QString line = lines.at(i);
+        const int comment = line.indexOf('#');
+        if (comment >= 0) {
+            line.truncate(comment);
+        }
+        const QStringList fields = line.simplified().split(' ', Qt::SkipEmptyParts);
+        if (fields.isEmpty()) {
+            continue;
+        }
+        auto fail = [&](const QString &message) {
+            if (error) {
+                *error = QString("line %1: %2").arg(i + 1).arg(message);
+            }
+            return false;
+        };
+
+        bool ok = false;
+        Entry entry;
+        entry.time = fields.at(0).toDouble(&ok);
+        if (!ok || entry.time < 0.0) {
+            return fail("bad time '" + fields.at(0) + "'");
+        }
+        if (fields.size() < 2) {
+            return fail("missing command");
+        }
+        if (fields.at(1).toLower() == "end") {
+            m_duration = qMax(m_duration, entry.time);
+            continue;
+        }
+        QString message;
+        if (!parseCommand(fields.mid(1), &entry.event, &message)) {
+            return fail(message);
+        }
+        m_duration = qMax(m_duration, entry.time);
+        m_entries.append(entry);
+    }
+    // Сортировка с сохранением порядка строк для одинаковых времен
+    std::stable_sort(m_entries.begin(), m_entries.end(), [](const Entry &a, const Entry &b) {
+        return a.time < b.time;
+    });
+    return true;
+}
+
+// Команда сценария без времени (поля строки после него)
+bool NoteScript::parseCommand(const QStringList &fields, SynthEvent *event, QString *error)
+{
+    auto fail = [&](const QString &message) {
+        if (error) {
+            *error = message;
+        }
+        return false;
+    };
+    if (fields.isEmpty()) {
+        return fail("missing command");
+    }
+    bool ok = false;
+    event->frame = 0;
+    event->note = 0;
+    event->value = 0.0f;
+
+    const QString command = fields.at(0).toLower();
+    if (command == "on" || command == "off") {
+        const int note = (fields.size() > 1) ? parseNote(fields.at(1)) : -1;
+        if (note < 0) {
+            return fail("bad note");
+        }
+        event->type = (command == "on") ? SynthEvent::Type::noteOn : SynthEvent::Type::noteOff;
+        event->note = quint8(note);
+        event->value = 1.0f;
+        if (command == "on" && fields.size() > 2) {
+            event->value = fields.at(2).toFloat(&ok);
+            if (!ok) {
+                return fail("bad velocity '" + fields.at(2) + "'");
+            }
+        }
+    } else if (command == "alloff") {
+        event->type = SynthEvent::Type::allNotesOff;
+    } else if (command == "wave") {
+        static const QStringList names{"sine", "saw", "square", "triangle"};
+        const int index = (fields.size() > 1) ? names.indexOf(fields.at(1).toLower()) : -1;
+        if (index < 0) {
+            return fail("bad waveform");
+        }
+        event->type = SynthEvent::Type::waveform;
+        event->note = quint8(index);
+    } else if (command == "set") {
+        ToneSynthesizer::Parameter parameter;
+        if (fields.size() < 3 || !ToneSynthesizer::parseParameter(fields.at(1).toLower(), &parameter)) {
+            return fail("bad parameter");
+        }
+        event->type = SynthEvent::Type::parameter;
+        event->note = quint8(parameter);
+        event->value = fields.at(2).toFloat(&ok);
+        if (!ok) {
+            return fail("bad parameter value '" + fields.at(2) + "'");
+        }
+    } else if (command == "program") {
+        const QString program = fields.value(1).toLower();
+        int number = SynthEvent::NoProgram;
+        if (program != "init") {
+            number = program.toInt(&ok);
+            if (!ok || number < 0 || number >= PatchBank::MaxPrograms) {
+                return fail("bad program '" + program + "'");
+            }
+        }
+        event->type = SynthEvent::Type::program;
+        event->note = quint8(number);
+    } else {
+        return fail("unknown command '" + command + "'");
+    }
+    return true;
+}
+
+QVector<SynthEvent> NoteScript::events(int sampleRate) const
+{
+    QVector<SynthEvent> result;
+    result.reserve(m_entries.size());
+    for (const Entry &entry : m_entries) {
+        SynthEvent event = entry.event;
+        event.frame = quint64(qRound64(entry.time * sampleRate));
+        result.append(event);
+    }
+    return result;
+}
+
+qreal NoteScript::duration() const
+{
+    return m_duration;
+}
+
+// Номер MIDI: число 0..127 или имя ноты с октавой (C4 = 60, A4 = 69)
+int NoteScript::parseNote(const QString &text)
+{
+    bool ok = false;
+    const int number = text.toInt(&ok);
+    if (ok) {
+        return (number >= 0 && number <= 127) ? number : -1;
+    }
+    static const QRegularExpression pattern("^([A-Ga-g])([#b]?)(-?\\d+)$");
+    const QRegularExpressionMatch match = pattern.match(text);
+    if (!match.hasMatch()) {
+        return -1;
+    }
+    static const int semitones[] = {9, 11, 0, 2, 4, 5, 7}; // A B C D E F G
+    int note = semitones[match.captured(1).toUpper().at(0).unicode() - 'A'];
+    if (match.captured(2) == "#") {
+        note++;
+    } else if (match.captured(2) == "b") {
+        note--;
+    }
+    note += (match.captured(3).toInt() + 1) * 12;
+    return (note >= 0 && note <= 127) ? note : -1;
+}
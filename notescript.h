@@ -0,0 +1,47 @@
+#ifndef NOTESCRIPT_H
+#define NOTESCRIPT_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "eventqueue.h" // SynthEvent
+
+// Текстовый сценарий нот для генерации без звуковой карты. Строка сценария:
+//     <время в секундах> <команда> [аргументы]
+// Команды: on <нота> [громкость 0..1], off <нота>, alloff,
+// wave <sine|saw|square|triangle>, set <volume|octave|glide> <значение>,
+// program <номер набора патчей|init>, end.
+// Нота - номер MIDI или имя вида C4, F#3, Bb2. Параметры меняются плавно,
+// как из GUI, но с точностью до сэмпла, поэтому результат воспроизводим.
+// Текст после '#' - комментарий
+class NoteScript
+{
+public:
+    NoteScript();
+
+    bool load(const QString &fileName, QString *error);
+    bool parse(const QString &text, QString *error);
+
+    // События с метками в сэмплах для заданной частоты дискретизации
+    QVector<SynthEvent> events(int sampleRate) const;
+    // Время последнего события (или команды end) в секундах
+    qreal duration() const;
+
+    // Команда без времени, разбитая на поля ("on C4 0.8"): событие с нулевой
+    // меткой. Так же принимаются команды сокета управления (ControlSocket)
+    static bool parseCommand(const QStringList &fields, SynthEvent *event, QString *error);
+    // Номер MIDI по имени ноты или числу, -1 при ошибке
+    static int parseNote(const QString &text);
+
+private:
+    struct Entry
+    {
+        qreal time;
+        SynthEvent event;
+    };
+
+    QVector<Entry> m_entries;
+    qreal m_duration;
+};
+
+#endif // NOTESCRIPT_H
@@ -0,0 +1,259 @@
+#include <cstring>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include "notescript.h" // Имена нот
+#include "patch.h"
+#include "wavetable.h"
+
+namespace {
+
+const char *const waveformNames[] = {"sine", "saw", "square", "triangle"};
+
+} // namespace
+
+SynthProgram::SynthProgram()
+    : tables(Wavetable::instance().tables(Wavetable::Waveform::sine))
+    , gain(1.0f)
+    , oversampling(1)
+{}
+
+PatchBank::PatchBank() {}
+
+PatchBank::~PatchBank()
+{
+    clear();
+}
+
+bool PatchBank::load(const QString &fileName, QString *error)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if (error) {
+            *error = QString("cannot open %1: %2").arg(fileName, file.errorString());
+        }
+        return false;
+    }
+    if (!parse(QString::fromUtf8(file.readAll()), QFileInfo(fileName).absolutePath(), error)) {
+        if (error) {
+            *error = QString("%1: %2").arg(fileName, *error);
+        }
+        return false;
+    }
+    return true;
+}
+
+bool PatchBank::parse(const QString &text, const QString &directory, QString *error)
+{
+    clear();
+    const QStringList lines = text.split('\n');
+    SynthProgram *program = nullptr;
+    bool stages = false; // Ступени огибающей заданы по одной
+    for (int i = 0; i < lines.size(); ++i) {
+        QString line = lines.at(i);
+        const int comment = line.indexOf('#');
+        if (comment >= 0) {
+            line.truncate(comment);
+        }
+        line = line.simplified();
+        const QStringList fields = line.split(' ', Qt::SkipEmptyParts);
+        if (fields.isEmpty()) {
+            continue;
+        }
+        auto fail = [&](const QString &message) {
+            if (error) {
+                *error = QString("line %1: %2").arg(i + 1).arg(message);
+            }
+            clear();
+            return false;
+        };
+        // Число из поля index, ok - успех
+        auto number = [&fields](int index, bool *ok) {
+            *ok = false;
+            return (index < fields.size()) ? fields.at(index).toDouble(ok) : 0.0;
+        };
+
+        const QString command = fields.at(0).toLower();
+        const QString argument = line.section(' ', 1); // Имена и пути могут содержать пробелы
+        bool ok = false;
+        if (command == "bank") {
+            // Программы хранят указатели в отображение, поэтому банк один на файл
+            if (m_bank.isOpen()) {
+                return fail("only one bank per patch file");
+            }
+            QString bankError;
+            if (!m_bank.open(QDir(directory).filePath(argument), &bankError)) {
+                return fail(bankError);
+            }
+            m_preloads.resize(m_bank.count());
+            continue;
+        }
+        if (command == "patch") {
+            if (argument.isEmpty()) {
+                return fail("missing patch name");
+            }
+            if (m_programs.size() == MaxPrograms) {
+                return fail(QString("too many patches (at most %1)").arg(MaxPrograms));
+            }
+            program = new SynthProgram;
+            program->name = argument;
+            m_programs.append(program);
+            stages = false;
+            continue;
+        }
+        if (!program) {
+            return fail("'" + command + "' before the first patch");
+        }
+
+        if (command == "osc") {
+            int waveform = -1;
+            for (int w = 0; w < Wavetable::WaveformCount; ++w) {
+                if (argument == waveformNames[w]) {
+                    waveform = w;
+                }
+            }
+            if (waveform >= 0) {
+                program->tables = Wavetable::instance().tables(Wavetable::Waveform(waveform));
+            } else {
+                const int entry = m_bank.find(argument, SoundBank::Kind::wavetable);
+                if (entry < 0) {
+                    return fail("unknown oscillator '" + argument + "'");
+                }
+                program->tables = m_bank.entry(entry).data;
+            }
+        } else if (command == "zone") {
+            SampleZone zone;
+            zone.lowNote = NoteScript::parseNote(fields.value(2));
+            zone.highNote = NoteScript::parseNote(fields.value(3));
+            zone.lowVelocity = 1;
+            zone.highVelocity = 127;
+            ok = (fields.size() == 4);
+            if (fields.size() == 6) {
+                zone.lowVelocity = fields.at(4).toInt(&ok);
+                zone.highVelocity = ok ? fields.at(5).toInt(&ok) : 0;
+            }
+            if (!ok || zone.lowNote < 0 || zone.highNote < zone.lowNote || zone.lowVelocity < 1
+                || zone.highVelocity < zone.lowVelocity || zone.highVelocity > 127) {
+                return fail("zone needs a sample, a note range and an optional velocity range 1..127");
+            }
+            const int entry = m_bank.find(fields.at(1), SoundBank::Kind::sample);
+            if (entry < 0) {
+                return fail("unknown sample '" + fields.at(1) + "'");
+            }
+            // Начало сэмпла копируется один раз на все зоны с этим сэмплом
+            const SoundBank::Entry &sample = m_bank.entry(entry);
+            QVector<float> &preload = m_preloads[entry];
+            if (preload.isEmpty()) {
+                preload = QVector<float>(int(qMin(sample.frames, quint32(SampleStreamer::PreloadFrames))));
+                std::memcpy(preload.data(), sample.data, size_t(preload.size()) * sizeof(float));
+            }
+            zone.preload = preload.constData();
+            zone.preloadFrames = quint32(preload.size());
+            zone.source = sample.data;
+            zone.frames = sample.frames;
+            zone.loopStart = sample.loopStart;
+            zone.loopEnd = sample.loopEnd;
+            zone.sampleRate = sample.sampleRate;
+            zone.rootNote = sample.rootNote;
+            program->zones.append(zone);
+        } else if (command == "adsr") {
+            EnvelopeShape::Curve curve = EnvelopeShape::Curve::exponential;
+            if (fields.size() < 5 || (fields.size() > 5 && !EnvelopeShape::parseCurve(fields.at(5), &curve))) {
+                return fail("adsr needs attack, decay, sustain, release and an optional curve");
+            }
+            qreal values[4];
+            for (int k = 0; k < 4; ++k) {
+                values[k] = number(k + 1, &ok);
+                if (!ok || values[k] < 0.0) {
+                    return fail("bad envelope value '" + fields.at(k + 1) + "'");
+                }
+            }
+            program->envelope = EnvelopeShape::adsr(values[0], values[1], values[2], values[3], curve);
+            stages = false;
+        } else if (command == "stage") {
+            EnvelopeShape::Curve curve = EnvelopeShape::Curve::exponential;
+            const qreal level = number(1, &ok);
+            const bool timeOk = ok;
+            const qreal timeMs = number(2, &ok);
+            if (!timeOk || !ok || timeMs < 0.0
+                || (fields.size() > 3 && !EnvelopeShape::parseCurve(fields.at(3), &curve))) {
+                return fail("stage needs a level, a time in ms and an optional curve");
+            }
+            if (!stages) {
+                program->envelope.clear();
+                stages = true;
+            }
+            if (!program->envelope.addStage(float(level), timeMs, curve)) {
+                return fail(QString("too many envelope stages (at most %1)").arg(EnvelopeShape::MaxStages));
+            }
+        } else if (command == "sustain") {
+            const int stage = fields.value(1).toInt(&ok);
+            if (!ok || stage < -1 || stage >= program->envelope.stageCount()) {
+                return fail("bad sustain stage");
+            }
+            program->envelope.setSustainStage(stage);
+        } else if (command == "fx") {
+            QString fxError;
+            if (!program->effects.parseChain(argument, &fxError)) {
+                return fail(fxError);
+            }
+        } else if (command == "gain") {
+            const qreal gain = number(1, &ok);
+            if (!ok || gain < 0.0 || gain > 1.0) {
+                return fail("bad gain");
+            }
+            program->gain = float(gain);
+        } else if (command == "oversample") {
+            const int factor = fields.value(1).toInt(&ok);
+            if (!ok || (factor != 1 && factor != 2 && factor != 4)) {
+                return fail("oversample must be 1, 2 or 4");
+            }
+            program->oversampling = factor;
+        } else {
+            return fail("unknown command '" + command + "'");
+        }
+    }
+    return true;
+}
+
+void PatchBank::clear()
+{
+    qDeleteAll(m_programs);
+    m_programs.clear();
+    m_preloads.clear();
+    m_bank.close();
+}
+
+int PatchBank::count() const
+{
+    return m_programs.size();
+}
+
+SynthProgram *PatchBank::program(int index) const
+{
+    return m_programs.at(index);
+}
+
+int PatchBank::find(const QString &name) const
+{
+    for (int i = 0; i < m_programs.size(); ++i) {
+        if (m_programs.at(i)->name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const SoundBank &PatchBank::soundBank() const
+{
+    return m_bank;
+}
+
+void PatchBank::setSampleRate(int sampleRate)
+{
+    for (SynthProgram *program : m_programs) {
+        program->envelope.setSampleRate(sampleRate);
+        program->effects.setSampleRate(sampleRate);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef PATCH_H
+#define PATCH_H
+
+#include <QString>
+#include <QVector>
+#include "effectgraph.h" // Обработка программы
+#include "envelope.h" // Огибающая программы
+#include "samplestream.h" // Зоны сэмплера
+#include "soundbank.h" // Таблицы и сэмплы из файла
+
+// Программа синтезатора, готовая для потока звука: генератор или зоны
+// сэмплера, огибающая, граф обработки и уровень. Все ресурсы (таблицы в банке, линии задержки)
+// подготовлены при загрузке, поэтому смена программы - замена указателя
+struct SynthProgram
+{
+    SynthProgram();
+
+    QString name;
+    const float *tables; // Мип-ступени генератора (встроенные или в банке)
+    QVector<SampleZone> zones; // Непустой - программа сэмплера, tables не нужны
+    EnvelopeShape envelope;
+    EffectGraph effects;
+    float gain; // Множитель громкости нажатия
+    int oversampling; // Кратность частоты генерации голосов: 1, 2 или 4
+};
+
+// Набор программ из текстового файла патчей. Строки:
+//     bank <файл>             банк таблиц и сэмплов (путь - от файла патчей)
+//     patch <имя>             начало программы; номер программы - порядок в файле
+//     osc <форма>             sine, saw, square, triangle или таблица банка
+//     zone <сэмпл> <нота> <нота> [<нажатие> <нажатие>]
+//                             сэмпл банка для диапазона нот и громкостей нажатия
+//                             (1..127); первая подходящая зона звучит
+//     adsr <атака мс> <спад мс> <уровень> <затухание мс> [кривая]
+//     stage <уровень> <мс> [кривая]   ступень огибающей (первая заменяет ADSR)
+//     sustain <ступень>       ступень удержания, -1 - без удержания
+//     fx <цепочка>            граф обработки в формате EffectGraph::parseChain()
+//     gain <0..1>             уровень программы
+//     oversample <1|2|4>      передискретизация голосов (чище звук, меньше полифония)
+// Текст после '#' - комментарий. Синтезатор хранит указатели на программы,
+// поэтому набор должен жить, пока синтезатор с ним работает
+class PatchBank
+{
+public:
+    // Номера программ MIDI
+    static const int MaxPrograms = 128;
+
+    PatchBank();
+    ~PatchBank();
+
+    bool load(const QString &fileName, QString *error = nullptr);
+    // directory - папка, от которой считаются пути банков
+    bool parse(const QString &text, const QString &directory, QString *error = nullptr);
+    void clear();
+
+    int count() const;
+    SynthProgram *program(int index) const;
+    // Номер программы по имени, -1 - нет такой
+    int find(const QString &name) const;
+    const SoundBank &soundBank() const;
+
+    // Пересчет огибающих и выделение линий задержки (не в потоке звука)
+    void setSampleRate(int sampleRate);
+
+private:
+    Q_DISABLE_COPY(PatchBank)
+
+    SoundBank m_bank;
+    // Начала сэмплов банка, на которые ссылаются зоны (по индексу записи)
+    QVector<QVector<float>> m_preloads;
+    QVector<SynthProgram *> m_programs;
+};
+
+#endif // PATCH_H
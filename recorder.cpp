@@ -0,0 +1,298 @@
+#include <cstring>
+#if defined(MINISYNTH_HAVE_FLAC)
+#include <FLAC/stream_encoder.h>
+#endif
+#include "recorder.h"
+#include "tonesynth.h" // Формат вывода
+
+namespace {
+// Емкость буфера записи: 2^22 байт - несколько секунд даже для 8 каналов float
+const int ringBits = 22;
+// Порция записи на диск. Емкость буфера кратна ей, поэтому порции не разрываются
+// концом буфера, а смещения в файле остаются выровненными
+const qint64 chunkBytes = 64 * 1024;
+// Выравнивание начала данных WAV в файле
+const int dataAlignment = 4096;
+// Пауза потока записи, когда порция еще не набралась
+const unsigned long idleMs = 20;
+} // namespace
+
+AudioRecorder::AudioRecorder(QObject *parent)
+    : QThread(parent)
+    , m_ring(ringBits)
+    , m_capturing(false)
+    , m_inCapture(0)
+    , m_stopRequested(false)
+    , m_dropped(0)
+    , m_framesWritten(0)
+    , m_container(Container::wav)
+    , m_sampleFormat(RenderKernels::SampleFormat::float32)
+    , m_frameBytes(1)
+    , m_writeFailed(false)
+#if defined(MINISYNTH_HAVE_FLAC)
+    , m_flac(nullptr)
+    , m_flacPending(0)
+#endif
+{}
+
+AudioRecorder::~AudioRecorder()
+{
+    stopRecording();
+}
+
+bool AudioRecorder::isFlacSupported()
+{
+#if defined(MINISYNTH_HAVE_FLAC)
+    return true;
+#else
+    return false;
+#endif
+}
+
+AudioRecorder::Container AudioRecorder::containerForFile(const QString &fileName)
+{
+    return fileName.endsWith(".flac", Qt::CaseInsensitive) ? Container::flac : Container::wav;
+}
+
+bool AudioRecorder::startRecording(const QString &fileName,
+                                   const QAudioFormat &format,
+                                   Container container,
+                                   QString *error)
+{
+    stopRecording();
+    if (!ToneSynthesizer::sampleFormat(format, &m_sampleFormat)) {
+        *error = "unsupported sample format";
+        return false;
+    }
+    m_container = container;
+    m_frameBytes = format.bytesPerFrame();
+    m_writeFailed = false;
+    m_error.clear();
+    if (container == Container::flac) {
+#if defined(MINISYNTH_HAVE_FLAC)
+        if (!openFlac(fileName, format, error)) {
+            return false;
+        }
+#else
+        *error = "FLAC support is not built in";
+        return false;
+#endif
+    } else if (!m_wav.open(fileName,
+                           format.sampleRate(),
+                           format.channelCount(),
+                           WavFileWriter::Container::wav,
+                           m_sampleFormat,
+                           dataAlignment)) {
+        *error = m_wav.errorString();
+        return false;
+    }
+    m_ring.clear();
+    m_dropped.store(0, std::memory_order_relaxed);
+    m_framesWritten.store(0, std::memory_order_relaxed);
+    m_stopRequested.store(false, std::memory_order_relaxed);
+    start(QThread::LowPriority);
+    m_capturing.store(true, std::memory_order_seq_cst);
+    return true;
+}
+
+bool AudioRecorder::stopRecording(QString *error)
+{
+    if (!isRunning()) {
+        return true;
+    }
+    // Сначала сторона звука перестает писать в буфер, затем поток записи
+    // дописывает остаток и закрывает файл
+    m_capturing.store(false, std::memory_order_seq_cst);
+    while (m_inCapture.load(std::memory_order_seq_cst) > 0) {
+        QThread::yieldCurrentThread();
+    }
+    m_stopRequested.store(true, std::memory_order_release);
+    wait();
+    if (m_writeFailed && error) {
+        *error = m_error;
+    }
+    return !m_writeFailed;
+}
+
+bool AudioRecorder::isRecording() const
+{
+    return m_capturing.load(std::memory_order_relaxed);
+}
+
+// Копирование блока в буфер записи (поток звука). Блок целиком или ничего:
+// частичная запись разорвала бы кадр
+void AudioRecorder::capture(const char *data, qint64 bytes)
+{
+    m_inCapture.fetch_add(1, std::memory_order_seq_cst);
+    if (m_capturing.load(std::memory_order_seq_cst)) {
+        if (m_ring.writable() >= bytes) {
+            m_ring.write(data, bytes);
+        } else {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    m_inCapture.fetch_sub(1, std::memory_order_release);
+}
+
+quint64 AudioRecorder::droppedBlocks() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+qint64 AudioRecorder::recordedFrames() const
+{
+    return m_framesWritten.load(std::memory_order_relaxed);
+}
+
+// Поток записи: запись целыми порциями прямо из памяти буфера, при остановке -
+// остаток и закрытие файла
+void AudioRecorder::run()
+{
+    for (;;) {
+        const bool stopping = m_stopRequested.load(std::memory_order_acquire);
+        const char *data = nullptr;
+        qint64 bytes = m_ring.peek(&data);
+        if (!stopping) {
+            bytes = bytes / chunkBytes * chunkBytes;
+        }
+        if (bytes > 0) {
+            if (!m_writeFailed && !writeData(data, bytes)) {
+                m_writeFailed = true; // Дальше буфер только освобождается
+            }
+            m_ring.consume(bytes);
+            continue;
+        }
+        if (stopping) {
+            break;
+        }
+        QThread::msleep(idleMs);
+    }
+    bool closed = true;
+#if defined(MINISYNTH_HAVE_FLAC)
+    if (m_container == Container::flac) {
+        closed = closeFlac();
+    }
+#endif
+    if (m_container == Container::wav) {
+        closed = m_wav.close();
+        if (!closed && m_error.isEmpty()) {
+            m_error = m_wav.errorString();
+        }
+    }
+    if (!closed) {
+        m_writeFailed = true;
+    }
+}
+
+bool AudioRecorder::writeData(const char *data, qint64 bytes)
+{
+#if defined(MINISYNTH_HAVE_FLAC)
+    if (m_container == Container::flac) {
+        return writeFlac(data, bytes);
+    }
+#endif
+    if (!m_wav.writeData(data, bytes)) {
+        m_error = m_wav.errorString();
+        return false;
+    }
+    m_framesWritten.store(m_wav.framesWritten(), std::memory_order_relaxed);
+    return true;
+}
+
+#if defined(MINISYNTH_HAVE_FLAC)
+namespace {
+// FLAC хранит целые: 16 бит для Int16, 24 бита для Int32 и float
+int flacBits(RenderKernels::SampleFormat format)
+{
+    return (format == RenderKernels::SampleFormat::int16) ? 16 : 24;
+}
+} // namespace
+
+bool AudioRecorder::openFlac(const QString &fileName, const QAudioFormat &format, QString *error)
+{
+    m_flac = FLAC__stream_encoder_new();
+    if (!m_flac) {
+        *error = "cannot create FLAC encoder";
+        return false;
+    }
+    FLAC__stream_encoder_set_channels(m_flac, unsigned(format.channelCount()));
+    FLAC__stream_encoder_set_bits_per_sample(m_flac, unsigned(flacBits(m_sampleFormat)));
+    FLAC__stream_encoder_set_sample_rate(m_flac, unsigned(format.sampleRate()));
+    FLAC__stream_encoder_set_compression_level(m_flac, 5);
+    const FLAC__StreamEncoderInitStatus status
+        = FLAC__stream_encoder_init_file(m_flac, QFile::encodeName(fileName).constData(), nullptr, nullptr);
+    if (status != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+        *error = QString("cannot open FLAC output: %1").arg(FLAC__StreamEncoderInitStatusString[status]);
+        FLAC__stream_encoder_delete(m_flac);
+        m_flac = nullptr;
+        return false;
+    }
+    m_flacSamples.resize(int(chunkBytes / 2) + format.channelCount());
+    m_flacPending = 0;
+    return true;
+}
+
+// Перевод порции в целые сэмплы и кодирование целых кадров; хвост неполного
+// кадра остается до следующей порции
+bool AudioRecorder::writeFlac(const char *data, qint64 bytes)
+{
+    const int sampleBytes = (m_sampleFormat == RenderKernels::SampleFormat::int16) ? 2 : 4;
+    const int channels = m_frameBytes / sampleBytes;
+    while (bytes > 0) {
+        const int room = m_flacSamples.size() - m_flacPending;
+        const int count = int(qMin<qint64>(room, bytes / sampleBytes));
+        qint32 *out = m_flacSamples.data() + m_flacPending;
+        for (int i = 0; i < count; ++i) {
+            const char *p = data + qint64(i) * sampleBytes;
+            switch (m_sampleFormat) {
+            case RenderKernels::SampleFormat::int16: {
+                qint16 v;
+                std::memcpy(&v, p, sizeof(v));
+                out[i] = v;
+                break;
+            }
+            case RenderKernels::SampleFormat::int32: {
+                qint32 v;
+                std::memcpy(&v, p, sizeof(v));
+                out[i] = v >> 8;
+                break;
+            }
+            case RenderKernels::SampleFormat::float32: {
+                float v;
+                std::memcpy(&v, p, sizeof(v));
+                out[i] = qint32(qBound(-8388608.0f, v * 8388607.0f, 8388607.0f));
+                break;
+            }
+            }
+        }
+        data += qint64(count) * sampleBytes;
+        bytes -= qint64(count) * sampleBytes;
+        const int total = m_flacPending + count;
+        const int frames = total / channels;
+        if (frames > 0
+            && !FLAC__stream_encoder_process_interleaved(m_flac, m_flacSamples.constData(), unsigned(frames))) {
+            m_error = FLAC__StreamEncoderStateString[FLAC__stream_encoder_get_state(m_flac)];
+            return false;
+        }
+        m_flacPending = total - frames * channels;
+        std::memmove(m_flacSamples.data(), m_flacSamples.constData() + frames * channels,
+                     size_t(m_flacPending) * sizeof(qint32));
+        m_framesWritten.fetch_add(frames, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+bool AudioRecorder::closeFlac()
+{
+    if (!m_flac) {
+        return true;
+    }
+    const bool ok = FLAC__stream_encoder_finish(m_flac);
+    if (!ok && m_error.isEmpty()) {
+        m_error = FLAC__StreamEncoderStateString[FLAC__stream_encoder_get_state(m_flac)];
+    }
+    FLAC__stream_encoder_delete(m_flac);
+    m_flac = nullptr;
+    return ok;
+}
+#endif
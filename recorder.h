@@ -0,0 +1,82 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <atomic>
+#include <QAudioFormat>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include "ringbuffer.h" // Кольцевой буфер между потоками
+#include "wavfile.h" // Запись WAV
+
+#if defined(MINISYNTH_HAVE_FLAC)
+struct FLAC__StreamEncoder;
+#endif
+
+// Запись исполнения. Синтезатор копирует каждый сгенерированный буфер в кольцевой
+// буфер записи (capture()), фоновый поток сбрасывает его на диск крупными
+// порциями прямо из памяти буфера - в WAV или, если собрано с libFLAC, во FLAC.
+// Сторона звука не блокируется и не выделяет память: если диск не успевает
+// и места нет, блок отбрасывается и учитывается в счетчике
+class AudioRecorder : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum class Container : int { wav, flac };
+
+    explicit AudioRecorder(QObject *parent = nullptr);
+    ~AudioRecorder() override;
+
+    static bool isFlacSupported();
+    // Контейнер по расширению имени файла (.flac - FLAC, иначе WAV)
+    static Container containerForFile(const QString &fileName);
+
+    // Запуск записи в формате вывода синтезатора
+    bool startRecording(const QString &fileName,
+                        const QAudioFormat &format,
+                        Container container,
+                        QString *error);
+    // Остановка: остаток буфера дописывается, файл закрывается. false - была ошибка записи
+    bool stopRecording(QString *error = nullptr);
+    bool isRecording() const;
+
+    // Сторона звука: копия готовых данных в буфер записи
+    void capture(const char *data, qint64 bytes);
+
+    // Отброшенные блоки и записанные кадры (для GUI)
+    quint64 droppedBlocks() const;
+    qint64 recordedFrames() const;
+
+protected:
+    void run() override;
+
+private:
+    bool writeData(const char *data, qint64 bytes);
+#if defined(MINISYNTH_HAVE_FLAC)
+    bool openFlac(const QString &fileName, const QAudioFormat &format, QString *error);
+    bool writeFlac(const char *data, qint64 bytes);
+    bool closeFlac();
+#endif
+
+    RingBuffer m_ring;
+    std::atomic<bool> m_capturing; // Сторона звука пишет в буфер
+    std::atomic<int> m_inCapture;  // Идущие вызовы capture()
+    std::atomic<bool> m_stopRequested;
+    std::atomic<quint64> m_dropped;
+    std::atomic<qint64> m_framesWritten;
+    // Состояние потока записи
+    Container m_container;
+    RenderKernels::SampleFormat m_sampleFormat;
+    int m_frameBytes;
+    bool m_writeFailed;
+    QString m_error;
+    WavFileWriter m_wav;
+#if defined(MINISYNTH_HAVE_FLAC)
+    FLAC__StreamEncoder *m_flac;
+    QVector<qint32> m_flacSamples; // Сэмплы для кодера (целые)
+    int m_flacPending; // Сэмплов неполного кадра в начале m_flacSamples
+#endif
+};
+
+#endif // RECORDER_H
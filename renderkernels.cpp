@@ -0,0 +1,376 @@
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "renderkernels.h"
+#include "wavetable.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define RENDERKERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define RENDERKERNELS_TARGET_AVX2
+#else
+#define RENDERKERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+// Скалярная реализация - эталон и запасной вариант для остальных платформ
+void oscillatorScalar(float *out,
+                      int frames,
+                      const float *table,
+                      quint32 *phase,
+                      quint32 phaseDelta,
+                      float gain,
+                      float gainStep)
+{
+    quint32 p = *phase;
+    for (int i = 0; i < frames; ++i) {
+        out[i] += (gain + float(i) * gainStep) * Wavetable::lookup(table, p);
+        p += phaseDelta;
+    }
+    *phase = p;
+}
+
+// Наибольшее значение float, не превышающее INT32_MAX
+const float int32Limit = 2147483520.0f;
+
+inline qint16 toInt16(float x)
+{
+    return qint16(std::lrint(qBound(-1.0f, x, 1.0f) * 32767.0f));
+}
+
+inline qint32 toInt32(float x)
+{
+    return qint32(std::lrint(qMin(qBound(-1.0f, x, 1.0f) * 2147483647.0f, int32Limit)));
+}
+
+inline float toFloat(float x)
+{
+    return x;
+}
+
+// Скалярное преобразование с размножением по каналам
+template <typename T, T (*convert)(float)>
+void convertScalar(const float *in, void *out, int frames, int channels)
+{
+    T *dst = static_cast<T *>(out);
+    for (int i = 0; i < frames; ++i) {
+        const T value = convert(in[i]);
+        for (int c = 0; c < channels; ++c) {
+            *dst++ = value;
+        }
+    }
+}
+
+void halfBandScalar(float *out, int frames, const float *even, const float *odd, const float *coefficients, int pairs)
+{
+    for (int n = 0; n < frames; ++n) {
+        float sum = 0.5f * odd[n];
+        const float *center = even + n + pairs;
+        for (int k = 0; k < pairs; ++k) {
+            sum += coefficients[k] * (center[k] + center[-1 - k]);
+        }
+        out[n] = sum;
+    }
+}
+
+#if defined(RENDERKERNELS_X86)
+
+// Повторение готовых значений по каналам для числа каналов больше двух
+template <typename T>
+inline T *spreadChannels(const T *values, int count, T *dst, int channels)
+{
+    for (int i = 0; i < count; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            *dst++ = values[i];
+        }
+    }
+    return dst;
+}
+
+// SSE2: восемь сэмплов за шаг; моно и стерео записываются векторно
+// (стерео - чередованием копий командами unpack)
+void convertInt16Sse2(const float *in, void *out, int frames, int channels)
+{
+    const __m128 lower = _mm_set1_ps(-1.0f);
+    const __m128 upper = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(32767.0f);
+    qint16 *dst = static_cast<qint16 *>(out);
+    alignas(16) qint16 values[8];
+    int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        const __m128 a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), lower), upper), scale);
+        const __m128 b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 4), lower), upper),
+                                    scale);
+        const __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        if (channels == 1) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), packed);
+            dst += 8;
+        } else if (channels == 2) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_unpacklo_epi16(packed, packed));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 8), _mm_unpackhi_epi16(packed, packed));
+            dst += 16;
+        } else {
+            _mm_store_si128(reinterpret_cast<__m128i *>(values), packed);
+            dst = spreadChannels(values, 8, dst, channels);
+        }
+    }
+    convertScalar<qint16, toInt16>(in + i, dst, frames - i, channels);
+}
+
+void convertInt32Sse2(const float *in, void *out, int frames, int channels)
+{
+    const __m128 lower = _mm_set1_ps(-1.0f);
+    const __m128 upper = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(2147483647.0f);
+    const __m128 limit = _mm_set1_ps(int32Limit);
+    qint32 *dst = static_cast<qint32 *>(out);
+    alignas(16) qint32 values[4];
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        const __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), lower), upper);
+        const __m128i v = _mm_cvtps_epi32(_mm_min_ps(_mm_mul_ps(x, scale), limit));
+        if (channels == 1) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), v);
+            dst += 4;
+        } else if (channels == 2) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_unpacklo_epi32(v, v));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4), _mm_unpackhi_epi32(v, v));
+            dst += 8;
+        } else {
+            _mm_store_si128(reinterpret_cast<__m128i *>(values), v);
+            dst = spreadChannels(values, 4, dst, channels);
+        }
+    }
+    convertScalar<qint32, toInt32>(in + i, dst, frames - i, channels);
+}
+
+void convertFloatSse2(const float *in, void *out, int frames, int channels)
+{
+    float *dst = static_cast<float *>(out);
+    if (channels == 1) {
+        std::memcpy(dst, in, size_t(frames) * sizeof(float));
+        return;
+    }
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        const __m128 v = _mm_loadu_ps(in + i);
+        if (channels == 2) {
+            _mm_storeu_ps(dst, _mm_unpacklo_ps(v, v));
+            _mm_storeu_ps(dst + 4, _mm_unpackhi_ps(v, v));
+            dst += 8;
+        } else {
+            dst = spreadChannels(in + i, 4, dst, channels);
+        }
+    }
+    convertScalar<float, toFloat>(in + i, dst, frames - i, channels);
+}
+
+// SSE2: четыре сэмпла за шаг. Выборка из таблицы скалярная (в SSE2 нет gather),
+// интерполяция, огибающая и накопление - векторные
+void oscillatorSse2(float *out,
+                    int frames,
+                    const float *table,
+                    quint32 *phase,
+                    quint32 phaseDelta,
+                    float gain,
+                    float gainStep)
+{
+    const __m128i fracMask = _mm_set1_epi32((1 << Wavetable::FractionBits) - 1);
+    const __m128 fracScale = _mm_set1_ps(1.0f / float(1 << Wavetable::FractionBits));
+    const __m128i delta4 = _mm_set1_epi32(int(phaseDelta * 4));
+    const __m128 step4 = _mm_set1_ps(gainStep * 4.0f);
+    const quint32 p = *phase;
+    __m128i phases = _mm_setr_epi32(int(p),
+                                    int(p + phaseDelta),
+                                    int(p + phaseDelta * 2),
+                                    int(p + phaseDelta * 3));
+    __m128 gains = _mm_setr_ps(gain, gain + gainStep, gain + gainStep * 2, gain + gainStep * 3);
+
+    int i = 0;
+    alignas(16) qint32 index[4];
+    for (; i + 4 <= frames; i += 4) {
+        _mm_store_si128(reinterpret_cast<__m128i *>(index),
+                        _mm_srli_epi32(phases, Wavetable::FractionBits));
+        const __m128 a = _mm_setr_ps(table[index[0]], table[index[1]], table[index[2]], table[index[3]]);
+        const __m128 b = _mm_setr_ps(table[index[0] + 1],
+                                     table[index[1] + 1],
+                                     table[index[2] + 1],
+                                     table[index[3] + 1]);
+        const __m128 frac = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(phases, fracMask)), fracScale);
+        const __m128 sample = _mm_add_ps(a, _mm_mul_ps(frac, _mm_sub_ps(b, a)));
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(gains, sample)));
+        phases = _mm_add_epi32(phases, delta4);
+        gains = _mm_add_ps(gains, step4);
+    }
+    *phase = p + phaseDelta * quint32(i);
+    oscillatorScalar(out + i, frames - i, table, phase, phaseDelta, gain + float(i) * gainStep, gainStep);
+}
+
+// AVX2: восемь сэмплов за шаг, выборка из таблицы командой gather
+RENDERKERNELS_TARGET_AVX2
+void oscillatorAvx2(float *out,
+                    int frames,
+                    const float *table,
+                    quint32 *phase,
+                    quint32 phaseDelta,
+                    float gain,
+                    float gainStep)
+{
+    const __m256i fracMask = _mm256_set1_epi32((1 << Wavetable::FractionBits) - 1);
+    const __m256 fracScale = _mm256_set1_ps(1.0f / float(1 << Wavetable::FractionBits));
+    const __m256i delta8 = _mm256_set1_epi32(int(phaseDelta * 8));
+    const __m256 step8 = _mm256_set1_ps(gainStep * 8.0f);
+    const quint32 p = *phase;
+    __m256i phases = _mm256_add_epi32(_mm256_set1_epi32(int(p)),
+                                      _mm256_mullo_epi32(_mm256_set1_epi32(int(phaseDelta)),
+                                                         _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+    __m256 gains = _mm256_add_ps(_mm256_set1_ps(gain),
+                                 _mm256_mul_ps(_mm256_set1_ps(gainStep),
+                                               _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)));
+
+    int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        const __m256i index = _mm256_srli_epi32(phases, Wavetable::FractionBits);
+        const __m256 a = _mm256_i32gather_ps(table, index, 4);
+        const __m256 b = _mm256_i32gather_ps(table + 1, index, 4);
+        const __m256 frac = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(phases, fracMask)),
+                                          fracScale);
+        const __m256 sample = _mm256_add_ps(a, _mm256_mul_ps(frac, _mm256_sub_ps(b, a)));
+        _mm256_storeu_ps(out + i,
+                         _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(gains, sample)));
+        phases = _mm256_add_epi32(phases, delta8);
+        gains = _mm256_add_ps(gains, step8);
+    }
+    *phase = p + phaseDelta * quint32(i);
+    // Остаток считается кодом без VEX: верхние половины регистров нужно обнулить,
+    // иначе каждая команда SSE платит за переход между состояниями AVX и SSE
+    _mm256_zeroupper();
+    oscillatorSse2(out + i, frames - i, table, phase, phaseDelta, gain + float(i) * gainStep, gainStep);
+}
+
+// Ветвь дециматора: четыре (SSE2) или восемь (AVX2) выходных сэмплов за шаг,
+// пары коэффициентов - внутренний цикл. Коэффициентов не больше нескольких
+// десятков, поэтому окно входа остается в кэше L1
+void halfBandSse2(float *out, int frames, const float *even, const float *odd, const float *coefficients, int pairs)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    int n = 0;
+    for (; n + 4 <= frames; n += 4) {
+        __m128 sum = _mm_mul_ps(half, _mm_loadu_ps(odd + n));
+        const float *center = even + n + pairs;
+        for (int k = 0; k < pairs; ++k) {
+            const __m128 pair = _mm_add_ps(_mm_loadu_ps(center + k), _mm_loadu_ps(center - 1 - k));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(coefficients[k]), pair));
+        }
+        _mm_storeu_ps(out + n, sum);
+    }
+    halfBandScalar(out + n, frames - n, even + n, odd + n, coefficients, pairs);
+}
+
+RENDERKERNELS_TARGET_AVX2
+void halfBandAvx2(float *out, int frames, const float *even, const float *odd, const float *coefficients, int pairs)
+{
+    const __m256 half = _mm256_set1_ps(0.5f);
+    int n = 0;
+    for (; n + 8 <= frames; n += 8) {
+        __m256 sum = _mm256_mul_ps(half, _mm256_loadu_ps(odd + n));
+        const float *center = even + n + pairs;
+        for (int k = 0; k < pairs; ++k) {
+            const __m256 pair = _mm256_add_ps(_mm256_loadu_ps(center + k), _mm256_loadu_ps(center - 1 - k));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(coefficients[k]), pair));
+        }
+        _mm256_storeu_ps(out + n, sum);
+    }
+    halfBandSse2(out + n, frames - n, even + n, odd + n, coefficients, pairs);
+}
+
+// Проверка поддержки AVX2 процессором и операционной системой
+bool cpuHasAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // RENDERKERNELS_X86
+
+struct KernelChoice
+{
+    RenderKernels::OscillatorKernel oscillator;
+    const char *name;
+    // Преобразования в порядке RenderKernels::SampleFormat
+    RenderKernels::ConvertKernel convert[3];
+    RenderKernels::HalfBandKernel halfBand;
+};
+
+// Переменная окружения MINISYNTH_SIMD=scalar|sse2 ограничивает выбор
+// (для сравнения реализаций между собой). Преобразования формата упираются
+// в память, поэтому при AVX2 используются те же ядра SSE2
+KernelChoice chooseKernels()
+{
+    const char *limit = std::getenv("MINISYNTH_SIMD");
+    const KernelChoice scalar = {oscillatorScalar,
+                                 "scalar",
+                                 {convertScalar<qint16, toInt16>,
+                                  convertScalar<qint32, toInt32>,
+                                  convertScalar<float, toFloat>},
+                                 halfBandScalar};
+    if (limit && std::strcmp(limit, "scalar") == 0) {
+        return scalar;
+    }
+#if defined(RENDERKERNELS_X86)
+    if (cpuHasAvx2() && !(limit && std::strcmp(limit, "sse2") == 0)) {
+        return {oscillatorAvx2, "avx2", {convertInt16Sse2, convertInt32Sse2, convertFloatSse2}, halfBandAvx2};
+    }
+    return {oscillatorSse2, "sse2", {convertInt16Sse2, convertInt32Sse2, convertFloatSse2}, halfBandSse2};
+#else
+    return scalar;
+#endif
+}
+
+const KernelChoice &kernels()
+{
+    static const KernelChoice choice = chooseKernels();
+    return choice;
+}
+
+} // namespace
+
+RenderKernels::OscillatorKernel RenderKernels::oscillator()
+{
+    return kernels().oscillator;
+}
+
+RenderKernels::ConvertKernel RenderKernels::converter(SampleFormat format)
+{
+    return kernels().convert[int(format)];
+}
+
+RenderKernels::HalfBandKernel RenderKernels::halfBand()
+{
+    return kernels().halfBand;
+}
+
+const char *RenderKernels::oscillatorName()
+{
+    return kernels().name;
+}
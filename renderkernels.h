@@ -0,0 +1,50 @@
+#ifndef RENDERKERNELS_H
+#define RENDERKERNELS_H
+
+#include <QtGlobal>
+
+// Ядра блочной генерации. Реализация (SSE2, AVX2 или скалярная) выбирается
+// один раз во время выполнения по возможностям процессора
+namespace RenderKernels {
+
+// Добавление к out[0..frames) табличного генератора, умноженного на линейную
+// огибающую: out[i] += (gain + i * gainStep) * table(phase + i * phaseDelta).
+// По завершении *phase указывает на сэмпл, следующий за блоком
+typedef void (*OscillatorKernel)(float *out,
+                                 int frames,
+                                 const float *table,
+                                 quint32 *phase,
+                                 quint32 phaseDelta,
+                                 float gain,
+                                 float gainStep);
+
+OscillatorKernel oscillator();
+
+// Форматы сэмплов устройства вывода
+enum class SampleFormat : int { int16, int32, float32 };
+
+// Перевод моно-блока in[0..frames) в формат устройства с повторением сэмпла
+// в каждом из channels каналов (кадры чередуются). Целые форматы ограничиваются
+// диапазоном [-1, 1] и округляются к ближайшему
+typedef void (*ConvertKernel)(const float *in, void *out, int frames, int channels);
+
+ConvertKernel converter(SampleFormat format);
+
+// Ветвь полуполосного дециматора (Decimator): для n < frames
+//   out[n] = 0.5 * odd[n] + sum(coefficients[k] * (even[n + pairs + k] + even[n + pairs - 1 - k]))
+// по k < pairs. Порядок сложения одинаков во всех реализациях
+typedef void (*HalfBandKernel)(float *out,
+                               int frames,
+                               const float *even,
+                               const float *odd,
+                               const float *coefficients,
+                               int pairs);
+
+HalfBandKernel halfBand();
+
+// Название выбранной реализации (для отладки и тестов производительности)
+const char *oscillatorName();
+
+} // namespace RenderKernels
+
+#endif // RENDERKERNELS_H
@@ -0,0 +1,284 @@
+#include <algorithm>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QVector>
+
+#include <QAudioFormat>
+
+#include "audiocheck.h" // Сравнение с эталоном
+#include "midifile.h" // MIDI-файлы
+#include "notescript.h" // Сценарий нот
+#include "tonesynth.h" // Синтезатор
+#include "wavfile.h" // Запись результата
+
+// Генерация звука по сценарию нот без звуковой карты и графического интерфейса.
+// readData() вызывается так быстро, как только возможно; в конце выводится
+// скорость генерации относительно реального времени
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("minisynth-render");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Offline renderer for the minimal synthesizer");
+    parser.addHelpOption();
+    parser.addPositionalArgument("script",
+                                 "Note script file ('-' for standard input) or MIDI file (.mid).");
+    QCommandLineOption outputOption({"o", "output"}, "Output file ('-' for standard output).", "file");
+    QCommandLineOption rawOption("raw", "Write raw 32-bit float samples instead of WAV.");
+    QCommandLineOption rateOption({"r", "rate"}, "Sample rate in Hz.", "hz", "44100");
+    QCommandLineOption blockOption({"b", "block"}, "Frames per readData() call.", "frames", "512");
+    QCommandLineOption tailOption("tail", "Seconds rendered after the last event.", "seconds", "1.0");
+    QCommandLineOption repeatOption("repeat", "Render the script N times (throughput runs).", "n", "1");
+    QCommandLineOption threadsOption({"j", "threads"}, "Voice rendering threads (1 = serial).", "n", "1");
+    QCommandLineOption referenceOption("a4", "Reference frequency of A4 in Hz.", "hz", "440");
+    QCommandLineOption temperamentOption("temperament",
+                                         "Temperament: equal, pythagorean, just, meantone, "
+                                         "werckmeister.",
+                                         "name",
+                                         "equal");
+    QCommandLineOption envelopeOption("adsr",
+                                      "Envelope: attack ms, decay ms, sustain level, release ms.",
+                                      "a,d,s,r",
+                                      "20,0,1,20");
+    QCommandLineOption curveOption("curve", "Envelope curve: linear, exponential.", "name", "exponential");
+    QCommandLineOption effectsOption("fx",
+                                     "Effect chain, e.g. 'filter:lowpass,1200,0.7;delay:350,0.4,0.3;"
+                                     "reverb:0.7,0.5,0.25'.",
+                                     "chain");
+    QCommandLineOption patchesOption("patches", "Patch file with programs (and their sound bank).", "file");
+    QCommandLineOption programOption("program", "Initial program number from --patches.", "n");
+    QCommandLineOption oversampleOption("oversample",
+                                        "Voice oversampling of the built-in program: 1, 2 or 4.",
+                                        "factor",
+                                        "1");
+    QCommandLineOption compareOption("compare",
+                                     "Compare the first pass with a reference WAV file; exit code 2 "
+                                     "on mismatch.",
+                                     "file");
+    QCommandLineOption maxErrorOption("max-error", "Largest sample difference for --compare.", "value", "1e-4");
+    QCommandLineOption minSnrOption("min-snr", "Lowest signal-to-difference ratio for --compare.", "db", "90");
+    parser.addOptions({outputOption,
+                       rawOption,
+                       rateOption,
+                       blockOption,
+                       tailOption,
+                       repeatOption,
+                       threadsOption,
+                       referenceOption,
+                       temperamentOption,
+                       envelopeOption,
+                       curveOption,
+                       effectsOption,
+                       patchesOption,
+                       programOption,
+                       oversampleOption,
+                       compareOption,
+                       maxErrorOption,
+                       minSnrOption});
+    parser.process(app);
+
+    QTextStream err(stderr);
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 1) {
+        parser.showHelp(1);
+    }
+    const int sampleRate = parser.value(rateOption).toInt();
+    const int blockFrames = parser.value(blockOption).toInt();
+    const qreal tail = parser.value(tailOption).toDouble();
+    const int repeat = parser.value(repeatOption).toInt();
+    const int threads = parser.value(threadsOption).toInt();
+    const qreal referenceHz = parser.value(referenceOption).toDouble();
+    const int oversampling = parser.value(oversampleOption).toInt();
+    if (sampleRate <= 0 || blockFrames <= 0 || tail < 0.0 || repeat <= 0 || referenceHz <= 0.0
+        || (oversampling != 1 && oversampling != 2 && oversampling != 4)) {
+        err << "invalid numeric option" << Qt::endl;
+        return 1;
+    }
+    NoteTuning::Temperament temperament;
+    if (!NoteTuning::parseTemperament(parser.value(temperamentOption), &temperament)) {
+        err << "unknown temperament '" << parser.value(temperamentOption) << "'" << Qt::endl;
+        return 1;
+    }
+    EnvelopeShape::Curve curve;
+    if (!EnvelopeShape::parseCurve(parser.value(curveOption), &curve)) {
+        err << "unknown envelope curve '" << parser.value(curveOption) << "'" << Qt::endl;
+        return 1;
+    }
+    const QStringList adsr = parser.value(envelopeOption).split(',');
+    if (adsr.size() != 4) {
+        err << "envelope needs four values: attack,decay,sustain,release" << Qt::endl;
+        return 1;
+    }
+    const EnvelopeShape envelope = EnvelopeShape::adsr(adsr.at(0).toDouble(),
+                                                       adsr.at(1).toDouble(),
+                                                       adsr.at(2).toDouble(),
+                                                       adsr.at(3).toDouble(),
+                                                       curve);
+
+    // Программы загружаются один раз: банк отображается в память, проходы
+    // используют его без копирования
+    QString error;
+    PatchBank patches;
+    if (parser.isSet(patchesOption) && !patches.load(parser.value(patchesOption), &error)) {
+        err << error << Qt::endl;
+        return 1;
+    }
+    const int program = parser.isSet(programOption) ? parser.value(programOption).toInt() : -1;
+    if (program >= patches.count()) {
+        err << "no program " << program << " in the patch file" << Qt::endl;
+        return 1;
+    }
+
+    // Сценарий или MIDI-файл: в обоих случаях события с метками в сэмплах
+    QVector<SynthEvent> events;
+    qreal duration = 0.0;
+    const QString input = args.at(0);
+    if (input.endsWith(".mid", Qt::CaseInsensitive) || input.endsWith(".midi", Qt::CaseInsensitive)) {
+        MidiFile midi;
+        if (!midi.load(input, &error)) {
+            err << error << Qt::endl;
+            return 1;
+        }
+        events = midi.events(sampleRate);
+        duration = midi.duration();
+    } else {
+        NoteScript script;
+        if (!script.load(input, &error)) {
+            err << error << Qt::endl;
+            return 1;
+        }
+        events = script.events(sampleRate);
+        duration = script.duration();
+    }
+
+    // Эталон для сравнения: та же частота дискретизации, каналы сводятся
+    WavFileReader reference;
+    const bool compare = parser.isSet(compareOption);
+    AudioCheck::Tolerances tolerances = AudioCheck::defaultTolerances();
+    tolerances.maxError = parser.value(maxErrorOption).toFloat();
+    tolerances.minSnrDb = parser.value(minSnrOption).toDouble();
+    if (compare) {
+        if (!reference.load(parser.value(compareOption), &error)) {
+            err << error << Qt::endl;
+            return 1;
+        }
+        if (reference.sampleRate() != sampleRate) {
+            err << "reference is " << reference.sampleRate() << " Hz, rendering at " << sampleRate << " Hz"
+                << Qt::endl;
+            return 1;
+        }
+    }
+
+    const QAudioFormat format = ToneSynthesizer::makeFormat(sampleRate, 1, RenderKernels::SampleFormat::float32);
+
+    WavFileWriter writer;
+    const bool writeOutput = parser.isSet(outputOption);
+    if (writeOutput
+        && !writer.open(parser.value(outputOption),
+                        sampleRate,
+                        1,
+                        parser.isSet(rawOption) ? WavFileWriter::Container::raw
+                                                : WavFileWriter::Container::wav)) {
+        err << "cannot open output: " << writer.errorString() << Qt::endl;
+        return 1;
+    }
+
+    const quint64 scriptFrames = quint64(qRound64((duration + tail) * sampleRate));
+    QVector<float> buffer(blockFrames);
+    QVector<float> output;
+    if (compare) {
+        output.reserve(int(scriptFrames));
+    }
+    qint64 renderNs = 0;
+    quint64 totalFrames = 0;
+    QElapsedTimer wallClock;
+    wallClock.start();
+
+    for (int pass = 0; pass < repeat; ++pass) {
+        // Новый синтезатор на каждый проход: позиции событий отсчитываются от нуля
+        ToneSynthesizer synth(format);
+        synth.setRenderThreads(threads);
+        synth.setOfflineRendering(true);
+        synth.setEnvelope(envelope);
+        synth.setOversampling(oversampling);
+        if (!synth.effects().parseChain(parser.value(effectsOption), &error)) {
+            err << error << Qt::endl;
+            return 1;
+        }
+        synth.setPatchBank(&patches);
+        synth.start();
+        synth.setTuning(referenceHz, temperament);
+        if (program >= 0) {
+            synth.selectProgram(program);
+        }
+        int next = 0;
+        for (quint64 pos = 0; pos < scriptFrames;) {
+            const int count = int(qMin<quint64>(quint64(blockFrames), scriptFrames - pos));
+            // В очередь попадают события, которые наступят до конца этого блока
+            while (next < events.size() && events.at(next).frame < pos + quint64(count)
+                   && synth.postEvent(events.at(next))) {
+                ++next;
+            }
+            QElapsedTimer timer;
+            timer.start();
+            synth.read(reinterpret_cast<char *>(buffer.data()), qint64(count) * qint64(sizeof(float)));
+            renderNs += timer.nsecsElapsed();
+            if (writeOutput && pass == 0 && !writer.write(buffer.constData(), count)) {
+                err << "write error: " << writer.errorString() << Qt::endl;
+                return 1;
+            }
+            if (compare && pass == 0) {
+                const int start = output.size();
+                output.resize(start + count);
+                std::copy(buffer.constData(), buffer.constData() + count, output.data() + start);
+            }
+            pos += quint64(count);
+            totalFrames += quint64(count);
+        }
+        synth.stop();
+    }
+    if (writeOutput && !writer.close()) {
+        err << "write error: " << writer.errorString() << Qt::endl;
+        return 1;
+    }
+
+    // Отчет о производительности: скорость в сэмплах в секунду и кратность реальному времени
+    const qreal renderSeconds = qMax<qreal>(renderNs / 1e9, 1e-9);
+    const qreal audioSeconds = qreal(totalFrames) / sampleRate;
+    err << "kernel: " << RenderKernels::oscillatorName() << Qt::endl
+        << "rendered: " << totalFrames << " frames (" << audioSeconds << " s)" << Qt::endl
+        << "render time: " << renderSeconds * 1000.0 << " ms (wall "
+        << wallClock.elapsed() << " ms)" << Qt::endl
+        << "throughput: " << qRound64(totalFrames / renderSeconds) << " samples/s" << Qt::endl
+        << "realtime factor: " << audioSeconds / renderSeconds << "x" << Qt::endl;
+
+    if (compare) {
+        // Окрестности включений и выключений нот проверяются на щелчки
+        QVector<quint64> eventFrames;
+        for (const SynthEvent &event : events) {
+            if (event.type == SynthEvent::Type::noteOn || event.type == SynthEvent::Type::noteOff) {
+                eventFrames.append(event.frame);
+            }
+        }
+        const AudioCheck::Report report = AudioCheck::compare(output, reference.mono(), sampleRate, eventFrames,
+                                                              tolerances);
+        err << "compare: max error " << report.maxError << " at frame " << report.maxErrorFrame << ", SNR "
+            << report.snrDb << " dB" << Qt::endl
+            << "compare: " << report.windows << " windows, pitch within " << report.maxCents
+            << " cents, floor " << report.floorDb << " dB (reference " << report.referenceFloorDb << " dB)"
+            << Qt::endl
+            << "compare: " << report.events << " note events, " << report.clicks << " clicks" << Qt::endl;
+        for (const QString &failure : report.failures) {
+            err << "FAIL: " << failure << Qt::endl;
+        }
+        if (!report.passed()) {
+            return 2;
+        }
+        err << "compare: passed" << Qt::endl;
+    }
+    return 0;
+}
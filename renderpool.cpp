@@ -0,0 +1,171 @@
+#include <QtGlobal>
+#if defined(Q_OS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define RENDERPOOL_PAUSE() _mm_pause()
+#else
+#define RENDERPOOL_PAUSE() ((void) 0)
+#endif
+#include "renderpool.h"
+
+namespace {
+// Сколько проверок номера порции рабочий поток делает перед тем, как уснуть.
+// Порции идут с периодом блока, так что поток между ними обычно не засыпает
+const int spinChecks = 20000;
+} // namespace
+
+RenderWorker::RenderWorker(RenderPool *pool, int index)
+    : QThread()
+    , m_pool(pool)
+    , m_index(index)
+{}
+
+void RenderWorker::run()
+{
+#if defined(Q_OS_LINUX)
+    // Закрепление за ядром: данные голосов остаются в его кэше. Номер ядра -
+    // номер рабочего (1..n): номер 0 у потока, вызывающего run(), он сам
+    // генерирует свою долю и не закреплен. Ядро 0 рабочим не достается, чтобы
+    // вызывающему потоку, GUI и обратному вызову устройства оставалось ядро,
+    // не занятое активным ожиданием рабочих
+    const int cores = QThread::idealThreadCount();
+    if (cores > 1) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(m_index % cores, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    // Приоритет как у потока генерации, если система разрешает
+    sched_param param;
+    param.sched_priority = (sched_get_priority_min(SCHED_FIFO) + sched_get_priority_max(SCHED_FIFO)) / 2;
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#endif
+    m_pool->workerLoop(m_index);
+}
+
+RenderPool::RenderPool(int workers)
+    : m_function(nullptr)
+    , m_context(nullptr)
+    , m_generation(0)
+    , m_remaining(0)
+    , m_sleeping(0)
+    , m_wake(0)
+    , m_stopRequested(false)
+{
+    // Потоков не больше, чем свободных ядер: ожидающий активно поток на занятом
+    // ядре отнимает время у того, кого он ждет
+    const int cores = QThread::idealThreadCount() - 1;
+    workers = qBound(0, workers < 0 ? cores : qMin(workers, cores), int(MaxWorkers));
+    for (int i = 0; i <= MaxWorkers; ++i) {
+        m_ranges[i].state.store(0, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < workers; ++i) {
+        RenderWorker *thread = new RenderWorker(this, i + 1);
+        m_threads.append(thread);
+        thread->start(QThread::TimeCriticalPriority);
+    }
+}
+
+RenderPool::~RenderPool()
+{
+    m_stopRequested.store(true, std::memory_order_seq_cst);
+    m_wake.release(m_threads.size());
+    for (RenderWorker *thread : m_threads) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+int RenderPool::workers() const
+{
+    return m_threads.size();
+}
+
+// Выполнение порции задач. Вызывается одним потоком (потоком генерации)
+void RenderPool::run(TaskFunction function, void *context, int count)
+{
+    Q_ASSERT(count <= MaxTasks);
+    if (count <= 0) {
+        return;
+    }
+    const int participants = m_threads.size() + 1;
+    const quint32 generation = m_generation.load(std::memory_order_relaxed) + 1;
+    m_function.store(function, std::memory_order_relaxed);
+    m_context.store(context, std::memory_order_relaxed);
+    m_remaining.store(count, std::memory_order_relaxed);
+    for (int i = 0; i < participants; ++i) {
+        const quint64 begin = quint64(count) * quint64(i) / quint64(participants);
+        const quint64 end = quint64(count) * quint64(i + 1) / quint64(participants);
+        m_ranges[i].state.store((quint64(generation) << 32) | (end << 16) | begin,
+                                std::memory_order_release);
+    }
+    m_generation.store(generation, std::memory_order_seq_cst);
+    const int sleeping = m_sleeping.exchange(0, std::memory_order_seq_cst);
+    if (sleeping > 0) {
+        m_wake.release(sleeping);
+    }
+
+    participate(0, generation);
+    // Ждем задачи, которые еще выполняют рабочие потоки
+    while (m_remaining.load(std::memory_order_acquire) > 0) {
+        RENDERPOOL_PAUSE();
+    }
+}
+
+// Захват следующей задачи диапазона, если он принадлежит той же порции
+bool RenderPool::takeTask(Range &range, quint32 generation, int *task)
+{
+    quint64 state = range.state.load(std::memory_order_acquire);
+    for (;;) {
+        const int next = int(state & 0xffff);
+        const int end = int((state >> 16) & 0xffff);
+        if (quint32(state >> 32) != generation || next >= end) {
+            return false;
+        }
+        if (range.state.compare_exchange_weak(state, state + 1, std::memory_order_acq_rel)) {
+            *task = next;
+            return true;
+        }
+    }
+}
+
+// Свой диапазон, затем чужие по кругу
+void RenderPool::participate(int index, quint32 generation)
+{
+    const int participants = m_threads.size() + 1;
+    for (int i = 0; i < participants; ++i) {
+        Range &range = m_ranges[(index + i) % participants];
+        int task = 0;
+        while (takeTask(range, generation, &task)) {
+            // Порция не может смениться, пока захваченная задача не выполнена
+            m_function.load(std::memory_order_relaxed)(m_context.load(std::memory_order_relaxed), task);
+            m_remaining.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+}
+
+void RenderPool::workerLoop(int index)
+{
+    quint32 seen = m_generation.load(std::memory_order_acquire);
+    while (!m_stopRequested.load(std::memory_order_relaxed)) {
+        quint32 generation = m_generation.load(std::memory_order_acquire);
+        for (int i = 0; i < spinChecks && generation == seen; ++i) {
+            RENDERPOOL_PAUSE();
+            generation = m_generation.load(std::memory_order_acquire);
+        }
+        if (generation == seen) {
+            // Лишнее пробуждение безвредно: поток проверит номер порции и уснет снова
+            m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+            if (m_generation.load(std::memory_order_seq_cst) == seen
+                && !m_stopRequested.load(std::memory_order_seq_cst)) {
+                m_wake.acquire();
+            }
+            continue;
+        }
+        seen = generation;
+        participate(index, generation);
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef RENDERPOOL_H
+#define RENDERPOOL_H
+
+#include <atomic>
+#include <QSemaphore>
+#include <QThread>
+#include <QVector>
+
+class RenderPool;
+
+// Рабочий поток пула: ждет очередную порцию задач, крадет задачи у соседей
+class RenderWorker : public QThread
+{
+    Q_OBJECT
+
+public:
+    RenderWorker(RenderPool *pool, int index);
+
+protected:
+    void run() override;
+
+private:
+    RenderPool *m_pool;
+    int m_index; // Номер участника (0 - вызывающий поток)
+};
+
+// Небольшой пул потоков для параллельной генерации голосов. Задачи 0..count-1
+// делятся на непрерывные диапазоны по участникам, закончивший свой диапазон
+// участник забирает задачи из чужих (кража работы). Вызывающий поток - участник 0,
+// run() возвращается, когда выполнены все задачи. Рабочие потоки закреплены
+// за ядрами и между порциями недолго ждут активно, затем засыпают
+class RenderPool
+{
+public:
+    // Функция задачи: контекст, номер задачи
+    typedef void (*TaskFunction)(void *context, int task);
+
+    // Наибольшее число рабочих потоков (кроме вызывающего)
+    static const int MaxWorkers = 7;
+    // Наибольшее число задач в порции
+    static const int MaxTasks = 0xffff;
+
+    // workers < 0 - по числу ядер (в любом случае не больше свободных ядер)
+    explicit RenderPool(int workers = -1);
+    ~RenderPool();
+
+    int workers() const;
+    void run(TaskFunction function, void *context, int count);
+
+private:
+    friend class RenderWorker;
+
+    // Диапазон задач участника одним словом: номер порции (старшие 32 бита),
+    // конец диапазона и следующая задача (по 16 бит). Опоздавший поток
+    // не заберет задачу чужой порции: номер не совпадет
+    struct Range
+    {
+        std::atomic<quint64> state;
+        char pad[64 - sizeof(std::atomic<quint64>)]; // Диапазоны в разных кэш-линиях
+    };
+
+    void participate(int index, quint32 generation);
+    bool takeTask(Range &range, quint32 generation, int *task);
+    void workerLoop(int index);
+
+    QVector<RenderWorker *> m_threads;
+    Range m_ranges[MaxWorkers + 1];
+    std::atomic<TaskFunction> m_function;
+    std::atomic<void *> m_context;
+    std::atomic<quint32> m_generation; // Номер текущей порции
+    char m_generationPad[64 - sizeof(std::atomic<quint32>)];
+    std::atomic<int> m_remaining; // Невыполненные задачи порции
+    char m_remainingPad[64 - sizeof(std::atomic<int>)];
+    std::atomic<int> m_sleeping; // Уснувшие рабочие потоки
+    QSemaphore m_wake;
+    std::atomic<bool> m_stopRequested;
+};
+
+#endif // RENDERPOOL_H
@@ -0,0 +1,240 @@
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <QtGlobal>
+#if defined(Q_OS_UNIX) && !defined(Q_OS_WASM)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#define RENDERTHREAD_POSIX 1
+#endif
+#if defined(Q_OS_LINUX)
+#include <time.h>
+#endif
+#include "renderthread.h"
+
+namespace {
+// Емкость кольцевого буфера: 2^20 байт - больше 200 мс при 96 кГц, 8 каналах и float
+const int ringBits = 20;
+// Заполнение до первых запросов устройства, в блоках
+const int initialBlocks = 4;
+// Окно, за которое запас подстраивается под наибольший запрос устройства
+const qint64 fillWindowNs = 1000000000;
+// Наибольшее ожидание читателя: поток проверяет остановку и запас и без пробуждения
+const long waitNs = 10000000;
+// Без семафора (не Linux) поток опрашивает буфер по таймеру
+const unsigned long pollUs = 1000;
+} // namespace
+
+RenderStream::RenderStream(RenderThread *thread)
+    : QIODevice()
+    , m_thread(thread)
+{}
+
+qint64 RenderStream::readData(char *data, qint64 maxlen)
+{
+    return m_thread->readRendered(data, maxlen);
+}
+
+qint64 RenderStream::writeData(const char *data, qint64 len)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(len);
+    return 0;
+}
+
+qint64 RenderStream::size() const
+{
+    return std::numeric_limits<qint64>::max();
+}
+
+qint64 RenderStream::bytesAvailable() const
+{
+    return std::numeric_limits<qint64>::max();
+}
+
+RenderThread::RenderThread(ToneSynthesizer *synth, QObject *parent)
+    : QThread(parent)
+    , m_synth(synth)
+    , m_stream(this)
+    , m_ring(ringBits)
+    , m_staging(size_t(m_ring.capacity()))
+    , m_wakePending(false)
+    , m_stopRequested(false)
+    , m_fillTarget(0)
+    , m_windowMax(0)
+    , m_windowStartNs(0)
+    , m_realtime(false)
+    , m_memoryLocked(false)
+{
+#if defined(Q_OS_LINUX)
+    sem_init(&m_wake, 0, 0);
+#endif
+}
+
+RenderThread::~RenderThread()
+{
+    stopRendering();
+#if defined(Q_OS_LINUX)
+    sem_destroy(&m_wake);
+#endif
+}
+
+QIODevice *RenderThread::stream()
+{
+    return &m_stream;
+}
+
+bool RenderThread::isRealtime() const
+{
+    return m_realtime.load(std::memory_order_relaxed);
+}
+
+bool RenderThread::isMemoryLocked() const
+{
+    return m_memoryLocked.load(std::memory_order_relaxed);
+}
+
+void RenderThread::startRendering()
+{
+    m_ring.clear();
+    m_fillTarget.store(qint64(ToneSynthesizer::BlockFrames) * m_synth->frameBytes() * initialBlocks,
+                       std::memory_order_relaxed);
+    m_windowMax = 0;
+    m_windowStartNs = ToneSynthesizer::monotonicNs();
+    m_stopRequested.store(false, std::memory_order_relaxed);
+    lockMemory();
+    m_stream.open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    start(QThread::TimeCriticalPriority);
+}
+
+void RenderThread::stopRendering()
+{
+    m_stopRequested.store(true, std::memory_order_relaxed);
+#if defined(Q_OS_LINUX)
+    sem_post(&m_wake);
+#endif
+    wait();
+    if (m_stream.isOpen()) {
+        m_stream.close();
+    }
+#if defined(Q_OS_LINUX)
+    while (sem_trywait(&m_wake) == 0) {
+    }
+#endif
+    m_wakePending.store(false, std::memory_order_relaxed);
+}
+
+// Пробуждение потока из обратного вызова устройства без блокировок: флаг
+// пропускает повторные пробуждения до того, как поток примет первое, а
+// sem_post - атомарное увеличение счетчика и вызов futex, только если поток
+// ждет. Мьютекса, на котором мог бы застрять поток SCHED_FIFO, нет
+void RenderThread::wake()
+{
+    if (!m_wakePending.exchange(true, std::memory_order_acq_rel)) {
+#if defined(Q_OS_LINUX)
+        sem_post(&m_wake);
+#endif
+    }
+}
+
+// Ожидание чтения (не дольше waitNs). Флаг сбрасывается до проверки запаса:
+// чтение после сброса снова разбудит поток
+void RenderThread::waitForReader()
+{
+#if defined(Q_OS_LINUX)
+    timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += waitNs;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_nsec -= 1000000000;
+        ++deadline.tv_sec;
+    }
+    while (sem_timedwait(&m_wake, &deadline) != 0 && errno == EINTR) {
+    }
+#else
+    QThread::usleep(pollUs);
+#endif
+    m_wakePending.store(false, std::memory_order_release);
+}
+
+// Закрепление в ОЗУ всего, к чему обращается генерация: страничный сбой
+// в потоке реального времени стоит дороже целого блока
+void RenderThread::lockMemory()
+{
+#if defined(RENDERTHREAD_POSIX)
+    const Wavetable &tables = Wavetable::instance();
+    bool locked = mlock(m_ring.data(), size_t(m_ring.capacity())) == 0;
+    locked = mlock(m_staging.data(), m_staging.size()) == 0 && locked;
+    locked = mlock(m_synth, sizeof(ToneSynthesizer)) == 0 && locked;
+    locked = mlock(tables.storage(), tables.storageBytes()) == 0 && locked;
+    m_memoryLocked.store(locked, std::memory_order_relaxed);
+#endif
+}
+
+// Цикл генерации: после каждого чтения буфер дополняется до целевого запаса
+// одним вызовом render(), чтобы привязка времени к сэмплам покрывала весь
+// интервал до следующего запроса (см. ToneSynthesizer::frameAtTime())
+void RenderThread::run()
+{
+#if defined(RENDERTHREAD_POSIX)
+    sched_param param;
+    std::memset(&param, 0, sizeof(param));
+    const int minPriority = sched_get_priority_min(SCHED_FIFO);
+    const int maxPriority = sched_get_priority_max(SCHED_FIFO);
+    param.sched_priority = minPriority + (maxPriority - minPriority) / 2;
+    m_realtime.store(pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0,
+                     std::memory_order_relaxed);
+#endif
+    const qint64 frameBytes = m_synth->frameBytes();
+    const qint64 blockBytes = ToneSynthesizer::BlockFrames * frameBytes;
+    while (!m_stopRequested.load(std::memory_order_relaxed)) {
+        const qint64 deficit = m_fillTarget.load(std::memory_order_relaxed) - m_ring.readable();
+        if (deficit > 0) {
+            // Целое число блоков, в пределах свободного места
+            const qint64 bytes = qMin((deficit + blockBytes - 1) / blockBytes * blockBytes,
+                                      m_ring.capacity() - m_ring.readable());
+            const qint64 rendered = m_synth->render(m_staging.data(), bytes / frameBytes);
+            m_ring.write(m_staging.data(), rendered);
+        }
+        waitForReader();
+    }
+}
+
+// Чтение для устройства: копирование из буфера и подстройка запаса
+qint64 RenderThread::readRendered(char *data, qint64 maxlen)
+{
+    const qint64 startNs = ToneSynthesizer::monotonicNs();
+    AudioTelemetry &telemetry = m_synth->telemetry();
+    telemetry.callbackStarted(startNs, maxlen);
+    const qint64 frameBytes = m_synth->frameBytes();
+    const qint64 blockBytes = ToneSynthesizer::BlockFrames * frameBytes;
+    const qint64 request = m_synth->outputRequest(maxlen);
+    qint64 length = m_ring.read(data, request);
+    const qint64 minimum = qMin(blockBytes, request);
+    if (length < minimum) {
+        // Поток генерации не успел: недостающее заполняется тишиной
+        std::memset(data + length, 0, size_t(minimum - length));
+        telemetry.reportUnderrun((minimum - length) / frameBytes);
+        length = minimum;
+    }
+
+    // Запас - наибольший запрос устройства за последнюю секунду. Рост сразу,
+    // уменьшение - по окончании окна, чтобы разовый большой запрос при запуске
+    // не добавил задержку навсегда
+    const qint64 wanted = qMin((request + blockBytes - 1) / blockBytes * blockBytes,
+                               m_ring.capacity() - blockBytes);
+    m_windowMax = qMax(m_windowMax, wanted);
+    if (wanted > m_fillTarget.load(std::memory_order_relaxed)) {
+        m_fillTarget.store(wanted, std::memory_order_relaxed);
+    }
+    if (startNs - m_windowStartNs >= fillWindowNs) {
+        m_fillTarget.store(qMax(m_windowMax, blockBytes * initialBlocks), std::memory_order_relaxed);
+        m_windowMax = 0;
+        m_windowStartNs = startNs;
+    }
+    wake();
+    telemetry.callbackFinished(length / frameBytes,
+                               length / frameBytes * 1000000000ll / m_synth->format().sampleRate());
+    return length;
+}
@@ -0,0 +1,82 @@
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include <atomic>
+#include <vector>
+#include <QIODevice>
+#include <QThread>
+#if defined(Q_OS_LINUX)
+#include <semaphore.h>
+#endif
+#include "ringbuffer.h" // Кольцевой буфер между потоками
+#include "tonesynth.h" // Синтезатор
+
+class RenderThread;
+
+// Источник данных для QAudioSink/QAudioOutput: только копирует готовые данные
+// из кольцевого буфера потока генерации, сам ничего не вычисляет
+class RenderStream : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit RenderStream(RenderThread *thread);
+
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+    qint64 size() const override;
+    qint64 bytesAvailable() const override;
+
+private:
+    RenderThread *m_thread;
+};
+
+// Поток генерации звука. Работает с приоритетом реального времени (SCHED_FIFO,
+// если система разрешает), память синтезатора, таблиц и буфера закреплена в ОЗУ.
+// Поток держит кольцевой буфер заполненным на один запрос устройства вперед,
+// поэтому занятость потока GUI (диалоги, перерисовка) не прерывает звук
+class RenderThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit RenderThread(ToneSynthesizer *synth, QObject *parent = nullptr);
+    ~RenderThread() override;
+
+    // Запуск и остановка потока (формат синтезатора
+    // можно менять только между ними)
+    void startRendering();
+    void stopRendering();
+    QIODevice *stream();
+
+    // Получен ли приоритет реального времени и закреплена ли память
+    bool isRealtime() const;
+    bool isMemoryLocked() const;
+
+protected:
+    void run() override;
+
+private:
+    friend class RenderStream;
+    qint64 readRendered(char *data, qint64 maxlen);
+    void lockMemory();
+    void wake();
+    void waitForReader();
+
+    ToneSynthesizer *m_synth;
+    RenderStream m_stream;
+    RingBuffer m_ring;
+    std::vector<char> m_staging; // Данные одного дополнения буфера
+#if defined(Q_OS_LINUX)
+    sem_t m_wake; // Читатель будит поток после каждого чтения
+#endif
+    std::atomic<bool> m_wakePending; // Пробуждение заказано, поток его еще не принял
+    std::atomic<bool> m_stopRequested;
+    std::atomic<qint64> m_fillTarget; // Сколько байт держать готовыми
+    qint64 m_windowMax; // Наибольший запрос в текущем окне (сторона читателя)
+    qint64 m_windowStartNs;
+    std::atomic<bool> m_realtime;
+    std::atomic<bool> m_memoryLocked;
+};
+
+#endif // RENDERTHREAD_H
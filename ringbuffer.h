@@ -0,0 +1,99 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+#include <QtGlobal>
+
+// Кольцевой буфер байтов без блокировок для одного писателя (поток генерации)
+// и одного читателя (обратный вызов устройства). Емкость - степень двойки,
+// счетчики 64-битные и не переполняются
+class RingBuffer
+{
+public:
+    explicit RingBuffer(int capacityBits)
+        : m_data(size_t(1) << capacityBits)
+        , m_mask((quint64(1) << capacityBits) - 1)
+        , m_head(0)
+        , m_tail(0)
+    {}
+
+    qint64 capacity() const { return qint64(m_data.size()); }
+    const char *data() const { return m_data.data(); }
+
+    // Готовые к чтению байты (точно для читателя, оценка снизу для писателя)
+    qint64 readable() const
+    {
+        return qint64(m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire));
+    }
+
+    // Запись до bytes байт (только писатель), возвращает записанное количество
+    qint64 write(const char *data, qint64 bytes)
+    {
+        const quint64 head = m_head.load(std::memory_order_relaxed);
+        const quint64 free = quint64(capacity()) - (head - m_tail.load(std::memory_order_acquire));
+        const quint64 count = std::min<quint64>(quint64(bytes), free);
+        const quint64 offset = head & m_mask;
+        const quint64 first = std::min<quint64>(count, quint64(capacity()) - offset);
+        std::memcpy(&m_data[offset], data, first);
+        std::memcpy(&m_data[0], data + first, count - first);
+        m_head.store(head + count, std::memory_order_release);
+        return qint64(count);
+    }
+
+    // Чтение до bytes байт (только читатель), возвращает прочитанное количество
+    qint64 read(char *data, qint64 bytes)
+    {
+        const quint64 tail = m_tail.load(std::memory_order_relaxed);
+        const quint64 ready = m_head.load(std::memory_order_acquire) - tail;
+        const quint64 count = std::min<quint64>(quint64(bytes), ready);
+        const quint64 offset = tail & m_mask;
+        const quint64 first = std::min<quint64>(count, quint64(capacity()) - offset);
+        std::memcpy(data, &m_data[offset], first);
+        std::memcpy(data + first, &m_data[0], count - first);
+        m_tail.store(tail + count, std::memory_order_release);
+        return qint64(count);
+    }
+
+    // Чтение без копирования (только читатель): непрерывный участок готовых
+    // данных от позиции чтения, до конца памяти буфера. Освобождается consume()
+    qint64 peek(const char **data) const
+    {
+        const quint64 tail = m_tail.load(std::memory_order_relaxed);
+        const quint64 ready = m_head.load(std::memory_order_acquire) - tail;
+        const quint64 offset = tail & m_mask;
+        *data = &m_data[offset];
+        return qint64(std::min<quint64>(ready, quint64(capacity()) - offset));
+    }
+
+    void consume(qint64 bytes)
+    {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + quint64(bytes), std::memory_order_release);
+    }
+
+    // Свободное место (точно для писателя)
+    qint64 writable() const
+    {
+        return capacity() - qint64(m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_acquire));
+    }
+
+    // Очистка (только когда ни писатель, ни читатель не работают)
+    void clear()
+    {
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::vector<char> m_data;
+    const quint64 m_mask;
+    // Индексы разнесены по разным кэш-линиям, как в SpscQueue
+    std::atomic<quint64> m_head; // Позиция записи
+    char m_headPad[64 - sizeof(std::atomic<quint64>)];
+    std::atomic<quint64> m_tail; // Позиция чтения
+    char m_tailPad[64 - sizeof(std::atomic<quint64>)];
+};
+
+#endif // RINGBUFFER_H
@@ -0,0 +1,222 @@
+#include <cstring>
+#include "samplestream.h"
+
+namespace {
+// Пауза потока подкачки, когда все кольца полны. Кусок длится десятки
+// миллисекунд даже при транспозиции вверх, поэтому опроса хватает
+const unsigned long idleMs = 2;
+} // namespace
+
+SampleStreamer::SampleStreamer(QObject *parent)
+    : QThread(parent)
+    , m_stopRequested(false)
+    , m_waitForData(false)
+    , m_underruns(0)
+{
+    for (Stream &stream : m_streams) {
+        stream.zone.store(nullptr, std::memory_order_relaxed);
+        stream.generation.store(0, std::memory_order_relaxed);
+        stream.written.store(0, std::memory_order_relaxed);
+        stream.read.store(0, std::memory_order_relaxed);
+        stream.servedGeneration = 0;
+        stream.servedZone = nullptr;
+        stream.nextChunk = 0;
+        stream.playingZone = nullptr;
+        stream.playingGeneration = 0;
+    }
+}
+
+SampleStreamer::~SampleStreamer()
+{
+    stopStreaming();
+}
+
+void SampleStreamer::startStreaming()
+{
+    stopStreaming();
+    m_stopRequested.store(false, std::memory_order_relaxed);
+    // Выше обычных потоков: опоздание подкачки слышно так же, как опоздание звука
+    start(QThread::HighPriority);
+}
+
+void SampleStreamer::stopStreaming()
+{
+    if (!isRunning()) {
+        return;
+    }
+    m_stopRequested.store(true, std::memory_order_release);
+    wait();
+}
+
+void SampleStreamer::setWaitForData(bool wait)
+{
+    m_waitForData.store(wait, std::memory_order_relaxed);
+}
+
+void SampleStreamer::restart(int index, const SampleZone *zone)
+{
+    Stream &stream = m_streams[index];
+    stream.playingZone = zone;
+    ++stream.playingGeneration;
+    stream.zone.store(zone, std::memory_order_relaxed);
+    stream.generation.store(stream.playingGeneration, std::memory_order_release);
+    skipStale(stream, 0);
+}
+
+void SampleStreamer::release(int index)
+{
+    restart(index, nullptr);
+}
+
+const float *SampleStreamer::gather(int index, qint64 first, int count)
+{
+    Stream &stream = m_streams[index];
+    const SampleZone &zone = *stream.playingZone;
+    float *out = stream.gathered;
+
+    // Начало сэмпла - из памяти зоны
+    const qint64 last = first + count;
+    const qint64 resident = zone.isResident() ? last : qMin(last, qint64(zone.preloadFrames));
+    int done = 0;
+    if (resident > first) {
+        done = int(resident - first);
+        unroll(zone, zone.preload, first, done, out);
+    }
+
+    // Продолжение - из кусков кольца
+    bool late = false;
+    quint32 read = stream.read.load(std::memory_order_relaxed);
+    quint32 written = stream.written.load(std::memory_order_acquire);
+    while (done < count) {
+        const qint64 offset = first + done - zone.preloadFrames;
+        const quint32 chunk = quint32(offset / ChunkFrames);
+        const int inChunk = int(offset % ChunkFrames);
+        const int run = qMin(count - done, ChunkFrames - inChunk);
+        const float *data = nullptr;
+        for (quint32 i = read; i != written; ++i) {
+            const int slot = int(i % Chunks);
+            if (stream.chunkGeneration[slot] == stream.playingGeneration && stream.chunkIndex[slot] == chunk) {
+                data = stream.chunks[slot];
+                break;
+            }
+        }
+        if (!data && m_waitForData.load(std::memory_order_relaxed) && isRunning()
+            && !zone.isFinished(quint64(first + done))) {
+            // Без устройства опоздания нет: ждем кусок и освобождаем место для него
+            skipStale(stream, first);
+            QThread::yieldCurrentThread();
+            read = stream.read.load(std::memory_order_relaxed);
+            written = stream.written.load(std::memory_order_acquire);
+            continue;
+        }
+        if (data) {
+            std::memcpy(out + done, data + inChunk, size_t(run) * sizeof(float));
+        } else {
+            std::memset(out + done, 0, size_t(run) * sizeof(float));
+            late = late || !zone.isFinished(quint64(first + done));
+        }
+        done += run;
+    }
+    if (late) {
+        m_underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    return out;
+}
+
+void SampleStreamer::consume(int index, qint64 position)
+{
+    skipStale(m_streams[index], position);
+}
+
+quint64 SampleStreamer::underruns() const
+{
+    return m_underruns.load(std::memory_order_relaxed);
+}
+
+void SampleStreamer::unroll(const SampleZone &zone, const float *data, qint64 start, int count, float *out)
+{
+    int done = 0;
+    while (done < count && start + done < 0) {
+        out[done++] = 0.0f;
+    }
+    const quint64 end = (zone.loopEnd != 0) ? zone.loopEnd : zone.frames;
+    while (done < count) {
+        const quint64 source = zone.sourceFrame(quint64(start + done));
+        if (source >= end) {
+            std::memset(out + done, 0, size_t(count - done) * sizeof(float));
+            break;
+        }
+        const int run = int(qMin(end - source, quint64(count - done)));
+        std::memcpy(out + done, data + source, size_t(run) * sizeof(float));
+        done += run;
+    }
+}
+
+// Освобождение кусков прежних нот и кусков, которые воспроизведение прошло.
+// Поколения в кольце идут по возрастанию, поэтому проход останавливается
+// на первом нужном куске
+void SampleStreamer::skipStale(Stream &stream, qint64 position)
+{
+    quint32 read = stream.read.load(std::memory_order_relaxed);
+    const quint32 written = stream.written.load(std::memory_order_acquire);
+    while (read != written) {
+        const int slot = int(read % Chunks);
+        if (stream.chunkGeneration[slot] == stream.playingGeneration && stream.playingZone) {
+            const qint64 end = qint64(stream.playingZone->preloadFrames)
+                               + (qint64(stream.chunkIndex[slot]) + 1) * ChunkFrames;
+            if (end > position) {
+                break;
+            }
+        }
+        ++read;
+    }
+    stream.read.store(read, std::memory_order_release);
+}
+
+// Дозапись кольца (поток подкачки). Смена поколения прерывает дозапись:
+// следующий проход начнет новую ноту с первого куска
+bool SampleStreamer::fill(Stream &stream)
+{
+    const quint32 generation = stream.generation.load(std::memory_order_acquire);
+    if (generation != stream.servedGeneration) {
+        stream.servedGeneration = generation;
+        stream.servedZone = stream.zone.load(std::memory_order_relaxed);
+        stream.nextChunk = 0;
+    }
+    const SampleZone *zone = stream.servedZone;
+    if (!zone || zone->isResident()) {
+        return false;
+    }
+
+    bool filled = false;
+    quint32 written = stream.written.load(std::memory_order_relaxed);
+    while (written - stream.read.load(std::memory_order_acquire) < quint32(Chunks)) {
+        const qint64 start = qint64(zone->preloadFrames) + qint64(stream.nextChunk) * ChunkFrames;
+        if (zone->isFinished(quint64(start))) {
+            break;
+        }
+        const int slot = int(written % Chunks);
+        unroll(*zone, zone->source, start, ChunkFrames, stream.chunks[slot]);
+        stream.chunkGeneration[slot] = generation;
+        stream.chunkIndex[slot] = stream.nextChunk++;
+        stream.written.store(++written, std::memory_order_release);
+        filled = true;
+        if (stream.generation.load(std::memory_order_relaxed) != generation) {
+            break;
+        }
+    }
+    return filled;
+}
+
+void SampleStreamer::run()
+{
+    while (!m_stopRequested.load(std::memory_order_acquire)) {
+        bool busy = false;
+        for (Stream &stream : m_streams) {
+            busy = fill(stream) || busy;
+        }
+        if (!busy) {
+            QThread::msleep(idleMs);
+        }
+    }
+}
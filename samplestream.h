@@ -0,0 +1,125 @@
+#ifndef SAMPLESTREAM_H
+#define SAMPLESTREAM_H
+
+#include <atomic>
+#include <QThread>
+#include <QtGlobal>
+
+// Зона сэмплера: сэмпл банка для диапазона нот и громкостей нажатия. Начало
+// сэмпла (до SampleStreamer::PreloadFrames кадров) скопировано в память при
+// загрузке набора, остальное поток подкачки читает из отображения банка.
+// Позиция воспроизведения считается с развернутой петлей: после конца петли
+// она продолжает расти, а кадр сэмпла находит sourceFrame()
+struct SampleZone
+{
+    const float *preload; // Начало сэмпла в памяти
+    quint32 preloadFrames;
+    const float *source; // Весь сэмпл в отображении банка (только поток подкачки)
+    quint32 frames;
+    quint32 loopStart;
+    quint32 loopEnd; // 0 - без петли
+    int sampleRate;
+    int rootNote;
+    int lowNote, highNote;
+    int lowVelocity, highVelocity; // 1..127
+
+    // Воспроизведение целиком из памяти, без подкачки
+    bool isResident() const
+    {
+        return frames <= preloadFrames || (loopEnd != 0 && loopEnd <= preloadFrames);
+    }
+    quint64 sourceFrame(quint64 position) const
+    {
+        if (loopEnd == 0 || position < loopEnd) {
+            return position;
+        }
+        return loopStart + (position - loopStart) % (loopEnd - loopStart);
+    }
+    // Звучит бесконечно (петля) или кончается на frames
+    bool isFinished(quint64 position) const { return loopEnd == 0 && position >= frames; }
+};
+
+// Подкачка сэмплов для голосов сэмплера. У каждого голоса свой поток - кольцо
+// из Chunks кусков по ChunkFrames кадров с одним писателем (поток подкачки)
+// и одним читателем (поток звука), все кольца выделены заранее. Поток звука
+// не касается файла: начало сэмпла берется из памяти зоны, продолжение -
+// из готовых кусков, а не успевший кусок звучит тишиной и учитывается
+// в underruns(). Поток подкачки опрашивает кольца и копирует кадры
+// из отображения банка: чтение с диска происходит в нем
+class SampleStreamer : public QThread
+{
+    Q_OBJECT
+
+public:
+    static const int Streams = 64;
+    static const int Chunks = 4;
+    static const int ChunkFrames = 4096;
+    // Начало сэмпла в памяти: его хватает, пока подкачка готовит первые куски
+    static const int PreloadFrames = 16384;
+    // Наибольшее число кадров одного gather()
+    static const int GatherFrames = 2048;
+
+    explicit SampleStreamer(QObject *parent = nullptr);
+    ~SampleStreamer() override;
+
+    void startStreaming();
+    void stopStreaming();
+    // Генерация без устройства: gather() ждет недостающих кусков, а не отдает тишину
+    void setWaitForData(bool wait);
+
+    // Поток звука. Новая нота голоса stream: прежние куски отбрасываются
+    void restart(int stream, const SampleZone *zone);
+    // Голос освободился: подкачка для него прекращается
+    void release(int stream);
+    // Кадры позиций [first, first + count) (first может быть -1) во внутренний
+    // буфер потока, count <= GatherFrames. Позиции до начала и после конца
+    // сэмпла - нули
+    const float *gather(int stream, qint64 first, int count);
+    // Куски, целиком лежащие до позиции position, больше не нужны
+    void consume(int stream, qint64 position);
+
+    // Куски, не готовые к моменту воспроизведения
+    quint64 underruns() const;
+
+    // Кадры позиций [start, start + count) из data с развернутой петлей (после
+    // конца сэмпла - нули). Общая часть подкачки и чтения из памяти
+    static void unroll(const SampleZone &zone, const float *data, qint64 start, int count, float *out);
+
+protected:
+    void run() override;
+
+private:
+    struct Stream
+    {
+        // Запрос потока звука: зона публикуется сменой поколения
+        std::atomic<const SampleZone *> zone;
+        std::atomic<quint32> generation;
+        char pad[64 - sizeof(std::atomic<quint32>) - sizeof(std::atomic<const SampleZone *>)];
+        std::atomic<quint32> written; // Записанные куски (поток подкачки)
+        char writtenPad[64 - sizeof(std::atomic<quint32>)];
+        std::atomic<quint32> read; // Освобожденные куски (поток звука)
+        char readPad[64 - sizeof(std::atomic<quint32>)];
+        // Поколение и номер каждого куска (номер 0 начинается после начала в памяти)
+        quint32 chunkGeneration[Chunks];
+        quint32 chunkIndex[Chunks];
+        // Состояние потока подкачки
+        quint32 servedGeneration;
+        const SampleZone *servedZone;
+        quint32 nextChunk;
+        // Состояние потока звука
+        const SampleZone *playingZone;
+        quint32 playingGeneration;
+        float chunks[Chunks][ChunkFrames];
+        float gathered[GatherFrames];
+    };
+
+    bool fill(Stream &stream);
+    void skipStale(Stream &stream, qint64 position);
+
+    Stream m_streams[Streams];
+    std::atomic<bool> m_stopRequested;
+    std::atomic<bool> m_waitForData;
+    std::atomic<quint64> m_underruns;
+};
+
+#endif // SAMPLESTREAM_H
@@ -0,0 +1,148 @@
+#include <csignal>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QTimer>
+
+#include "controlsocket.h" // Управление через сокет
+#include "sharedaudio.h" // Вывод в разделяемую память
+#include "tonesynth.h" // Синтезатор
+
+namespace {
+volatile std::sig_atomic_t stopSignal = 0;
+
+void requestStop(int)
+{
+    stopSignal = 1;
+}
+} // namespace
+
+// Экземпляр синтезатора без GUI и звуковой карты: события приходят через
+// локальный сокет, звук - в кольцевой буфер разделяемой памяти, который
+// читает смеситель (minisynth-mixer) или проверка. Несколько экземпляров
+// на одной машине выводятся через одно устройство
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("minisynth-server");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless synthesizer instance: Unix socket control, shared-memory output");
+    parser.addHelpOption();
+    QCommandLineOption nameOption({"n", "name"}, "Shared memory name of the output ring.", "name", "minisynth");
+    QCommandLineOption socketOption("socket", "Control socket path (default /tmp/<name>.sock).", "path");
+    QCommandLineOption rateOption({"r", "rate"}, "Sample rate in Hz.", "hz", "48000");
+    QCommandLineOption channelsOption("channels", "Output channels.", "n", "2");
+    QCommandLineOption latencyOption("latency", "Audio kept rendered ahead of the reader.", "ms", "20");
+    QCommandLineOption threadsOption({"j", "threads"}, "Voice rendering threads (1 = serial).", "n", "1");
+    QCommandLineOption effectsOption("fx", "Effect chain of the built-in program (see minisynth-render).", "chain");
+    QCommandLineOption patchesOption("patches", "Patch file with programs (and their sound bank).", "file");
+    QCommandLineOption programOption("program", "Initial program number from --patches.", "n");
+    QCommandLineOption statsOption("stats", "Print CPU use every N seconds (0 = never).", "seconds", "0");
+    parser.addOptions({nameOption,
+                       socketOption,
+                       rateOption,
+                       channelsOption,
+                       latencyOption,
+                       threadsOption,
+                       effectsOption,
+                       patchesOption,
+                       programOption,
+                       statsOption});
+    parser.process(app);
+
+    QTextStream err(stderr);
+    const QString name = parser.value(nameOption);
+    const QString socketPath = parser.isSet(socketOption) ? parser.value(socketOption)
+                                                          : QString("/tmp/%1.sock").arg(name);
+    const int sampleRate = parser.value(rateOption).toInt();
+    const int channels = parser.value(channelsOption).toInt();
+    const qreal latencyMs = parser.value(latencyOption).toDouble();
+    const int threads = parser.value(threadsOption).toInt();
+    const qreal statsSeconds = parser.value(statsOption).toDouble();
+    if (name.isEmpty() || sampleRate <= 0 || channels < 1 || channels > ToneSynthesizer::MaxChannels
+        || latencyMs <= 0.0 || threads < 1 || statsSeconds < 0.0) {
+        err << "invalid option" << Qt::endl;
+        return 1;
+    }
+
+    QString error;
+    PatchBank patches;
+    if (parser.isSet(patchesOption) && !patches.load(parser.value(patchesOption), &error)) {
+        err << error << Qt::endl;
+        return 1;
+    }
+    const int program = parser.isSet(programOption) ? parser.value(programOption).toInt() : -1;
+    if (program >= patches.count()) {
+        err << "no program " << program << " in the patch file" << Qt::endl;
+        return 1;
+    }
+
+    // Синтезатор пишет float с числом каналов буфера прямо в разделяемую память
+    ToneSynthesizer synth(ToneSynthesizer::makeFormat(sampleRate, channels, RenderKernels::SampleFormat::float32));
+    synth.setRenderThreads(threads);
+    if (!synth.effects().parseChain(parser.value(effectsOption), &error)) {
+        err << error << Qt::endl;
+        return 1;
+    }
+    synth.setPatchBank(&patches);
+    synth.start();
+    if (program >= 0) {
+        synth.selectProgram(program);
+    }
+
+    // Емкость с запасом вчетверо: смеситель может читать крупными запросами
+    const qint64 aheadFrames = qRound64(latencyMs * sampleRate / 1000.0);
+    SharedAudioRing ring;
+    if (!ring.create(name, sampleRate, channels, int(qMax<qint64>(4 * aheadFrames, 4096)), &error)) {
+        err << error << Qt::endl;
+        return 1;
+    }
+    ControlSocket control(&synth);
+    if (!control.open(socketPath, &error)) {
+        err << error << Qt::endl;
+        return 1;
+    }
+    SharedRenderThread renderer(&synth, &ring);
+    renderer.startRendering(aheadFrames);
+    control.startInput();
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    err << "ring " << name << ": " << sampleRate << " Hz, " << channels << " ch, " << latencyMs
+        << " ms ahead" << Qt::endl
+        << "control: " << socketPath << Qt::endl;
+
+    // Сигнал останавливает цикл событий; показатели - доля времени ЦП процесса
+    // от длительности сгенерированного звука
+    QTimer timer;
+    qint64 statsNs = ToneSynthesizer::monotonicNs();
+    qint64 lastCpuNs = 0;
+    quint64 lastFrames = 0;
+    QObject::connect(&timer, &QTimer::timeout, [&] {
+        if (stopSignal) {
+            app.quit();
+            return;
+        }
+        const qint64 nowNs = ToneSynthesizer::monotonicNs();
+        if (statsSeconds <= 0.0 || nowNs - statsNs < qint64(statsSeconds * 1e9)) {
+            return;
+        }
+        const qint64 cpuNs = ring.cpuTimeNs();
+        const quint64 frames = ring.writtenFrames();
+        const qreal audioNs = qreal(frames - lastFrames) * 1e9 / sampleRate;
+        err << "cpu: " << (audioNs > 0.0 ? 100.0 * (cpuNs - lastCpuNs) / audioNs : 0.0) << "% of real time, "
+            << synth.activeVoices() << " voices, " << ring.underrunFrames() << " underrun frames, "
+            << control.badCommands() << " bad commands, " << control.droppedMessages() << " dropped" << Qt::endl;
+        statsNs = nowNs;
+        lastCpuNs = cpuNs;
+        lastFrames = frames;
+    });
+    timer.start(50);
+    app.exec();
+
+    control.stopInput();
+    renderer.stopRendering();
+    synth.stop();
+    return 0;
+}
@@ -0,0 +1,480 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "sharedaudio.h"
+
+namespace {
+// "MSRB": объект разделяемой памяти создан синтезатором и готов
+const quint32 ringMagic = 0x4252534d;
+const quint32 ringVersion = 1;
+// Опрос позиции читателя, пока запас полон: между процессами нет общего
+// семафора, а 1 мс много меньше запаса экземпляра
+const unsigned long pollUs = 1000;
+
+static_assert(std::atomic<quint64>::is_always_lock_free, "shared counters need lock-free atomics");
+
+// Имя объекта POSIX начинается с '/'
+QByteArray objectPath(const QString &name)
+{
+    QString path = name;
+    if (!path.startsWith('/')) {
+        path.prepend('/');
+    }
+    return path.toLocal8Bit();
+}
+
+QString systemError()
+{
+    return QString::fromLocal8Bit(std::strerror(errno));
+}
+
+// Попыток занять имя, если его одновременно освобождают и занимают другие
+const int createAttempts = 4;
+
+// Открытие объекта писателем под блокировкой flock, которую писатель держит
+// все время работы (ядро снимает ее и при падении процесса). Блокировка
+// занята - имя у работающего писателя (busy). Объект с данными без блокировки
+// оставлен упавшим писателем: он удаляется, и попытка повторяется с новым.
+// Пустой объект без блокировки только что создан (или брошен до ftruncate):
+// его забирает тот, кто первым взял блокировку
+int openLocked(const QByteArray &path, bool *busy)
+{
+    *busy = false;
+    for (int attempt = 0; attempt < createAttempts; ++attempt) {
+        const int fd = shm_open(path.constData(), O_CREAT | O_RDWR, 0600);
+        if (fd < 0) {
+            return -1;
+        }
+        if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            const int code = errno;
+            ::close(fd);
+            *busy = (code == EWOULDBLOCK);
+            errno = code;
+            return -1;
+        }
+        // Пока блокировка бралась, имя могло перейти к другому объекту
+        struct stat locked;
+        struct stat named;
+        const int check = shm_open(path.constData(), O_RDONLY, 0);
+        const bool current = check >= 0 && fstat(fd, &locked) == 0 && fstat(check, &named) == 0
+                             && locked.st_dev == named.st_dev && locked.st_ino == named.st_ino;
+        if (check >= 0) {
+            ::close(check);
+        }
+        if (current && locked.st_size == 0) {
+            return fd;
+        }
+        if (current) {
+            shm_unlink(path.constData()); // Объект упавшего писателя
+        }
+        ::close(fd);
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+// Время ЦП всех потоков процесса, включая пул параллельной генерации
+qint64 processCpuNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return qint64(ts.tv_sec) * 1000000000ll + ts.tv_nsec;
+}
+
+} // namespace
+
+// Заголовок в начале объекта. Поля формата не меняются после публикации magic,
+// счетчики разнесены по разным кэш-линиям
+struct SharedAudioRing::Header
+{
+    std::atomic<quint32> magic;
+    quint32 version;
+    quint32 sampleRate;
+    quint32 channels;
+    quint64 capacityFrames;
+    qint64 pid;
+    char formatPad[64 - 32];
+    std::atomic<quint64> head; // Опубликовано кадров (писатель)
+    char headPad[64 - sizeof(std::atomic<quint64>)];
+    std::atomic<quint64> tail; // Прочитано кадров (читатель)
+    char tailPad[64 - sizeof(std::atomic<quint64>)];
+    std::atomic<qint64> cpuNs; // Время ЦП процесса-писателя
+    std::atomic<quint64> underruns; // Кадры тишины вместо данных у читателя
+    char statsPad[64 - 2 * sizeof(std::atomic<quint64>)];
+};
+
+SharedAudioRing::SharedAudioRing()
+    : m_header(nullptr)
+    , m_data(nullptr)
+    , m_bytes(0)
+    , m_mask(0)
+    , m_owner(false)
+    , m_lockFd(-1)
+{}
+
+SharedAudioRing::~SharedAudioRing()
+{
+    close();
+}
+
+bool SharedAudioRing::create(const QString &name, int sampleRate, int channels, int capacityFrames, QString *error)
+{
+    close();
+    auto fail = [&](const QString &message) {
+        if (error) {
+            *error = message;
+        }
+        return false;
+    };
+    if (sampleRate <= 0 || channels < 1 || channels > ToneSynthesizer::MaxChannels || capacityFrames <= 0) {
+        return fail("invalid shared ring format");
+    }
+    quint64 capacity = 1;
+    while (capacity < quint64(capacityFrames)) {
+        capacity <<= 1;
+    }
+    const QByteArray path = objectPath(name);
+    bool busy = false;
+    const int fd = openLocked(path, &busy);
+    if (fd < 0) {
+        if (busy) {
+            return fail(QString("shared memory name %1 is in use").arg(name));
+        }
+        return fail(QString("cannot create shared memory %1: %2").arg(name, systemError()));
+    }
+    const size_t bytes = sizeof(Header) + size_t(capacity) * size_t(channels) * sizeof(float);
+    if (ftruncate(fd, off_t(bytes)) != 0) {
+        const QString message = systemError();
+        shm_unlink(path.constData());
+        ::close(fd);
+        return fail(QString("cannot size shared memory %1: %2").arg(name, message));
+    }
+    if (!map(fd, bytes, error)) {
+        shm_unlink(path.constData());
+        ::close(fd);
+        return false;
+    }
+    m_name = name;
+    m_owner = true;
+    m_lockFd = fd; // Блокировка держится до close()
+    m_mask = capacity - 1;
+    // Новый объект заполнен нулями: счетчики и показатели уже нулевые
+    m_header->version = ringVersion;
+    m_header->sampleRate = quint32(sampleRate);
+    m_header->channels = quint32(channels);
+    m_header->capacityFrames = capacity;
+    m_header->pid = qint64(getpid());
+    m_header->magic.store(ringMagic, std::memory_order_release);
+    // Страничный сбой при генерации стоит дороже блока (как в RenderThread)
+    mlock(m_header, m_bytes);
+    return true;
+}
+
+bool SharedAudioRing::attach(const QString &name, QString *error)
+{
+    close();
+    auto fail = [&](const QString &message) {
+        close();
+        if (error) {
+            *error = message;
+        }
+        return false;
+    };
+    const int fd = shm_open(objectPath(name).constData(), O_RDWR, 0);
+    if (fd < 0) {
+        return fail(QString("cannot open shared memory %1: %2").arg(name, systemError()));
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(Header)) {
+        ::close(fd);
+        return fail(QString("%1 is not a synthesizer ring").arg(name));
+    }
+    const bool mapped = map(fd, size_t(info.st_size), error);
+    ::close(fd); // Отображение остается и без дескриптора
+    if (!mapped) {
+        return false;
+    }
+    m_name = name;
+    const quint64 capacity = m_header->capacityFrames;
+    if (m_header->magic.load(std::memory_order_acquire) != ringMagic || m_header->version != ringVersion
+        || capacity == 0 || (capacity & (capacity - 1)) != 0 || m_header->channels < 1
+        || m_header->channels > quint32(ToneSynthesizer::MaxChannels)
+        || m_bytes != sizeof(Header) + size_t(capacity) * m_header->channels * sizeof(float)) {
+        return fail(QString("%1 is not a synthesizer ring (or not ready)").arg(name));
+    }
+    m_mask = capacity - 1;
+    return true;
+}
+
+bool SharedAudioRing::map(int fd, size_t bytes, QString *error)
+{
+    void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    const QString message = systemError();
+    if (memory == MAP_FAILED) {
+        if (error) {
+            *error = QString("cannot map shared memory: %1").arg(message);
+        }
+        return false;
+    }
+    m_header = static_cast<Header *>(memory);
+    m_data = reinterpret_cast<float *>(m_header + 1);
+    m_bytes = bytes;
+    return true;
+}
+
+void SharedAudioRing::close()
+{
+    if (m_header) {
+        munmap(m_header, m_bytes);
+        if (m_owner) {
+            // Имя удаляется до снятия блокировки: новый писатель создаст свой объект
+            shm_unlink(objectPath(m_name).constData());
+            ::close(m_lockFd);
+        }
+    }
+    m_lockFd = -1;
+    m_header = nullptr;
+    m_data = nullptr;
+    m_bytes = 0;
+    m_mask = 0;
+    m_owner = false;
+    m_name.clear();
+}
+
+bool SharedAudioRing::isOpen() const
+{
+    return m_header != nullptr;
+}
+
+QString SharedAudioRing::name() const
+{
+    return m_name;
+}
+
+int SharedAudioRing::sampleRate() const
+{
+    return int(m_header->sampleRate);
+}
+
+int SharedAudioRing::channels() const
+{
+    return int(m_header->channels);
+}
+
+qint64 SharedAudioRing::capacity() const
+{
+    return qint64(m_mask + 1);
+}
+
+qint64 SharedAudioRing::ownerPid() const
+{
+    return m_header->pid;
+}
+
+// Счетчики другого процесса не проверены: заполнение ограничивается емкостью,
+// чтобы испорченный счетчик не вывел за пределы буфера
+float *SharedAudioRing::writeRegion(qint64 *frames)
+{
+    const quint64 capacity = m_mask + 1;
+    const quint64 head = m_header->head.load(std::memory_order_relaxed);
+    const quint64 used = std::min(capacity, head - m_header->tail.load(std::memory_order_acquire));
+    const quint64 offset = head & m_mask;
+    *frames = qint64(std::min(capacity - used, capacity - offset));
+    return m_data + offset * m_header->channels;
+}
+
+void SharedAudioRing::publish(qint64 frames)
+{
+    m_header->head.store(m_header->head.load(std::memory_order_relaxed) + quint64(frames),
+                         std::memory_order_release);
+}
+
+qint64 SharedAudioRing::readable() const
+{
+    const quint64 ready = m_header->head.load(std::memory_order_acquire)
+                          - m_header->tail.load(std::memory_order_acquire);
+    return qint64(std::min(ready, m_mask + 1));
+}
+
+const float *SharedAudioRing::readRegion(qint64 *frames) const
+{
+    const quint64 capacity = m_mask + 1;
+    const quint64 tail = m_header->tail.load(std::memory_order_relaxed);
+    const quint64 ready = std::min(capacity, m_header->head.load(std::memory_order_acquire) - tail);
+    const quint64 offset = tail & m_mask;
+    *frames = qint64(std::min(ready, capacity - offset));
+    return m_data + offset * m_header->channels;
+}
+
+void SharedAudioRing::consume(qint64 frames)
+{
+    m_header->tail.store(m_header->tail.load(std::memory_order_relaxed) + quint64(frames),
+                         std::memory_order_release);
+}
+
+void SharedAudioRing::setCpuTime(qint64 ns)
+{
+    m_header->cpuNs.store(ns, std::memory_order_relaxed);
+}
+
+qint64 SharedAudioRing::cpuTimeNs() const
+{
+    return m_header->cpuNs.load(std::memory_order_relaxed);
+}
+
+quint64 SharedAudioRing::writtenFrames() const
+{
+    return m_header->head.load(std::memory_order_acquire);
+}
+
+void SharedAudioRing::reportUnderrun(qint64 frames)
+{
+    m_header->underruns.fetch_add(quint64(frames), std::memory_order_relaxed);
+}
+
+quint64 SharedAudioRing::underrunFrames() const
+{
+    return m_header->underruns.load(std::memory_order_relaxed);
+}
+
+SharedRenderThread::SharedRenderThread(ToneSynthesizer *synth, SharedAudioRing *ring, QObject *parent)
+    : QThread(parent)
+    , m_synth(synth)
+    , m_ring(ring)
+    , m_aheadFrames(0)
+    , m_stopRequested(false)
+{}
+
+SharedRenderThread::~SharedRenderThread()
+{
+    stopRendering();
+}
+
+void SharedRenderThread::startRendering(qint64 aheadFrames)
+{
+    const qint64 block = ToneSynthesizer::BlockFrames;
+    m_aheadFrames = qMin((qMax<qint64>(aheadFrames, 1) + block - 1) / block * block, m_ring->capacity());
+    m_stopRequested.store(false, std::memory_order_relaxed);
+    start(QThread::TimeCriticalPriority);
+}
+
+void SharedRenderThread::stopRendering()
+{
+    m_stopRequested.store(true, std::memory_order_relaxed);
+    wait();
+}
+
+// Цикл генерации: запас дополняется целыми блоками прямо в разделяемую память.
+// Емкость - степень двойки, поэтому участок до конца памяти тоже кратен блоку
+void SharedRenderThread::run()
+{
+    const qint64 block = ToneSynthesizer::BlockFrames;
+    while (!m_stopRequested.load(std::memory_order_relaxed)) {
+        qint64 frames = 0;
+        float *region = m_ring->writeRegion(&frames);
+        frames = qMin(frames, m_aheadFrames - m_ring->readable()) / block * block;
+        if (frames > 0) {
+            m_synth->render(reinterpret_cast<char *>(region), frames);
+            m_ring->publish(frames);
+            m_ring->setCpuTime(processCpuNs());
+        } else {
+            QThread::usleep(pollUs);
+        }
+    }
+}
+
+SharedAudioMixer::SharedAudioMixer(QObject *parent)
+    : QIODevice(parent)
+{}
+
+bool SharedAudioMixer::addRing(SharedAudioRing *ring, QString *error)
+{
+    if (!m_rings.isEmpty()
+        && (ring->sampleRate() != sampleRate() || ring->channels() != channels())) {
+        if (error) {
+            *error = QString("%1 is %2 Hz, %3 ch; %4 is %5 Hz, %6 ch")
+                         .arg(ring->name())
+                         .arg(ring->sampleRate())
+                         .arg(ring->channels())
+                         .arg(m_rings.first()->name())
+                         .arg(sampleRate())
+                         .arg(channels());
+        }
+        return false;
+    }
+    m_rings.append(ring);
+    return true;
+}
+
+int SharedAudioMixer::sampleRate() const
+{
+    return m_rings.isEmpty() ? 0 : m_rings.first()->sampleRate();
+}
+
+int SharedAudioMixer::channels() const
+{
+    return m_rings.isEmpty() ? 0 : m_rings.first()->channels();
+}
+
+// Смешивание отрезками по MixFrames: сумма остается в кэше, каждый буфер
+// читается на месте (не больше двух участков на отрезок)
+qint64 SharedAudioMixer::readData(char *data, qint64 maxlen)
+{
+    const int channelCount = channels();
+    if (channelCount == 0) {
+        return 0;
+    }
+    const qint64 frameBytes = qint64(channelCount) * qint64(sizeof(float));
+    const qint64 frames = maxlen / frameBytes;
+    for (qint64 pos = 0; pos < frames;) {
+        const int count = int(qMin<qint64>(MixFrames, frames - pos));
+        std::fill(m_mix, m_mix + count * channelCount, 0.0f);
+        for (SharedAudioRing *ring : m_rings) {
+            int mixed = 0;
+            while (mixed < count) {
+                qint64 ready = 0;
+                const float *source = ring->readRegion(&ready);
+                const int take = int(qMin<qint64>(ready, count - mixed));
+                if (take == 0) {
+                    break;
+                }
+                float *target = m_mix + mixed * channelCount;
+                for (int i = 0; i < take * channelCount; ++i) {
+                    target[i] += source[i];
+                }
+                ring->consume(take);
+                mixed += take;
+            }
+            if (mixed < count) {
+                ring->reportUnderrun(count - mixed);
+            }
+        }
+        std::memcpy(data + pos * frameBytes, m_mix, size_t(count) * size_t(frameBytes));
+        pos += count;
+    }
+    return frames * frameBytes;
+}
+
+qint64 SharedAudioMixer::writeData(const char *data, qint64 len)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(len);
+    return 0;
+}
+
+qint64 SharedAudioMixer::size() const
+{
+    return std::numeric_limits<qint64>::max();
+}
+
+qint64 SharedAudioMixer::bytesAvailable() const
+{
+    return std::numeric_limits<qint64>::max();
+}
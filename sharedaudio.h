@@ -0,0 +1,133 @@
+#ifndef SHAREDAUDIO_H
+#define SHAREDAUDIO_H
+
+#include <atomic>
+#include <QIODevice>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include "tonesynth.h" // Синтезатор
+
+// Кольцевой буфер кадров float в разделяемой памяти POSIX (shm_open) между
+// процессом синтезатора (писатель) и смесителем или проверкой (читатель).
+// Писатель генерирует прямо в отображенную память, читатель читает из нее же:
+// звук между процессами не копируется. Счетчики 64-битные атомарные, как
+// в RingBuffer; в заголовке - показатели экземпляра (время ЦП процесса)
+class SharedAudioRing
+{
+    Q_DISABLE_COPY(SharedAudioRing)
+
+public:
+    SharedAudioRing();
+    ~SharedAudioRing();
+
+    // Создание (писатель): capacityFrames округляется вверх до степени двойки.
+    // Писатель держит на объекте блокировку flock до close(): объект с тем же
+    // именем, оставшийся от упавшего процесса (блокировки нет), заменяется,
+    // а имя работающего писателя дает ошибку "in use"
+    bool create(const QString &name, int sampleRate, int channels, int capacityFrames, QString *error);
+    // Подключение к созданному буферу (читатель)
+    bool attach(const QString &name, QString *error);
+    // Отключение; писатель удаляет имя объекта
+    void close();
+    bool isOpen() const;
+
+    QString name() const;
+    int sampleRate() const;
+    int channels() const;
+    qint64 capacity() const; // В кадрах
+    qint64 ownerPid() const;
+
+    // Запись без копирования (только писатель): непрерывный свободный участок
+    // от позиции записи, до конца памяти буфера. Кадры становятся видны
+    // читателю после publish()
+    float *writeRegion(qint64 *frames);
+    void publish(qint64 frames);
+    // Готовые кадры (точно для читателя, оценка сверху для писателя)
+    qint64 readable() const;
+
+    // Чтение без копирования (только читатель): непрерывный участок готовых
+    // кадров от позиции чтения, до конца памяти буфера. Освобождается consume()
+    const float *readRegion(qint64 *frames) const;
+    void consume(qint64 frames);
+
+    // Показатели: время ЦП процесса-писателя (он обновляет его после каждой
+    // генерации), всего опубликовано кадров, кадров тишины у читателя
+    void setCpuTime(qint64 ns);
+    qint64 cpuTimeNs() const;
+    quint64 writtenFrames() const;
+    void reportUnderrun(qint64 frames);
+    quint64 underrunFrames() const;
+
+private:
+    struct Header;
+
+    bool map(int fd, size_t bytes, QString *error);
+
+    QString m_name;
+    Header *m_header;
+    float *m_data;
+    size_t m_bytes; // Размер отображения
+    quint64 m_mask; // Емкость в кадрах - 1
+    bool m_owner; // Писатель: удаляет имя при закрытии
+    int m_lockFd; // Писатель: дескриптор объекта с блокировкой flock
+};
+
+// Поток генерации экземпляра без устройства: держит в разделяемом буфере
+// запас готовых кадров перед позицией читателя. Темп задает читатель
+// (смеситель со своим устройством), поэтому несколько экземпляров
+// выводятся через одно устройство без собственных QAudioSink
+class SharedRenderThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    SharedRenderThread(ToneSynthesizer *synth, SharedAudioRing *ring, QObject *parent = nullptr);
+    ~SharedRenderThread() override;
+
+    // aheadFrames - запас перед читателем (задержка экземпляра), округляется
+    // до целых блоков генерации
+    void startRendering(qint64 aheadFrames);
+    void stopRendering();
+
+protected:
+    void run() override;
+
+private:
+    ToneSynthesizer *m_synth;
+    SharedAudioRing *m_ring;
+    qint64 m_aheadFrames;
+    std::atomic<bool> m_stopRequested;
+};
+
+// Источник данных для QAudioSink/QAudioOutput: сумма разделяемых буферов
+// нескольких экземпляров в формате float с их частотой и числом каналов.
+// Экземпляр, не успевший сгенерировать кадры, дает тишину (учитывается
+// в его заголовке), остальные звучат без пропусков
+class SharedAudioMixer : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit SharedAudioMixer(QObject *parent = nullptr);
+
+    // Все буферы - с одной частотой и числом каналов. Добавлять можно только
+    // пока устройство закрыто; буфер должен жить, пока устройство читает данные
+    bool addRing(SharedAudioRing *ring, QString *error);
+    int sampleRate() const;
+    int channels() const;
+
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+    qint64 size() const override;
+    qint64 bytesAvailable() const override;
+
+private:
+    // Наибольший отрезок смешивания в кадрах
+    static const int MixFrames = 512;
+
+    QVector<SharedAudioRing *> m_rings;
+    float m_mix[MixFrames * ToneSynthesizer::MaxChannels];
+};
+
+#endif // SHAREDAUDIO_H
@@ -0,0 +1,64 @@
+#include <QtMath>
+#include "smoothedvalue.h"
+
+namespace {
+// Остаток, ниже которого однополюсный переход считается завершенным
+const float settleThreshold = 1e-5f;
+}
+
+SmoothedValue::SmoothedValue(Mode mode, float value)
+    : m_mode(mode)
+    , m_value(value)
+    , m_target(value)
+    , m_step(0.0f)
+    , m_timeFrames(0.0)
+    , m_coefficientFrames(0)
+    , m_coefficient(0.0f)
+{}
+
+void SmoothedValue::setTime(qreal timeMs, int sampleRate)
+{
+    m_timeFrames = qMax(0.0, timeMs) * sampleRate / 1000.0;
+    m_coefficientFrames = 0;
+    setTarget(m_target); // Текущий переход продолжается с новой скоростью
+}
+
+void SmoothedValue::reset(float value)
+{
+    m_value = value;
+    m_target = value;
+    m_step = 0.0f;
+}
+
+void SmoothedValue::setTarget(float target)
+{
+    m_target = target;
+    if (m_timeFrames < 1.0) {
+        m_value = target;
+        return;
+    }
+    m_step = float((target - m_value) / m_timeFrames);
+}
+
+float SmoothedValue::advance(int frames)
+{
+    if (m_value == m_target) {
+        return m_value;
+    }
+    if (m_mode == Mode::linear) {
+        const float next = m_value + m_step * frames;
+        // Переход не проскакивает цель
+        m_value = ((m_step > 0.0f) == (next < m_target)) ? next : m_target;
+        return m_value;
+    }
+    // Множитель exp(-frames / T) пересчитывается только при смене длины отрезка
+    if (frames != m_coefficientFrames) {
+        m_coefficientFrames = frames;
+        m_coefficient = float(qExp(-frames / m_timeFrames));
+    }
+    m_value = m_target + (m_value - m_target) * m_coefficient;
+    if (qAbs(m_value - m_target) < settleThreshold) {
+        m_value = m_target;
+    }
+    return m_value;
+}
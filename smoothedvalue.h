@@ -0,0 +1,42 @@
+#ifndef SMOOTHEDVALUE_H
+#define SMOOTHEDVALUE_H
+
+#include <QtGlobal>
+
+// Плавное изменение параметра в потоке звука. Значение продвигается отрезками
+// (блоками) сэмплов: линейный переход за заданное время или экспоненциальное
+// приближение (однополюсный фильтр) с заданной постоянной времени. Внутри
+// отрезка значение интерполируется линейно тем, кто его применяет
+class SmoothedValue
+{
+public:
+    enum class Mode : int { linear, onePole };
+
+    SmoothedValue(Mode mode = Mode::linear, float value = 0.0f);
+
+    // Время перехода (линейный) или постоянная времени (однополюсный);
+    // 0 - новое значение применяется сразу
+    void setTime(qreal timeMs, int sampleRate);
+    // Немедленный переход без сглаживания
+    void reset(float value);
+    void setTarget(float target);
+
+    float value() const { return m_value; }
+    float target() const { return m_target; }
+    bool isSmoothing() const { return m_value != m_target; }
+
+    // Продвижение на frames сэмплов; возвращает значение в конце отрезка
+    float advance(int frames);
+
+private:
+    Mode m_mode;
+    float m_value;
+    float m_target;
+    float m_step; // Приращение за сэмпл (линейный)
+    qreal m_timeFrames;
+    // Множитель однополюсного фильтра для последней длины отрезка
+    int m_coefficientFrames;
+    float m_coefficient;
+};
+
+#endif // SMOOTHEDVALUE_H
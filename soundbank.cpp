@@ -0,0 +1,282 @@
+#include <cstring>
+#include <QtEndian>
+#include "soundbank.h"
+#include "wavetable.h"
+
+namespace {
+
+const char magic[4] = {'M', 'S', 'B', 'K'};
+const quint32 version = 1;
+const int headerBytes = 16;
+const int recordBytes = 64;
+const int nameBytes = 32;
+// Выравнивание данных записей (не меньше размера float и строки кэша)
+const int dataAlignment = 64;
+// Шаг чтения страниц таблиц при открытии
+const int pageBytes = 4096;
+
+// Поля записи банка (смещения внутри 64 байт)
+enum RecordField {
+    kindField = 32,
+    framesField = 36,
+    offsetField = 40,
+    rateField = 48,
+    rootField = 52,
+    loopStartField = 56,
+    loopEndField = 60
+};
+
+quint32 readU32(const uchar *data)
+{
+    return qFromLittleEndian<quint32>(data);
+}
+
+void writeU32(char *data, quint32 value)
+{
+    qToLittleEndian<quint32>(value, data);
+}
+
+} // namespace
+
+SoundBank::SoundBank()
+    : m_map(nullptr)
+{}
+
+SoundBank::~SoundBank()
+{
+    close();
+}
+
+bool SoundBank::open(const QString &fileName, QString *error)
+{
+    close();
+    auto fail = [&](const QString &message) {
+        if (error) {
+            *error = QString("%1: %2").arg(fileName, message);
+        }
+        close();
+        return false;
+    };
+    // Данные читаются из отображения без перестановки байтов
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    return fail("sound banks are not supported on big-endian hosts");
+#endif
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return fail(m_file.errorString());
+    }
+    const qint64 size = m_file.size();
+    if (size < headerBytes) {
+        return fail("not a sound bank");
+    }
+    m_map = m_file.map(0, size);
+    if (!m_map) {
+        return fail(m_file.errorString());
+    }
+    if (std::memcmp(m_map, magic, sizeof(magic)) != 0) {
+        return fail("not a sound bank");
+    }
+    if (readU32(m_map + 4) != version) {
+        return fail(QString("unsupported version %1").arg(readU32(m_map + 4)));
+    }
+    const quint32 count = readU32(m_map + 8);
+    if (qint64(count) * recordBytes > size - headerBytes) {
+        return fail("truncated record table");
+    }
+
+    m_entries.reserve(int(count));
+    for (quint32 i = 0; i < count; ++i) {
+        const uchar *record = m_map + headerBytes + i * recordBytes;
+        Entry entry;
+        entry.name = QString::fromUtf8(reinterpret_cast<const char *>(record),
+                                       int(qstrnlen(reinterpret_cast<const char *>(record), nameBytes)));
+        const quint32 kind = readU32(record + kindField);
+        entry.frames = readU32(record + framesField);
+        const quint64 offset = qFromLittleEndian<quint64>(record + offsetField);
+        entry.sampleRate = int(readU32(record + rateField));
+        entry.rootNote = int(readU32(record + rootField));
+        entry.loopStart = readU32(record + loopStartField);
+        entry.loopEnd = readU32(record + loopEndField);
+
+        const QString where = QString("entry %1 '%2'").arg(i).arg(entry.name);
+        if (entry.name.isEmpty()) {
+            return fail(QString("entry %1: empty name").arg(i));
+        }
+        if (kind > quint32(Kind::sample)) {
+            return fail(where + QString(": unknown kind %1").arg(kind));
+        }
+        entry.kind = Kind(kind);
+        if (offset % dataAlignment != 0 || offset > quint64(size)
+            || quint64(entry.frames) * sizeof(float) > quint64(size) - offset) {
+            return fail(where + ": data outside the file");
+        }
+        if (entry.kind == Kind::wavetable && entry.frames != quint32(Wavetable::SetSize)) {
+            return fail(where + ": wavetable size does not match this build");
+        }
+        if (entry.kind == Kind::sample
+            && (entry.frames == 0 || entry.sampleRate <= 0 || entry.rootNote < 0 || entry.rootNote > 127
+                || entry.loopEnd > entry.frames || (entry.loopEnd != 0 && entry.loopStart >= entry.loopEnd))) {
+            return fail(where + ": bad sample header");
+        }
+        entry.data = reinterpret_cast<const float *>(m_map + offset);
+
+        // Таблицы нужны первой же ноте: страницы читаются сейчас, а не в потоке звука
+        if (entry.kind == Kind::wavetable) {
+            const uchar *data = m_map + offset;
+            const qint64 bytes = qint64(entry.frames) * qint64(sizeof(float));
+            volatile uchar sink = 0;
+            for (qint64 pos = 0; pos < bytes; pos += pageBytes) {
+                sink = sink ^ data[pos];
+            }
+            sink = sink ^ data[bytes - 1];
+        }
+        m_entries.append(entry);
+    }
+    return true;
+}
+
+void SoundBank::close()
+{
+    m_entries.clear();
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    m_file.close();
+}
+
+bool SoundBank::isOpen() const
+{
+    return m_map != nullptr;
+}
+
+QString SoundBank::fileName() const
+{
+    return m_file.fileName();
+}
+
+int SoundBank::count() const
+{
+    return m_entries.size();
+}
+
+const SoundBank::Entry &SoundBank::entry(int index) const
+{
+    return m_entries.at(index);
+}
+
+int SoundBank::find(const QString &name, Kind kind) const
+{
+    for (int i = 0; i < m_entries.size(); ++i) {
+        if (m_entries.at(i).kind == kind && m_entries.at(i).name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QString SoundBank::kindName(Kind kind)
+{
+    return (kind == Kind::wavetable) ? "wavetable" : "sample";
+}
+
+void SoundBankWriter::addWavetable(const QString &name, const float *cycle, int length)
+{
+    Record record;
+    record.name = name;
+    record.kind = SoundBank::Kind::wavetable;
+    record.data.resize(Wavetable::SetSize);
+    Wavetable::buildSet(cycle, length, record.data.data());
+    record.sampleRate = 0;
+    record.rootNote = 0;
+    record.loopStart = 0;
+    record.loopEnd = 0;
+    m_records.append(record);
+}
+
+void SoundBankWriter::addSample(const QString &name,
+                                const float *samples,
+                                quint32 frames,
+                                int sampleRate,
+                                int rootNote,
+                                quint32 loopStart,
+                                quint32 loopEnd)
+{
+    Record record;
+    record.name = name;
+    record.kind = SoundBank::Kind::sample;
+    record.data = QVector<float>(int(frames));
+    std::memcpy(record.data.data(), samples, frames * sizeof(float));
+    record.sampleRate = sampleRate;
+    record.rootNote = rootNote;
+    record.loopStart = loopStart;
+    record.loopEnd = loopEnd;
+    m_records.append(record);
+}
+
+int SoundBankWriter::count() const
+{
+    return m_records.size();
+}
+
+bool SoundBankWriter::write(const QString &fileName, QString *error) const
+{
+    auto fail = [&](const QString &message) {
+        if (error) {
+            *error = QString("%1: %2").arg(fileName, message);
+        }
+        return false;
+    };
+
+    // Заголовок и таблица записей; данные идут следом с выравниванием
+    const int tableBytes = headerBytes + m_records.size() * recordBytes;
+    QByteArray head(tableBytes, '\0');
+    std::memcpy(head.data(), magic, sizeof(magic));
+    writeU32(head.data() + 4, version);
+    writeU32(head.data() + 8, quint32(m_records.size()));
+    quint64 offset = (quint64(tableBytes) + dataAlignment - 1) / dataAlignment * dataAlignment;
+    QVector<quint64> offsets;
+    for (int i = 0; i < m_records.size(); ++i) {
+        const Record &record = m_records.at(i);
+        const QByteArray name = record.name.toUtf8();
+        if (name.isEmpty() || name.size() > nameBytes) {
+            return fail(QString("entry name '%1' must be 1..%2 bytes").arg(record.name).arg(nameBytes));
+        }
+        char *out = head.data() + headerBytes + i * recordBytes;
+        std::memcpy(out, name.constData(), size_t(name.size()));
+        writeU32(out + kindField, quint32(record.kind));
+        writeU32(out + framesField, quint32(record.data.size()));
+        qToLittleEndian<quint64>(offset, out + offsetField);
+        writeU32(out + rateField, quint32(record.sampleRate));
+        writeU32(out + rootField, quint32(record.rootNote));
+        writeU32(out + loopStartField, record.loopStart);
+        writeU32(out + loopEndField, record.loopEnd);
+        offsets.append(offset);
+        offset += quint64(record.data.size()) * sizeof(float);
+        offset = (offset + dataAlignment - 1) / dataAlignment * dataAlignment;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(head) != head.size()) {
+        return fail(file.errorString());
+    }
+    for (int i = 0; i < m_records.size(); ++i) {
+        const QVector<float> &data = m_records.at(i).data;
+        QByteArray bytes(int(offsets.at(i) - quint64(file.pos())), '\0'); // Выравнивание
+        bytes.reserve(bytes.size() + data.size() * int(sizeof(float)));
+        for (float value : data) {
+            quint32 bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            char le[4];
+            writeU32(le, bits);
+            bytes.append(le, sizeof(le));
+        }
+        if (file.write(bytes) != bytes.size()) {
+            return fail(file.errorString());
+        }
+    }
+    if (!file.flush()) {
+        return fail(file.errorString());
+    }
+    return true;
+}
@@ -0,0 +1,92 @@
+#ifndef SOUNDBANK_H
+#define SOUNDBANK_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+// Банк волновых таблиц и сэмплов. Файл отображается в память только для чтения
+// (QFile::map()) и не копируется: голоса читают таблицы прямо из отображения,
+// поэтому запуск с большим банком не ждет чтения файла. Формат (little-endian):
+//   заголовок, 16 байт: "MSBK", версия, число записей, резерв (по 4 байта)
+//   записи по 64 байта: имя (32 байта UTF-8, дополненное нулями), вид, число
+//   точек, смещение данных (8 байт), частота, корневая нота, начало и конец петли
+//   данные: float32, каждая запись с границы 64 байт
+// Таблица - Wavetable::MipLevels ступеней по Wavetable::TableSize + 1 точек,
+// в том же виде, что встроенные таблицы. Сэмпл - моно с частотой
+// дискретизации, корневой нотой и петлей (конец 0 - без петли)
+class SoundBank
+{
+public:
+    enum class Kind : int { wavetable, sample };
+
+    struct Entry
+    {
+        QString name;
+        Kind kind;
+        const float *data; // Внутри отображения файла
+        quint32 frames; // Точек в записи (у таблицы - Wavetable::SetSize)
+        int sampleRate;
+        int rootNote;
+        quint32 loopStart;
+        quint32 loopEnd;
+    };
+
+    SoundBank();
+    ~SoundBank();
+
+    // Отображение файла и проверка записей. Страницы таблиц читаются сразу,
+    // чтобы первая нота не ждала диска; данные сэмплов - по мере обращения
+    bool open(const QString &fileName, QString *error = nullptr);
+    void close();
+    bool isOpen() const;
+    QString fileName() const;
+
+    int count() const;
+    const Entry &entry(int index) const;
+    // Индекс записи по имени и виду, -1 - нет такой
+    int find(const QString &name, Kind kind) const;
+
+    static QString kindName(Kind kind);
+
+private:
+    Q_DISABLE_COPY(SoundBank)
+
+    QFile m_file;
+    uchar *m_map;
+    QVector<Entry> m_entries;
+};
+
+// Сборка банка: записи копируются в память и пишутся в файл одним проходом
+class SoundBankWriter
+{
+public:
+    // Таблица из одного периода произвольной длины (мип-ступени строятся здесь)
+    void addWavetable(const QString &name, const float *cycle, int length);
+    void addSample(const QString &name,
+                   const float *samples,
+                   quint32 frames,
+                   int sampleRate,
+                   int rootNote,
+                   quint32 loopStart = 0,
+                   quint32 loopEnd = 0);
+    int count() const;
+    bool write(const QString &fileName, QString *error = nullptr) const;
+
+private:
+    struct Record
+    {
+        QString name;
+        SoundBank::Kind kind;
+        QVector<float> data;
+        int sampleRate;
+        int rootNote;
+        quint32 loopStart;
+        quint32 loopEnd;
+    };
+
+    QVector<Record> m_records;
+};
+
+#endif // SOUNDBANK_H
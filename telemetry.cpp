@@ -0,0 +1,187 @@
+#include <limits>
+#include <QStringList>
+#include "telemetry.h"
+
+const qint64 AudioTelemetry::JitterBounds[AudioTelemetry::JitterBuckets - 1]
+    = {100, 250, 500, 1000, 2000, 5000, 10000, 20000};
+
+AudioTelemetry::AudioTelemetry()
+    : m_callbacks(0)
+    , m_renderNs(0)
+    , m_maxRenderNs(0)
+    , m_loadPpm(0)
+    , m_maxLoadPpm(0)
+    , m_minRequest(std::numeric_limits<qint64>::max())
+    , m_maxRequest(0)
+    , m_underruns(0)
+    , m_deliveredFrames(0)
+    , m_silentFrames(0)
+    , m_activeVoices(0)
+    , m_inputLatencyNs(0)
+    , m_maxInputLatencyNs(0)
+    , m_inputLatencies(0)
+    , m_resetRequested(false)
+    , m_renderResetRequested(false)
+    , m_lastStartNs(0)
+    , m_lastPeriodNs(0)
+{
+    for (int i = 0; i < JitterBuckets; ++i) {
+        m_jitter[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+// Начало вызова readData(): интервал с прошлого вызова и размер запроса
+void AudioTelemetry::callbackStarted(qint64 startNs, qint64 maxlen)
+{
+    if (m_resetRequested.exchange(false, std::memory_order_acquire)) {
+        m_callbacks.store(0, std::memory_order_relaxed);
+        m_minRequest.store(std::numeric_limits<qint64>::max(), std::memory_order_relaxed);
+        m_maxRequest.store(0, std::memory_order_relaxed);
+        for (int i = 0; i < JitterBuckets; ++i) {
+            m_jitter[i].store(0, std::memory_order_relaxed);
+        }
+        m_lastStartNs = 0;
+    }
+    if (m_lastStartNs != 0) {
+        // Устройство должно запросить следующий буфер через время звучания предыдущего
+        const qint64 deviationUs = qAbs((startNs - m_lastStartNs) - m_lastPeriodNs) / 1000;
+        int bucket = 0;
+        while (bucket < JitterBuckets - 1 && deviationUs >= JitterBounds[bucket]) {
+            bucket++;
+        }
+        m_jitter[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+    m_lastStartNs = startNs;
+    if (maxlen < m_minRequest.load(std::memory_order_relaxed)) {
+        m_minRequest.store(maxlen, std::memory_order_relaxed);
+    }
+    if (maxlen > m_maxRequest.load(std::memory_order_relaxed)) {
+        m_maxRequest.store(maxlen, std::memory_order_relaxed);
+    }
+}
+
+// Конец вызова readData(): отданные кадры и их длительность для оценки следующего интервала
+void AudioTelemetry::callbackFinished(qint64 frames, qint64 periodNs)
+{
+    m_lastPeriodNs = periodNs;
+    m_deliveredFrames.fetch_add(quint64(frames), std::memory_order_relaxed);
+    m_callbacks.fetch_add(1, std::memory_order_release);
+}
+
+// Конец генерации: время генерации и нагрузка относительно длительности данных
+void AudioTelemetry::renderFinished(qint64 renderNs, qint64 periodNs, int activeVoices)
+{
+    if (m_renderResetRequested.exchange(false, std::memory_order_acquire)) {
+        m_maxRenderNs.store(0, std::memory_order_relaxed);
+        m_maxLoadPpm.store(0, std::memory_order_relaxed);
+        m_maxInputLatencyNs.store(0, std::memory_order_relaxed);
+    }
+    const qint64 loadPpm = periodNs > 0 ? renderNs * 1000000 / periodNs : 0;
+    m_renderNs.store(renderNs, std::memory_order_relaxed);
+    if (renderNs > m_maxRenderNs.load(std::memory_order_relaxed)) {
+        m_maxRenderNs.store(renderNs, std::memory_order_relaxed);
+    }
+    m_loadPpm.store(loadPpm, std::memory_order_relaxed);
+    if (loadPpm > m_maxLoadPpm.load(std::memory_order_relaxed)) {
+        m_maxLoadPpm.store(loadPpm, std::memory_order_relaxed);
+    }
+    m_activeVoices.store(activeVoices, std::memory_order_relaxed);
+}
+
+// Замер задержки ввода (сторона генерации, до renderFinished() того же вызова)
+void AudioTelemetry::inputLatencyMeasured(qint64 latencyNs)
+{
+    m_inputLatencyNs.store(latencyNs, std::memory_order_relaxed);
+    if (latencyNs > m_maxInputLatencyNs.load(std::memory_order_relaxed)) {
+        m_maxInputLatencyNs.store(latencyNs, std::memory_order_relaxed);
+    }
+    m_inputLatencies.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AudioTelemetry::reportUnderrun(qint64 silentFrames)
+{
+    if (silentFrames > 0) {
+        m_silentFrames.fetch_add(quint64(silentFrames), std::memory_order_relaxed);
+    }
+    m_underruns.fetch_add(1, std::memory_order_relaxed);
+}
+
+AudioTelemetry::Snapshot AudioTelemetry::snapshot() const
+{
+    Snapshot s;
+    s.timestampMs = 0;
+    s.callbacks = m_callbacks.load(std::memory_order_acquire);
+    s.renderNs = m_renderNs.load(std::memory_order_relaxed);
+    s.maxRenderNs = m_maxRenderNs.load(std::memory_order_relaxed);
+    s.dspLoad = m_loadPpm.load(std::memory_order_relaxed) / 1e6;
+    s.maxDspLoad = m_maxLoadPpm.load(std::memory_order_relaxed) / 1e6;
+    const qint64 minRequest = m_minRequest.load(std::memory_order_relaxed);
+    s.minRequestBytes = (minRequest == std::numeric_limits<qint64>::max()) ? 0 : minRequest;
+    s.maxRequestBytes = m_maxRequest.load(std::memory_order_relaxed);
+    s.underruns = m_underruns.load(std::memory_order_relaxed);
+    s.activeVoices = m_activeVoices.load(std::memory_order_relaxed);
+    s.deliveredFrames = m_deliveredFrames.load(std::memory_order_relaxed);
+    s.silentFrames = m_silentFrames.load(std::memory_order_relaxed);
+    s.inputLatencyNs = m_inputLatencyNs.load(std::memory_order_relaxed);
+    s.maxInputLatencyNs = m_maxInputLatencyNs.load(std::memory_order_relaxed);
+    s.inputLatencies = m_inputLatencies.load(std::memory_order_relaxed);
+    for (int i = 0; i < JitterBuckets; ++i) {
+        s.jitter[i] = m_jitter[i].load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+// Сброс максимумов и гистограммы (выполняется писателями при следующем вызове)
+void AudioTelemetry::reset()
+{
+    m_underruns.store(0, std::memory_order_relaxed);
+    m_resetRequested.store(true, std::memory_order_release);
+    m_renderResetRequested.store(true, std::memory_order_release);
+}
+
+QString AudioTelemetry::csvHeader()
+{
+    QStringList columns{"time_ms",
+                        "callbacks",
+                        "render_us",
+                        "max_render_us",
+                        "dsp_load",
+                        "max_dsp_load",
+                        "min_maxlen",
+                        "max_maxlen",
+                        "underruns",
+                        "voices",
+                        "frames",
+                        "silent_frames",
+                        "input_latency_us",
+                        "max_input_latency_us",
+                        "input_latencies"};
+    for (int i = 0; i < JitterBuckets - 1; ++i) {
+        columns << QString("jitter_lt_%1us").arg(JitterBounds[i]);
+    }
+    columns << QString("jitter_ge_%1us").arg(JitterBounds[JitterBuckets - 2]);
+    return columns.join(',');
+}
+
+QString AudioTelemetry::csvRow(const Snapshot &s)
+{
+    QStringList fields{QString::number(s.timestampMs),
+                       QString::number(s.callbacks),
+                       QString::number(s.renderNs / 1000.0, 'f', 1),
+                       QString::number(s.maxRenderNs / 1000.0, 'f', 1),
+                       QString::number(s.dspLoad, 'f', 4),
+                       QString::number(s.maxDspLoad, 'f', 4),
+                       QString::number(s.minRequestBytes),
+                       QString::number(s.maxRequestBytes),
+                       QString::number(s.underruns),
+                       QString::number(s.activeVoices),
+                       QString::number(s.deliveredFrames),
+                       QString::number(s.silentFrames),
+                       QString::number(s.inputLatencyNs / 1000.0, 'f', 1),
+                       QString::number(s.maxInputLatencyNs / 1000.0, 'f', 1),
+                       QString::number(s.inputLatencies)};
+    for (int i = 0; i < JitterBuckets; ++i) {
+        fields << QString::number(s.jitter[i]);
+    }
+    return fields.join(',');
+}
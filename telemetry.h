@@ -0,0 +1,84 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+#include <QString>
+#include <QtGlobal>
+
+// Показатели работы звукового потока. Пишутся без блокировок двумя писателями:
+// стороной устройства (вызовы readData()) и стороной генерации (время и нагрузка),
+// у каждой свои поля. При генерации внутри readData() это один и тот же поток.
+// Читаются потоком GUI через snapshot()
+class AudioTelemetry
+{
+public:
+    // Гистограмма отклонения интервала между вызовами readData() от длительности
+    // предыдущего буфера, верхние границы корзин в микросекундах
+    static const int JitterBuckets = 9;
+    static const qint64 JitterBounds[JitterBuckets - 1];
+
+    // Согласованная копия показателей для GUI
+    struct Snapshot
+    {
+        qint64 timestampMs;      // Время снятия (мс от запуска)
+        quint64 callbacks;       // Число вызовов readData()
+        qint64 renderNs;         // Время генерации последнего буфера
+        qint64 maxRenderNs;      // Максимум времени генерации
+        qreal dspLoad;           // Время генерации / длительность буфера (последний)
+        qreal maxDspLoad;        // Максимум нагрузки
+        qint64 minRequestBytes;  // Минимальный запрошенный maxlen
+        qint64 maxRequestBytes;  // Максимальный запрошенный maxlen
+        quint64 underruns;       // Число опустошений буфера устройства
+        int activeVoices;        // Звучащие голоса
+        quint64 deliveredFrames; // Кадров отдано устройству
+        quint64 silentFrames;    // Из них тишины вместо несгенерированных данных
+        qint64 inputLatencyNs;   // Задержка ввода: нажатие - первый сэмпл ноты (последняя)
+        qint64 maxInputLatencyNs; // Максимум задержки ввода
+        quint64 inputLatencies;  // Число замеров задержки ввода
+        quint64 jitter[JitterBuckets];
+    };
+
+    AudioTelemetry();
+
+    // Сторона устройства
+    void callbackStarted(qint64 startNs, qint64 maxlen);
+    void callbackFinished(qint64 frames, qint64 periodNs);
+    // Сторона генерации
+    void renderFinished(qint64 renderNs, qint64 periodNs, int activeVoices);
+    void inputLatencyMeasured(qint64 latencyNs);
+
+    // Опустошение: сторона устройства (silentFrames - сколько кадров тишины
+    // отдано вместо данных) или сторона GUI (наблюдение за выводом)
+    void reportUnderrun(qint64 silentFrames = 0);
+
+    // Сторона GUI
+    Snapshot snapshot() const;
+    void reset();
+
+    static QString csvHeader();
+    static QString csvRow(const Snapshot &snapshot);
+
+private:
+    std::atomic<quint64> m_callbacks;
+    std::atomic<qint64> m_renderNs;
+    std::atomic<qint64> m_maxRenderNs;
+    std::atomic<qint64> m_loadPpm; // Нагрузка в миллионных долях
+    std::atomic<qint64> m_maxLoadPpm;
+    std::atomic<qint64> m_minRequest;
+    std::atomic<qint64> m_maxRequest;
+    std::atomic<quint64> m_underruns;
+    std::atomic<quint64> m_deliveredFrames; // Счетчики кадров не сбрасываются
+    std::atomic<quint64> m_silentFrames;
+    std::atomic<int> m_activeVoices;
+    std::atomic<qint64> m_inputLatencyNs;
+    std::atomic<qint64> m_maxInputLatencyNs;
+    std::atomic<quint64> m_inputLatencies;
+    std::atomic<quint64> m_jitter[JitterBuckets];
+    std::atomic<bool> m_resetRequested; // Сброс выполняет писатель устройства
+    std::atomic<bool> m_renderResetRequested; // Сброс выполняет писатель генерации
+    // Состояние писателя устройства
+    qint64 m_lastStartNs;
+    qint64 m_lastPeriodNs;
+};
+
+#endif // TELEMETRY_H
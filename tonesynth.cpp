@@ -1,21 +1,234 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <limits> // Для получения максимального значения qint64
 //#include <QDebug>
 #include <QtMath>
+#include "recorder.h" // Запись вывода
 #include "tonesynth.h"
 
+static_assert(ToneSynthesizer::ParallelBlockFrames <= EffectGraph::MaxBlockFrames,
+              "effect graph buffers must hold a whole render block");
+static_assert(ToneSynthesizer::ParallelBlockFrames <= Decimator::MaxFrames,
+              "the decimator must take a whole render block");
+static_assert(ToneSynthesizer::MaxVoices <= SampleStreamer::Streams, "every voice needs a sample stream");
+
+namespace {
+
+// Имена, диапазоны и начальные значения параметров (порядок - ToneSynthesizer::Parameter)
+struct ParameterRange
+{
+    const char *name;
+    float minimum;
+    float maximum;
+    float initial;
+};
+
+const ParameterRange parameterRanges[ToneSynthesizer::Parameters] = {
+    {"volume", 0.0f, 1.0f, 1.0f},
+    {"glide", 0.0f, 5000.0f, 0.0f},
+    {"octave", -6.0f, 6.0f, 0.0f},
+};
+
+// Время линейного перехода громкости: без ступенек и без заметной задержки
+const qreal volumeRampMs = 20.0;
+// Голос на последней, спадающей ступени огибающей тише этого уровня (-80 дБ)
+// освобождается, не дожидаясь конца ступени
+const float retireLevel = 1.0e-4f;
+// Вывод без голосов тише этого уровня (-120 дБ) в течение silenceHoldMs
+// и не меньше хвоста графа обработки: хвосты затихли, следующие блоки
+// без нот - просто нули. Тишина на выходе еще не значит, что граф пуст:
+// между нотой и первым отзвуком задержки выход ровно нулевой. После хвоста
+// состояние графа тише порога, поэтому при пропуске тишины его можно
+// не продвигать
+const float silenceLevel = 1.0e-6f;
+const qreal silenceHoldMs = 50.0;
+// Наибольшая транспозиция сэмпла вверх (кадров сэмпла на сэмпл вывода)
+const qreal maxSampleStep = 16.0;
+// Нота, не зазвучавшая за это время после своей метки, в замер задержки не попадает
+const qreal probeTimeoutMs = 1000.0;
+
+} // namespace
+
 ToneSynthesizer::ToneSynthesizer(const QAudioFormat &format)
     : QIODevice()
-    , m_octave(3) // Начальная октава 3
-    , m_envelState(EnvelopeState::silentState) // Изначально состояние огибающей - "тишина"
-    , m_envelVolume(0.0) // Начальная громкость огибающей 0.0
+    , m_activeCount(0) // Изначально ни один голос не звучит
+    , m_noteCounter(0)
+    , m_wavetable(Wavetable::instance()) // Таблицы строятся здесь, а не в потоке звука
+    , m_voicesInUse(0)
+    , m_oscillator(RenderKernels::oscillator())
+    , m_convert(RenderKernels::converter(RenderKernels::SampleFormat::float32))
+    , m_channels(1)
+    , m_frameBytes(sizeof(float))
+    , m_blockFrames(BlockFrames)
+    , m_oversampling(1)
+    , m_taskFrames(0)
+    , m_silent(true)
+    , m_quietFrames(0)
+    , m_bendFactor(1.0)
+    , m_octaveFactor(1.0)
+    , m_volume(SmoothedValue::Mode::linear, 1.0f)
+    , m_octave(SmoothedValue::Mode::onePole, 0.0f)
+    , m_tunedOctave(0.0f)
+    , m_glideMs(0.0)
+    , m_sustainPedal(false)
+    , m_framePosition(0)
+    , m_clockSeq(0)
+    , m_clockNs(monotonicNs())
+    , m_clockFrame(0)
+    , m_clockFrames(0)
+    , m_clockRate(0)
+    , m_deviceBufferBytes(0)
+    , m_targetBytes(0)
+    , m_recorder(nullptr)
+    , m_program(&m_initProgram)
+    , m_patches(nullptr)
+    , m_offline(false)
+    , m_probePosted(false)
+    , m_probePostedNs(0)
+    , m_probePostedFrame(0)
+    , m_probeActive(false)
+    , m_probeNs(0)
+    , m_probeFrame(0)
 {
     //qDebug() << Q_FUNC_INFO;
-    if (format.isValid()) {
-        m_format = format;
-        m_attackTime = (quint64) (0.02 * format.sampleRate()); // Время атаки 20 мс
-        m_releaseTime = m_attackTime; // Время затухания равно времени атаки
-        m_envelDelta = 1.0 / m_attackTime; // Шаг изменения громкости
+    // Все голоса свободны, огибающие в состоянии "тишина"
+    for (int i = 0; i < MaxVoices; ++i) {
+        Voice &voice = m_voices[i];
+        voice.table = Wavetable::mipTable(m_initProgram.tables, 0);
+        voice.program = &m_initProgram;
+        voice.phase = 0;
+        voice.phaseDelta = 0;
+        voice.zone = nullptr;
+        voice.samplePos = 0;
+        voice.sampleStep = 0;
+        voice.velocity = 0.0f;
+        voice.sustained = false;
+        voice.envelope.reset();
+        voice.note = -1;
+        voice.startOrder = 0;
+        voice.glide.reset(0.0f);
+    }
+    for (int i = 0; i < EventPorts; ++i) {
+        m_lastPostedFrame[i] = 0;
+    }
+    for (int i = 0; i < Parameters; ++i) {
+        m_parameterTargets[i].store(parameterRanges[i].initial, std::memory_order_relaxed);
+        m_polledTargets[i] = parameterRanges[i].initial;
+    }
+    // Неподдерживаемый формат: синтезатор все равно должен быть настроен
+    // (частота часов, строй, огибающие), поэтому берется float моно 44100 Гц
+    if (!setFormat(format)) {
+        setFormat(makeFormat(44100, 1, RenderKernels::SampleFormat::float32));
+    }
+}
+
+// Смена формата вывода. Параметры, зависящие от частоты дискретизации,
+// пересчитываются, звучащие голоса перестраиваются. Формат с числом каналов
+// вне 1..MaxChannels отклоняется, а не урезается: размер кадра вывода должен
+// совпадать с форматом устройства
+bool ToneSynthesizer::setFormat(const QAudioFormat &format)
+{
+    RenderKernels::SampleFormat type;
+    if (!isFormatSupported(format, &type)) {
+        return false;
+    }
+    m_format = format;
+    m_convert = RenderKernels::converter(type);
+    m_channels = format.channelCount();
+    m_frameBytes = format.bytesPerFrame();
+    m_initProgram.envelope.setSampleRate(format.sampleRate());
+    m_initProgram.effects.setSampleRate(format.sampleRate());
+    if (m_patches) {
+        m_patches->setSampleRate(format.sampleRate());
+    }
+    m_volume.setTime(volumeRampMs, format.sampleRate());
+    m_octave.setTime(m_glideMs, format.sampleRate());
+    m_tuning.build(format.sampleRate(), m_tuning.referenceHz(), m_tuning.temperament());
+    for (int i = 0; i < m_activeCount; ++i) {
+        tuneVoice(m_voices[m_activeList[i]]);
+    }
+    m_clockRate.store(format.sampleRate(), std::memory_order_relaxed);
+    return true;
+}
+
+bool ToneSynthesizer::sampleFormat(const QAudioFormat &format, RenderKernels::SampleFormat *sampleFormat)
+{
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    if (format.codec() != "audio/pcm"
+        || format.byteOrder() != QAudioFormat::Endian(QSysInfo::ByteOrder)) {
+        return false;
+    }
+    if (format.sampleType() == QAudioFormat::Float && format.sampleSize() == 32) {
+        *sampleFormat = RenderKernels::SampleFormat::float32;
+    } else if (format.sampleType() == QAudioFormat::SignedInt && format.sampleSize() == 16) {
+        *sampleFormat = RenderKernels::SampleFormat::int16;
+    } else if (format.sampleType() == QAudioFormat::SignedInt && format.sampleSize() == 32) {
+        *sampleFormat = RenderKernels::SampleFormat::int32;
+    } else {
+        return false;
+    }
+#else
+    switch (format.sampleFormat()) {
+    case QAudioFormat::Int16:
+        *sampleFormat = RenderKernels::SampleFormat::int16;
+        break;
+    case QAudioFormat::Int32:
+        *sampleFormat = RenderKernels::SampleFormat::int32;
+        break;
+    case QAudioFormat::Float:
+        *sampleFormat = RenderKernels::SampleFormat::float32;
+        break;
+    default:
+        return false;
     }
+#endif
+    return true;
+}
+
+bool ToneSynthesizer::isFormatSupported(const QAudioFormat &format, RenderKernels::SampleFormat *type)
+{
+    RenderKernels::SampleFormat sample;
+    return format.sampleRate() > 0 && format.channelCount() >= 1
+           && format.channelCount() <= MaxChannels && sampleFormat(format, type ? type : &sample);
+}
+
+QAudioFormat ToneSynthesizer::makeFormat(int sampleRate, int channels, RenderKernels::SampleFormat sampleFormat)
+{
+    QAudioFormat format;
+    format.setSampleRate(sampleRate);
+    format.setChannelCount(channels);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    format.setCodec("audio/pcm");
+    format.setByteOrder(QAudioFormat::Endian(QSysInfo::ByteOrder));
+    switch (sampleFormat) {
+    case RenderKernels::SampleFormat::int16:
+        format.setSampleType(QAudioFormat::SignedInt);
+        format.setSampleSize(16);
+        break;
+    case RenderKernels::SampleFormat::int32:
+        format.setSampleType(QAudioFormat::SignedInt);
+        format.setSampleSize(32);
+        break;
+    case RenderKernels::SampleFormat::float32:
+        format.setSampleType(QAudioFormat::Float);
+        format.setSampleSize(32);
+        break;
+    }
+#else
+    switch (sampleFormat) {
+    case RenderKernels::SampleFormat::int16:
+        format.setSampleFormat(QAudioFormat::Int16);
+        break;
+    case RenderKernels::SampleFormat::int32:
+        format.setSampleFormat(QAudioFormat::Int32);
+        break;
+    case RenderKernels::SampleFormat::float32:
+        format.setSampleFormat(QAudioFormat::Float);
+        break;
+    }
+#endif
+    return format;
 }
 
 // Запуск синтезатора
@@ -35,113 +248,956 @@ void ToneSynthesizer::stop()
     }
 }
 
-// Включение ноты
-void ToneSynthesizer::noteOn(const QString &note)
+// Монотонное время в наносекундах
+qint64 ToneSynthesizer::monotonicNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Сэмпл, с которого вступит в силу событие, отправленное сейчас
+quint64 ToneSynthesizer::scheduleFrame() const
+{
+    return frameAtTime(monotonicNs());
+}
+
+// Сэмпл для события с меткой времени timeNs. События сдвигаются на длину одного
+// блока: время, прошедшее с начала последнего блока, переносится внутрь следующего,
+// поэтому дрожание меньше сэмпла, а задержка постоянна
+quint64 ToneSynthesizer::frameAtTime(qint64 timeNs) const
+{
+    quint32 seq;
+    qint64 clockNs;
+    quint64 clockFrame, clockFrames;
+    do {
+        seq = m_clockSeq.load(std::memory_order_acquire);
+        clockNs = m_clockNs.load(std::memory_order_relaxed);
+        clockFrame = m_clockFrame.load(std::memory_order_relaxed);
+        clockFrames = m_clockFrames.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != m_clockSeq.load(std::memory_order_relaxed));
+
+    const qint64 elapsed = qMax<qint64>(0, timeNs - clockNs);
+    const quint64 offset = quint64(double(elapsed) * m_clockRate.load(std::memory_order_relaxed) / 1e9);
+    return clockFrame + clockFrames + qMin(offset, qMax<quint64>(clockFrames, 1) - 1);
+}
+
+// Постановка события в очередь источника. Метки одного писателя не убывают
+bool ToneSynthesizer::postEvent(const SynthEvent &event, EventPort port)
+{
+    const int index = int(port);
+    SynthEvent stamped = event;
+    stamped.frame = qMax(stamped.frame, m_lastPostedFrame[index]);
+    if (!m_events[index].push(stamped)) {
+        return false;
+    }
+    m_lastPostedFrame[index] = stamped.frame;
+    return true;
+}
+
+// Отправка события ноты с текущей временной меткой
+void ToneSynthesizer::postNoteEvent(SynthEvent::Type type, int note, float value)
+{
+    SynthEvent event;
+    event.frame = scheduleFrame();
+    event.type = type;
+    event.note = quint8(qMax(note, 0));
+    event.value = value;
+    postEvent(event);
+}
+
+// Выбор голоса для новой ноты. Память не выделяется: сначала ищется голос с той же
+// нотой, затем свободный, иначе крадется самый тихий из затухающих или самый старый
+ToneSynthesizer::Voice *ToneSynthesizer::allocateVoice(int note)
+{
+    for (int i = 0; i < m_activeCount; ++i) {
+        Voice &voice = m_voices[m_activeList[i]];
+        if (voice.note == note) {
+            return &voice;
+        }
+    }
+    if (m_activeCount < MaxVoices) {
+        for (int i = 0; i < MaxVoices; ++i) {
+            if (!m_voices[i].envelope.isActive()) {
+                m_activeList[m_activeCount++] = i;
+                return &m_voices[i];
+            }
+        }
+    }
+    Voice *victim = nullptr;
+    for (int i = 0; i < m_activeCount; ++i) {
+        Voice &voice = m_voices[m_activeList[i]];
+        if (voice.envelope.isReleased()) {
+            if (!victim || !victim->envelope.isReleased()
+                || voice.envelope.level() < victim->envelope.level()) {
+                victim = &voice;
+            }
+        } else if (!victim
+                   || (!victim->envelope.isReleased()
+                       && voice.startOrder < victim->startOrder)) {
+            victim = &voice;
+        }
+    }
+    return victim;
+}
+
+// Удаление голоса из списка звучащих (порядок списка не сохраняется)
+void ToneSynthesizer::releaseVoice(int index)
 {
-    // Если нота есть в словаре частот
-    if (m_freq.contains(note)) {
-        // Вычисляем частоту ноты с учетом октавы
-        qreal noteFreq = qPow(2, m_octave - 3) * m_freq[note];
-        // Вычисляем приращение фазы за сэмпл
-        qreal cyclesPerSample = noteFreq / m_format.sampleRate();
-        m_angleDelta = cyclesPerSample * 2.0 * M_PI;
-        m_currentAngle = 0.0;  // Сбрасываем текущую фазу
+    Voice &voice = m_voices[m_activeList[index]];
+    if (voice.zone) {
+        m_streamer->release(m_activeList[index]);
+        voice.zone = nullptr;
+    }
+    voice.note = -1;
+    m_activeList[index] = m_activeList[--m_activeCount];
+}
 
-        m_envelState = EnvelopeState::attackState; // Переходим в состояние атаки
-        m_envelCount = m_attackTime; // Устанавливаем счетчик сэмплов атаки
-        m_envelVolume = 0.0; // Начальная громкость 0
+// Включение ноты (поток GUI)
+void ToneSynthesizer::noteOn(int note, float velocity)
+{
+    // Если номер в диапазоне MIDI
+    if (note >= 0 && note < NoteTuning::Notes) {
+        postNoteEvent(SynthEvent::Type::noteOn, note, velocity);
     }
 }
 
-// Выключение ноты
-void ToneSynthesizer::noteOff()
+// Выключение ноты (поток GUI)
+void ToneSynthesizer::noteOff(int note)
 {
-    //    qDebug() << Q_FUNC_INFO
-    //             << "last synth period:"
-    //             << m_lastBufferSize << "bytes,"
-    //             << m_format.durationForBytes(m_lastBufferSize) / 1000
-    //             << "milliseconds";
-    m_envelState = EnvelopeState::releaseState; // Переходим в состояние затухания
-    m_envelCount = m_releaseTime;
+    if (note >= 0 && note < NoteTuning::Notes) {
+        postNoteEvent(SynthEvent::Type::noteOff, note, 0.0f);
+    }
 }
 
-// Получение размера последнего сгенерированного буфера
-qint64 ToneSynthesizer::lastBufferSize() const
+// Выключение всех звучащих нот (поток GUI)
+void ToneSynthesizer::allNotesOff()
 {
-    return m_lastBufferSize;
+    postNoteEvent(SynthEvent::Type::allNotesOff, 0, 0.0f);
 }
 
-// Сброс размера последнего сгенерированного буфера
-void ToneSynthesizer::resetLastBufferSize()
+// Выбор программы (поток GUI)
+void ToneSynthesizer::selectProgram(int program)
 {
-    m_lastBufferSize = 0;
+    if (program >= PatchBank::MaxPrograms) {
+        return;
+    }
+    postNoteEvent(SynthEvent::Type::program, (program < 0) ? SynthEvent::NoProgram : program, 0.0f);
 }
 
-// Установка октавы
-void ToneSynthesizer::setOctave(int newOctave)
+// Применение события из очереди (поток звука)
+void ToneSynthesizer::applyEvent(const SynthEvent &event)
 {
-    m_octave = newOctave;
+    switch (event.type) {
+    case SynthEvent::Type::noteOn:
+        startVoice(event.note, event.value);
+        break;
+    case SynthEvent::Type::noteOff:
+        stopVoice(event.note);
+        break;
+    case SynthEvent::Type::allNotesOff:
+        stopAllVoices();
+        break;
+    case SynthEvent::Type::waveform:
+        m_initProgram.tables = m_wavetable.tables(Wavetable::Waveform(event.note));
+        applyProgram(SynthEvent::NoProgram);
+        break;
+    case SynthEvent::Type::pitchBend:
+        // Изгиб действует на все звучащие голоса канала
+        m_bendFactor = qPow(2.0, qBound(-1.0f, event.value, 1.0f) * PitchBendRange / 12.0);
+        for (int i = 0; i < m_activeCount; ++i) {
+            tuneVoice(m_voices[m_activeList[i]]);
+        }
+        break;
+    case SynthEvent::Type::tuning:
+        // Смена строя пересчитывает таблицу и перестраивает звучащие голоса
+        m_tuning.build(m_format.sampleRate(), event.value, NoteTuning::Temperament(event.note));
+        for (int i = 0; i < m_activeCount; ++i) {
+            tuneVoice(m_voices[m_activeList[i]]);
+        }
+        break;
+    case SynthEvent::Type::controlChange:
+        applyController(event.note, event.value);
+        break;
+    case SynthEvent::Type::parameter:
+        if (event.note < Parameters) {
+            applyParameter(Parameter(event.note), event.value);
+        }
+        break;
+    case SynthEvent::Type::program:
+        applyProgram(event.note);
+        break;
+    case SynthEvent::Type::legato:
+        legatoVoice(event.source, event.note, event.value);
+        break;
+    }
+}
+
+// Смена программы (поток звука): только замена указателя и очистка хвостов
+// обработки новой программы. Звучащие голоса доигрывают со своей программой
+void ToneSynthesizer::applyProgram(int program)
+{
+    SynthProgram *next = &m_initProgram;
+    if (program != SynthEvent::NoProgram) {
+        if (!m_patches || program >= m_patches->count()) {
+            return; // Нет такой программы: остается прежняя
+        }
+        next = m_patches->program(program);
+    }
+    if (next != m_program) {
+        next->effects.reset();
+        m_program = next;
+    }
+}
+
+// Контроллеры MIDI: громкость канала, педаль удержания и режимы канала
+void ToneSynthesizer::applyController(int controller, float value)
+{
+    switch (controller) {
+    case 7: // Громкость канала
+        applyParameter(Parameter::volume, value);
+        break;
+    case 64: // Педаль удержания
+        setSustainPedal(value >= 0.5f);
+        break;
+    case 120: // Выключение всех звуков
+    case 123: // Выключение всех нот
+        setSustainPedal(false);
+        stopAllVoices();
+        break;
+    case 121: // Сброс контроллеров
+        applyParameter(Parameter::volume, 1.0f);
+        setSustainPedal(false);
+        m_bendFactor = 1.0;
+        for (int i = 0; i < m_activeCount; ++i) {
+            tuneVoice(m_voices[m_activeList[i]]);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Новые цели параметров из других потоков (в начале блока). Подхватывается
+// только изменившаяся цель, поэтому события автоматизации ею не перекрываются
+void ToneSynthesizer::pollParameters()
+{
+    for (int i = 0; i < Parameters; ++i) {
+        const float target = m_parameterTargets[i].load(std::memory_order_relaxed);
+        if (target != m_polledTargets[i]) {
+            m_polledTargets[i] = target;
+            applyParameter(Parameter(i), target);
+        }
+    }
+}
+
+// Новая цель параметра (поток звука): переход начинается с текущего значения
+void ToneSynthesizer::applyParameter(Parameter parameter, float value)
+{
+    const ParameterRange &range = parameterRanges[int(parameter)];
+    value = qBound(range.minimum, value, range.maximum);
+    switch (parameter) {
+    case Parameter::volume:
+        m_volume.setTarget(value);
+        break;
+    case Parameter::octave:
+        m_octave.setTarget(value);
+        break;
+    case Parameter::glide:
+        m_glideMs = value;
+        m_octave.setTime(m_glideMs, m_format.sampleRate());
+        break;
+    }
+}
+
+// Транспонирование на время отрезка. Голоса перестраиваются, только пока
+// высота переходит к цели
+void ToneSynthesizer::updatePitch(int frames)
+{
+    if (m_octave.value() != m_tunedOctave) {
+        m_tunedOctave = m_octave.value();
+        m_octaveFactor = qPow(2.0, m_tunedOctave);
+        for (int i = 0; i < m_activeCount; ++i) {
+            tuneVoice(m_voices[m_activeList[i]]);
+        }
+    }
+    m_octave.advance(frames);
+    // Голоса легато: высота отрезка - по его концу, чтобы переход кончался точно на ноте
+    for (int i = 0; i < m_activeCount; ++i) {
+        Voice &voice = m_voices[m_activeList[i]];
+        if (voice.glide.isSmoothing()) {
+            voice.glide.advance(frames);
+            tuneVoice(voice);
+        }
+    }
+}
+
+// Громкость на отрезке: линейно между значениями на его границах
+void ToneSynthesizer::applyVolume(float *out, int frames)
+{
+    const float start = m_volume.value();
+    const float end = m_volume.advance(frames);
+    if (start == 1.0f && end == 1.0f) {
+        return;
+    }
+    const float step = (end - start) / float(frames);
+    for (int i = 0; i < frames; ++i) {
+        out[i] *= start + step * float(i + 1);
+    }
+}
+
+// Отпускание педали переводит удержанные ноты в затухание
+void ToneSynthesizer::setSustainPedal(bool down)
+{
+    m_sustainPedal = down;
+    if (down) {
+        return;
+    }
+    for (int i = 0; i < m_activeCount; ++i) {
+        Voice &voice = m_voices[m_activeList[i]];
+        if (voice.sustained) {
+            voice.sustained = false;
+            voice.envelope.release(voice.program->envelope, m_blockFrames);
+        }
+    }
+}
+
+// Приращение фазы и таблица голоса по номеру ноты, изгибу, транспонированию
+// и переходу легато
+void ToneSynthesizer::tuneVoice(Voice &voice) const
+{
+    quint32 delta = m_tuning.increment(voice.note);
+    qreal factor = m_bendFactor * m_octaveFactor;
+    if (voice.glide.value() != 0.0f) {
+        factor *= qPow(2.0, voice.glide.value() / 12.0);
+    }
+    if (factor != 1.0) {
+        delta = quint32(qMin(delta * factor, 2147483648.0)); // Не выше частоты Найквиста
+    }
+    // При передискретизации шаг фазы меньше, а ступень таблицы - богаче гармониками
+    voice.phaseDelta = delta / quint32(m_oversampling);
+    voice.table = Wavetable::mipTable(voice.program->tables, voice.phaseDelta);
+    if (voice.zone) {
+        // Шаг по сэмплу: отношение частот ноты и корневой ноты с поправкой на частоты дискретизации
+        const SampleZone &zone = *voice.zone;
+        const qreal ratio = m_tuning.frequency(voice.note) / m_tuning.frequency(zone.rootNote) * factor
+                            * zone.sampleRate / (m_format.sampleRate() * m_oversampling);
+        voice.sampleStep = quint64(qMin(ratio, maxSampleStep) * 4294967296.0);
+    }
+}
+
+// Первая зона программы для ноты и громкости нажатия
+const SampleZone *ToneSynthesizer::findZone(int note, float velocity) const
+{
+    const int level = qBound(1, qRound(velocity * 127.0f), 127);
+    const QVector<SampleZone> &zones = m_program->zones;
+    for (const SampleZone &zone : zones) {
+        if (note >= zone.lowNote && note <= zone.highNote && level >= zone.lowVelocity
+            && level <= zone.highVelocity) {
+            return &zone;
+        }
+    }
+    return nullptr;
+}
+
+// Запуск голоса
+void ToneSynthesizer::startVoice(int note, float velocity)
+{
+    // Нота вне зон программы сэмплера не звучит
+    const SampleZone *zone = nullptr;
+    if (!m_program->zones.isEmpty()) {
+        zone = findZone(note, velocity);
+        if (!zone) {
+            return;
+        }
+    }
+    Voice *voice = allocateVoice(note);
+    voice->note = note;
+    voice->program = m_program;
+    // Сэмпл звучит с начала, поток голоса начинает подкачку заново
+    if (zone) {
+        m_streamer->restart(int(voice - m_voices), zone);
+    } else if (voice->zone) {
+        m_streamer->release(int(voice - m_voices));
+    }
+    voice->zone = zone;
+    voice->samplePos = 0;
+    voice->glide.reset(0.0f); // Украденный голос не продолжает чужой переход
+    tuneVoice(*voice); // Вычисляем частоту ноты и приращение фазы за сэмпл
+    if (!voice->envelope.isActive()) {
+        voice->phase = 0; // Звучащий голос (повтор ноты, кража) продолжает фазу без разрыва
+    }
+    voice->velocity = velocity * m_program->gain;
+    voice->sustained = false;
+    voice->startOrder = ++m_noteCounter;
+    m_silent = false;
+    // Атака начинается с текущего уровня огибающей, а не с нуля: без щелчка
+    voice->envelope.trigger(m_program->envelope, m_blockFrames);
+}
+
+// Легато (поток звука): голос ноты source переходит на note без новой атаки,
+// высота скользит от прежней ноты за время glide (0 - сразу). Голос сэмплера
+// остается в своей зоне и транспонирует ее. Нет такого голоса (отпущен или
+// украден) - нота включается обычным образом
+void ToneSynthesizer::legatoVoice(int source, int note, float velocity)
+{
+    for (int i = 0; i < m_activeCount; ++i) {
+        Voice &voice = m_voices[m_activeList[i]];
+        if (voice.note == source && !voice.envelope.isReleased()) {
+            // Незаконченный переход продолжается с текущей высоты
+            voice.glide.setTime(m_glideMs, m_format.sampleRate());
+            voice.glide.reset(voice.glide.value() + float(source - note));
+            voice.glide.setTarget(0.0f);
+            voice.note = note;
+            tuneVoice(voice);
+            return;
+        }
+    }
+    startVoice(note, velocity);
+}
+
+// Перевод голосов ноты в затухание
+void ToneSynthesizer::stopVoice(int note)
+{
+    for (int i = 0; i < m_activeCount; ++i) {
+        Voice &voice = m_voices[m_activeList[i]];
+        if (voice.note == note && !voice.envelope.isReleased()) {
+            if (m_sustainPedal) {
+                voice.sustained = true; // Затухание начнется при отпускании педали
+                continue;
+            }
+            voice.envelope.release(voice.program->envelope, m_blockFrames); // Переходим к затуханию
+        }
+    }
+}
+
+// Перевод всех голосов в затухание
+void ToneSynthesizer::stopAllVoices()
+{
+    for (int i = 0; i < m_activeCount; ++i) {
+        Voice &voice = m_voices[m_activeList[i]];
+        voice.sustained = false;
+        voice.envelope.release(voice.program->envelope, m_blockFrames);
+    }
+}
+
+// Заявка на замер задержки (поток GUI): поток звука подхватит ее в начале
+// следующего вызова render()
+void ToneSynthesizer::probeLatency(qint64 timeNs, quint64 frame)
+{
+    m_probePostedNs.store(timeNs, std::memory_order_relaxed);
+    m_probePostedFrame.store(frame, std::memory_order_relaxed);
+    m_probePosted.store(true, std::memory_order_release);
+}
+
+// Ограничение опережения генерации относительно воспроизведения (поток GUI)
+void ToneSynthesizer::setOutputLimit(qint64 deviceBufferBytes, qint64 targetBytes)
+{
+    m_deviceBufferBytes.store(deviceBufferBytes, std::memory_order_relaxed);
+    m_targetBytes.store(targetBytes, std::memory_order_relaxed);
+}
+
+// Показатели работы readData()
+AudioTelemetry &ToneSynthesizer::telemetry()
+{
+    return m_telemetry;
+}
+
+// Количество звучащих голосов
+int ToneSynthesizer::activeVoices() const
+{
+    return m_voicesInUse.load(std::memory_order_relaxed);
+}
+
+// Новая цель параметра (любой поток)
+void ToneSynthesizer::setParameter(Parameter parameter, float value)
+{
+    const ParameterRange &range = parameterRanges[int(parameter)];
+    m_parameterTargets[int(parameter)].store(qBound(range.minimum, value, range.maximum),
+                                             std::memory_order_relaxed);
+}
+
+float ToneSynthesizer::parameter(Parameter parameter) const
+{
+    return m_parameterTargets[int(parameter)].load(std::memory_order_relaxed);
+}
+
+QString ToneSynthesizer::parameterName(Parameter parameter)
+{
+    return QString(parameterRanges[int(parameter)].name);
+}
+
+bool ToneSynthesizer::parseParameter(const QString &name, Parameter *parameter)
+{
+    for (int i = 0; i < Parameters; ++i) {
+        if (name == parameterRanges[i].name) {
+            *parameter = Parameter(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Выбор формы волны для следующих нот (поток GUI)
+void ToneSynthesizer::setWaveform(Wavetable::Waveform waveform)
+{
+    SynthEvent event;
+    event.frame = scheduleFrame();
+    event.type = SynthEvent::Type::waveform;
+    event.note = quint8(waveform);
+    event.value = 0.0f;
+    postEvent(event);
+}
+
+// Выбор строя и частоты A4 (поток GUI). Таблица пересчитывается потоком звука
+void ToneSynthesizer::setTuning(qreal referenceHz, NoteTuning::Temperament temperament)
+{
+    SynthEvent event;
+    event.frame = scheduleFrame();
+    event.type = SynthEvent::Type::tuning;
+    event.note = quint8(temperament);
+    event.value = float(referenceHz);
+    postEvent(event);
+}
+
+// Генерация одного голоса с добавлением к содержимому буфера. Уровень огибающей
+// вычисляется на границах отрезков, внутри отрезка он линейный, поэтому отрезок
+// целиком передается векторному ядру
+void ToneSynthesizer::renderVoice(Voice &voice, float *out, int frames)
+{
+    const float gain = voice.velocity;
+    const int factor = m_oversampling; // Огибающая идет по сэмплам вывода, генератор - в factor раз чаще
+    int pos = 0;
+    while (pos < frames && voice.envelope.isActive()) {
+        const int count = voice.envelope.segment(frames - pos);
+        const float start = voice.envelope.level();
+        const float step = (voice.envelope.advance(voice.program->envelope, count) - start) / float(count * factor);
+        // Громкость обновляется до вычисления сэмпла, как в пошаговой огибающей
+        if (voice.zone) {
+            renderSample(voice, out + pos * factor, count * factor, gain * (start + step), gain * step);
+        } else {
+            m_oscillator(out + pos * factor,
+                         count * factor,
+                         voice.table,
+                         &voice.phase,
+                         voice.phaseDelta,
+                         gain * (start + step),
+                         gain * step);
+        }
+        pos += count;
+    }
+    // Сэмпл без петли кончился или затухание стало неслышным: голос
+    // освобождается, не дожидаясь конца огибающей
+    if ((voice.zone && voice.zone->isFinished(voice.samplePos >> 32))
+        || voice.envelope.hasFaded(voice.program->envelope, retireLevel / qMax(gain, retireLevel))) {
+        voice.envelope.reset();
+    }
+}
+
+// Сэмпл голоса с кубической интерполяцией Эрмита по четырем соседним кадрам.
+// Кадры собираются в буфер потока голоса (начало - из памяти, продолжение -
+// из подкачки) отрезками, которые в этот буфер помещаются
+void ToneSynthesizer::renderSample(Voice &voice, float *out, int frames, float gain, float gainStep)
+{
+    const int stream = int(&voice - m_voices);
+    const quint64 step = voice.sampleStep;
+    const int maxCount = int((quint64(SampleStreamer::GatherFrames - 5) << 32) / (step + 1));
+    for (int pos = 0; pos < frames;) {
+        const int count = qMin(frames - pos, maxCount);
+        const quint64 base = voice.samplePos >> 32;
+        const quint64 last = (voice.samplePos + quint64(count - 1) * step) >> 32;
+        const float *frame = m_streamer->gather(stream, qint64(base) - 1, int(last - base) + 4);
+        quint64 position = voice.samplePos;
+        for (int i = 0; i < count; ++i) {
+            const float *x = frame + ((position >> 32) - base); // x[1] - кадр позиции
+            const float t = float(quint32(position)) * (1.0f / 4294967296.0f);
+            const float c1 = 0.5f * (x[2] - x[0]);
+            const float c2 = x[0] - 2.5f * x[1] + 2.0f * x[2] - 0.5f * x[3];
+            const float c3 = 0.5f * (x[3] - x[0]) + 1.5f * (x[1] - x[2]);
+            out[pos + i] += (gain + float(i) * gainStep) * (((c3 * t + c2) * t + c1) * t + x[1]);
+            position += step;
+        }
+        voice.samplePos = position;
+        gain += float(count) * gainStep;
+        pos += count;
+    }
+    m_streamer->consume(stream, qint64(voice.samplePos >> 32) - 1);
+}
+
+// Смешивание всех звучащих голосов в буфер
+void ToneSynthesizer::renderVoices(float *out, int frames)
+{
+    // Мелкие отрезки быстрее сгенерировать в одном потоке, чем синхронизировать пул
+    if (!m_pool.isNull() && m_activeCount > VoicesPerTask && m_activeCount * frames >= ParallelMinWork) {
+        renderVoicesParallel(out, frames);
+        return;
+    }
+    for (int i = 0; i < m_activeCount;) {
+        Voice &voice = m_voices[m_activeList[i]];
+        renderVoice(voice, out, frames);
+        if (!voice.envelope.isActive()) {
+            releaseVoice(i); // На место i встает последний голос списка
+        } else {
+            ++i;
+        }
+    }
+}
+
+// Смешивание голосов несколькими потоками: каждая задача смешивает свою группу
+// голосов в свой буфер, затем буферы складываются в порядке задач. Состав групп
+// задан списком голосов, поэтому результат не зависит от числа потоков
+// и распределения задач между ними
+void ToneSynthesizer::renderVoicesParallel(float *out, int frames)
+{
+    const int tasks = (m_activeCount + VoicesPerTask - 1) / VoicesPerTask;
+    const int samples = frames * m_oversampling;
+    m_taskFrames = frames;
+    m_pool->run(&ToneSynthesizer::renderVoiceTask, this, tasks);
+    // Отрезок вывода (до 4 КБ) остается в кэше L1, буферы задач читаются по одному разу
+    for (int i = 0; i < tasks; ++i) {
+        const float *partial = m_partials[i];
+        for (int j = 0; j < samples; ++j) {
+            out[j] += partial[j];
+        }
+    }
+    for (int i = 0; i < m_activeCount;) {
+        if (!m_voices[m_activeList[i]].envelope.isActive()) {
+            releaseVoice(i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+// Задача пула: смесь VoicesPerTask голосов списка в буфер задачи
+void ToneSynthesizer::renderVoiceTask(void *context, int task)
+{
+    ToneSynthesizer *synth = static_cast<ToneSynthesizer *>(context);
+    const int frames = synth->m_taskFrames;
+    float *partial = synth->m_partials[task];
+    std::fill(partial, partial + frames * synth->m_oversampling, 0.0f);
+    const int end = qMin(synth->m_activeCount, (task + 1) * VoicesPerTask);
+    for (int i = task * VoicesPerTask; i < end; ++i) {
+        synth->renderVoice(synth->m_voices[synth->m_activeList[i]], partial, frames);
+    }
+}
+
+// Самое раннее событие среди очередей источников (при равных метках - GUI)
+const SynthEvent *ToneSynthesizer::nextEvent(int *port) const
+{
+    const SynthEvent *next = nullptr;
+    for (int i = 0; i < EventPorts; ++i) {
+        const SynthEvent *event = m_events[i].front();
+        if (event && (!next || event->frame < next->frame)) {
+            next = event;
+            *port = i;
+        }
+    }
+    return next;
+}
+
+// Генерация одного блока (не больше m_blockFrames сэмплов), начинающегося
+// с m_framePosition. Блок делится на отрезки по меткам событий: каждое событие
+// применяется точно на своем сэмпле, события из прошлого - в начале блока
+void ToneSynthesizer::renderBlock(float *out, int frames)
+{
+    std::fill(out, out + frames, 0.0f);
+    pollParameters();
+    if (m_program->oversampling != m_oversampling) {
+        setRenderOversampling(m_program->oversampling);
+    }
+    const quint64 blockStart = m_framePosition;
+    int pos = 0;
+    while (pos < frames) {
+        int end = frames;
+        int port = 0;
+        while (const SynthEvent *event = nextEvent(&port)) {
+            if (event->frame > blockStart + quint64(pos)) {
+                end = int(qMin<quint64>(quint64(frames), event->frame - blockStart));
+                break;
+            }
+            applyEvent(*event);
+            m_events[port].pop();
+        }
+        updatePitch(end - pos);
+        if (m_oversampling > 1) {
+            // Фильтр понижения частоты хранит состояние, поэтому отрезки можно
+            // прореживать по одному
+            std::fill(m_overBuffer, m_overBuffer + (end - pos) * m_oversampling, 0.0f);
+            renderVoices(m_overBuffer, end - pos);
+            m_decimator.process(m_overBuffer, out + pos, end - pos);
+        } else {
+            renderVoices(out + pos, end - pos);
+        }
+        applyVolume(out + pos, end - pos);
+        pos = end;
+    }
+    m_framePosition = blockStart + quint64(frames);
 }
 
 // Чтение данных из устройства (основной метод генерации звука)
 qint64 ToneSynthesizer::readData(char *data, qint64 maxlen)
 {
     //qDebug() << Q_FUNC_INFO << maxlen;
-    const qint64 channelBytes =
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-        m_format.sampleSize() / CHAR_BIT;
-#else
-        m_format.bytesPerSample();
-#endif
-    Q_ASSERT(channelBytes > 0);
-    // Выравниваем длину по размеру сэмпла
-    qint64 length = (maxlen / channelBytes) * channelBytes;
-    qint64 buflen = length;
-    // Приводим указатель на данные к типу unsigned char*
-    unsigned char *ptr = reinterpret_cast<unsigned char *>(data);
-
-    // Цикл по сэмплам
-    while (length > 0) { // Текущий сэмпл
-        // Генерация огибающей
-        float currentSample = 0.0;
-         // Генерация огибающей
-        switch (m_envelState) {
-        case EnvelopeState::silentState:
-            break;
-        case EnvelopeState::attackState:
-            if (m_envelCount > 0) {
-                m_envelVolume += m_envelDelta;
-                m_envelCount--;
-            } else {
-                m_envelVolume = 1.0;
-                m_envelState = EnvelopeState::sustainState;
-            }
-            break;
-        case EnvelopeState::sustainState:
-            break;
-        case EnvelopeState::releaseState:
-            if (m_envelCount > 0) {
-                m_envelVolume -= m_envelDelta;
-                m_envelCount--;
-            } else {
-                m_envelVolume = 0.0;
-                m_envelState = EnvelopeState::silentState;
+    const qint64 startNs = monotonicNs();
+    m_telemetry.callbackStarted(startNs, maxlen);
+    const qint64 length = outputRequest(maxlen);
+    const qint64 frames = length / m_frameBytes;
+    render(data, frames);
+    m_telemetry.callbackFinished(frames, frames * 1000000000ll / m_format.sampleRate());
+    return length;
+}
+
+// Сколько байт отдать устройству на запрос maxlen. Устройство запрашивает свободное
+// место своего буфера, значит в нем уже лежит deviceBuffer - maxlen байт. Отдаем
+// только добавку до целевого заполнения, но не меньше одного блока, чтобы вывод
+// не счел поток законченным. Результат кратен размеру кадра
+qint64 ToneSynthesizer::outputRequest(qint64 maxlen) const
+{
+    const qint64 frameBytes = m_frameBytes;
+    Q_ASSERT(frameBytes > 0);
+    qint64 request = maxlen;
+    const qint64 targetBytes = m_targetBytes.load(std::memory_order_relaxed);
+    const qint64 deviceBufferBytes = m_deviceBufferBytes.load(std::memory_order_relaxed);
+    if (targetBytes > 0 && deviceBufferBytes > 0) {
+        const qint64 queued = qMax<qint64>(0, deviceBufferBytes - maxlen);
+        request = qBound(qMin<qint64>(BlockFrames * frameBytes, maxlen), targetBytes - queued, maxlen);
+    }
+    // Выравниваем длину по размеру кадра
+    return (request / frameBytes) * frameBytes;
+}
+
+// Генерация frames кадров в формате устройства (readData() или поток генерации)
+qint64 ToneSynthesizer::render(char *data, qint64 frames)
+{
+    const qint64 frameBytes = m_frameBytes;
+    const qint64 startNs = monotonicNs();
+
+    // Публикуем привязку позиции блока ко времени для scheduleFrame()
+    const quint32 seq = m_clockSeq.load(std::memory_order_relaxed);
+    m_clockSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_clockNs.store(startNs, std::memory_order_relaxed);
+    m_clockFrame.store(m_framePosition, std::memory_order_relaxed);
+    m_clockFrames.store(quint64(frames), std::memory_order_relaxed);
+    m_clockSeq.store(seq + 2, std::memory_order_release);
+
+    // Метка заявки лежит не раньше начала этого вызова, ее нота еще не включена:
+    // вывод должен молчать вместе с хвостами графа, иначе первый ненулевой
+    // сэмпл может оказаться отзвуком прежних нот
+    if (m_probePosted.exchange(false, std::memory_order_acquire)) {
+        m_probeNs = m_probePostedNs.load(std::memory_order_relaxed);
+        m_probeFrame = m_probePostedFrame.load(std::memory_order_relaxed);
+        m_probeActive = m_silent;
+    }
+
+    // Генерация блоками фиксированного размера во float (моно), смесь проходит
+    // граф обработки, результат переводится в формат устройства с повторением
+    // по каналам. Пока нет голосов и хвосты графа затихли, вывод до следующего
+    // события - нули одним memset (нулевые байты - ноль во всех форматах)
+    for (qint64 pos = 0; pos < frames;) {
+        if (m_silent) {
+            const qint64 count = silentFrames(frames - pos);
+            if (count > 0) {
+                std::memset(data + pos * frameBytes, 0, size_t(count * frameBytes));
+                skipSilence(int(count));
+                pos += count;
+                continue;
             }
-            break;
         }
+        const int count = int(qMin<qint64>(m_blockFrames, frames - pos));
+        renderBlock(m_mixBuffer, count);
+        m_program->effects.process(m_mixBuffer, count);
+        if (m_probeActive) {
+            measureLatency(m_mixBuffer, pos, count, startNs);
+        }
+        if (m_activeCount == 0 && isQuiet(m_mixBuffer, count)) {
+            m_quietFrames += count;
+            m_silent = (m_quietFrames >= qMax(qint64(silenceHoldMs * m_format.sampleRate() / 1000.0),
+                                              m_program->effects.tailFrames()));
+        } else {
+            m_quietFrames = 0;
+        }
+        m_convert(m_mixBuffer, data + pos * frameBytes, count, m_channels);
+        pos += count;
+    }
+    if (AudioRecorder *recorder = m_recorder.load(std::memory_order_acquire)) {
+        recorder->capture(data, frames * frameBytes);
+    }
+    m_voicesInUse.store(m_activeCount, std::memory_order_relaxed);
+    m_telemetry.renderFinished(monotonicNs() - startNs,
+                               frames * 1000000000ll / m_format.sampleRate(),
+                               m_activeCount);
+    return frames * frameBytes;
+}
+
+// Длина тишины от текущей позиции: до первого события в очередях, не больше frames
+qint64 ToneSynthesizer::silentFrames(qint64 frames) const
+{
+    int port = 0;
+    if (const SynthEvent *event = nextEvent(&port)) {
+        return (event->frame > m_framePosition) ? qMin<qint64>(frames, qint64(event->frame - m_framePosition)) : 0;
+    }
+    return frames;
+}
+
+// Время идет и без голосов: параметры подхватываются и доходят до целей,
+// позиция событий продвигается
+void ToneSynthesizer::skipSilence(int frames)
+{
+    pollParameters();
+    updatePitch(frames);
+    m_volume.advance(frames);
+    m_framePosition += quint64(frames);
+}
+
+bool ToneSynthesizer::isQuiet(const float *buffer, int frames)
+{
+    for (int i = 0; i < frames; ++i) {
+        if (qAbs(buffer[i]) >= silenceLevel) {
+            return false;
+        }
+    }
+    return true;
+}
 
-        // Генерация синусоидального сигнала
-        if (m_envelState != EnvelopeState::silentState) {
-            currentSample = m_envelVolume * qSin(m_currentAngle); // Генерируем сэмпл синусоиды с текущей фазой и громкостью
-            m_currentAngle += m_angleDelta; // Увеличиваем фазу на приращение
+// Поиск первого сэмпла громче порога тишины начиная с метки замера в только что
+// сгенерированном блоке (offset - его положение в вызове render(), начатом в startNs)
+void ToneSynthesizer::measureLatency(const float *buffer, qint64 offset, int frames, qint64 startNs)
+{
+    const quint64 blockStart = m_framePosition - quint64(frames);
+    if (m_framePosition <= m_probeFrame) {
+        return;
+    }
+    const int sampleRate = m_format.sampleRate();
+    const int first = (m_probeFrame > blockStart) ? int(m_probeFrame - blockStart) : 0;
+    for (int i = first; i < frames; ++i) {
+        if (qAbs(buffer[i]) >= silenceLevel) {
+            m_telemetry.inputLatencyMeasured(startNs - m_probeNs + (offset + i) * 1000000000ll / sampleRate);
+            m_probeActive = false;
+            return;
         }
-        // Запись сэмпла в буфер(float)
-        *reinterpret_cast<float *>(ptr) = currentSample;
-        ptr += channelBytes; // Перемещаем указатель на следующий сэмпл
-        length -= channelBytes; // Уменьшаем оставшуюся длину
     }
-    m_lastBufferSize = buflen;
-    return buflen;
+    if (m_framePosition - m_probeFrame >= quint64(probeTimeoutMs * sampleRate / 1000.0)) {
+        m_probeActive = false;
+    }
+}
+
+// Смена огибающей голосов (устройство не читает данные)
+void ToneSynthesizer::setEnvelope(const EnvelopeShape &shape)
+{
+    m_initProgram.envelope = shape;
+    m_initProgram.envelope.setSampleRate(m_format.sampleRate());
+}
+
+const EnvelopeShape &ToneSynthesizer::envelope() const
+{
+    return m_initProgram.envelope;
+}
+
+EffectGraph &ToneSynthesizer::effects()
+{
+    return m_initProgram.effects;
+}
+
+void ToneSynthesizer::setOversampling(int factor)
+{
+    m_initProgram.oversampling = (factor >= 4) ? 4 : (factor >= 2) ? 2 : 1;
+}
+
+int ToneSynthesizer::oversampling() const
+{
+    return m_initProgram.oversampling;
+}
+
+// Смена кратности генерации (поток звука, начало блока): фильтр начинает
+// с чистого состояния, шаги голосов пересчитываются под новую частоту
+void ToneSynthesizer::setRenderOversampling(int factor)
+{
+    m_oversampling = factor;
+    m_decimator.setFactor(factor);
+    for (int i = 0; i < m_activeCount; ++i) {
+        tuneVoice(m_voices[m_activeList[i]]);
+    }
+}
+
+// Смена набора программ (устройство не читает данные). Голоса могут ссылаться
+// на программы прежнего набора, поэтому они замолкают сразу
+void ToneSynthesizer::setPatchBank(PatchBank *bank)
+{
+    for (int i = 0; i < m_activeCount; ++i) {
+        Voice &voice = m_voices[m_activeList[i]];
+        voice.envelope.reset();
+        voice.program = &m_initProgram;
+        voice.zone = nullptr;
+        voice.note = -1;
+    }
+    m_activeCount = 0;
+    m_voicesInUse.store(0, std::memory_order_relaxed);
+    m_program = &m_initProgram;
+    m_patches = bank;
+    // Поток подкачки нужен, только если в наборе есть программы сэмплера
+    m_streamer.reset();
+    bool sampled = false;
+    if (m_patches) {
+        m_patches->setSampleRate(m_format.sampleRate());
+        for (int i = 0; i < m_patches->count(); ++i) {
+            sampled = sampled || !m_patches->program(i)->zones.isEmpty();
+        }
+    }
+    if (sampled) {
+        m_streamer.reset(new SampleStreamer);
+        m_streamer->setWaitForData(m_offline);
+        m_streamer->startStreaming();
+    }
+}
+
+void ToneSynthesizer::setOfflineRendering(bool offline)
+{
+    m_offline = offline;
+    if (!m_streamer.isNull()) {
+        m_streamer->setWaitForData(offline);
+    }
+}
+
+quint64 ToneSynthesizer::streamUnderruns() const
+{
+    return m_streamer.isNull() ? 0 : m_streamer->underruns();
+}
+
+void ToneSynthesizer::setRecorder(AudioRecorder *recorder)
+{
+    m_recorder.store(recorder, std::memory_order_release);
+}
+
+// Включение параллельной генерации голосов
+void ToneSynthesizer::setRenderThreads(int threads)
+{
+    if (threads > 1) {
+        m_pool.reset(new RenderPool(threads - 1));
+        m_blockFrames = ParallelBlockFrames;
+    } else {
+        m_pool.reset();
+        m_blockFrames = BlockFrames;
+    }
+}
+
+int ToneSynthesizer::renderThreads() const
+{
+    return m_pool.isNull() ? 1 : m_pool->workers() + 1;
+}
+
+// Текущий формат вывода
+QAudioFormat ToneSynthesizer::format() const
+{
+    return m_format;
+}
+
+// Размер кадра вывода в байтах
+int ToneSynthesizer::frameBytes() const
+{
+    return m_frameBytes;
 }
 
 // Запись данных в устройство
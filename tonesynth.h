@@ -1,20 +1,58 @@
 #ifndef TONESYNTH_H
 #define TONESYNTH_H
 
+#include <atomic>
 #include <QAudioFormat>
 #include <QIODevice>
-#include <QMap> // Ассоциативный контейнер (словарь)
 #include <QObject>
+#include <QScopedPointer>
 #include <QString>
+#include "decimator.h" // Понижение частоты после передискретизации
+#include "effectgraph.h" // Обработка после смесителя
+#include "envelope.h" // Огибающие голосов
+#include "eventqueue.h" // Очередь событий между GUI и потоком звука
+#include "patch.h" // Программы (патчи)
+#include "renderkernels.h" // Векторные ядра генерации
+#include "renderpool.h" // Потоки параллельной генерации голосов
+#include "samplestream.h" // Подкачка сэмплов
+#include "smoothedvalue.h" // Плавное изменение параметров
+#include "telemetry.h" // Показатели работы звукового потока
+#include "tuning.h" // Таблица частот нот
+#include "wavetable.h" // Табличные генераторы
+
+class AudioRecorder;
 
 class ToneSynthesizer : public QIODevice
 {
     Q_OBJECT // Макрос, необходимый для использования механизма сигналов и слотов Qt
 
 public:
-    // Состояния огибающей
-    enum class EnvelopeState : int { silentState, attackState, sustainState, releaseState };
-    Q_ENUM(EnvelopeState)
+    // Максимальное число одновременно звучащих голосов (пул выделяется один раз)
+    static const int MaxVoices = 64;
+    // Размер блока генерации в сэмплах
+    static const int BlockFrames = 64;
+    // Наибольшее число каналов вывода (сигнал синтезатора повторяется в каждом)
+    static const int MaxChannels = 8;
+    // Параллельная генерация: блок крупнее, чтобы синхронизация потоков окупалась,
+    // голоса делятся на задачи по VoicesPerTask. Блок с меньшим объемом работы
+    // (голоса * сэмплы) генерируется в одном потоке
+    static const int ParallelBlockFrames = 256;
+    static const int ParallelMinWork = 4096;
+    static const int VoicesPerTask = 4;
+    // Диапазон изгиба высоты тона в полутонах
+    static const int PitchBendRange = 2;
+
+    // Источники событий: у каждого своя очередь с одним писателем
+    enum class EventPort : int { gui, midi };
+    static const int EventPorts = 2;
+
+    // Параметры, которые можно менять во время игры: громкость (0..1), время
+    // перехода высоты в мс и транспонирование в октавах (-6..6, высота переходит
+    // за время glide). Цели подхватываются по порядку, поэтому время перехода
+    // стоит раньше высоты. Новый параметр добавляется сюда и в таблицу
+    // диапазонов в tonesynth.cpp
+    enum class Parameter : int { volume, glide, octave };
+    static const int Parameters = 3;
 
     // Конструктор класса
     ToneSynthesizer(const QAudioFormat &format);
@@ -24,45 +62,215 @@ public:
     qint64 size() const override;
     qint64 bytesAvailable() const override;
 
-     // Методы для установки октавы, получения размера последнего буфера и сброса этого размера
-    void setOctave(int newOctave);
-    qint64 lastBufferSize() const;
-    void resetLastBufferSize();
+    // Формат вывода: Int16, Int32 или Float, 1..MaxChannels каналов. Генерация идет
+    // во float, перевод в формат устройства - векторными ядрами. Менять формат
+    // можно только пока устройство не читает данные (до start() или после stop()).
+    // false - формат не поддерживается (isFormatSupported), прежний остается
+    bool setFormat(const QAudioFormat &format);
+    // type - формат сэмплов поддерживаемого формата (может быть nullptr)
+    static bool isFormatSupported(const QAudioFormat &format, RenderKernels::SampleFormat *type = nullptr);
+    // Формат сэмплов QAudioFormat, false - не поддерживается
+    static bool sampleFormat(const QAudioFormat &format, RenderKernels::SampleFormat *sampleFormat);
+    // Формат PCM с заданными параметрами (для Qt5 и Qt6)
+    static QAudioFormat makeFormat(int sampleRate, int channels, RenderKernels::SampleFormat sampleFormat);
+    QAudioFormat format() const;
+    int frameBytes() const;
+
+    // Генерация без устройства: readData() вызывает их сама, поток генерации
+    // (RenderThread) - заранее, в свой кольцевой буфер
+    qint64 outputRequest(qint64 maxlen) const;
+    qint64 render(char *data, qint64 frames);
+    // Ответвление вывода в запись (nullptr - без записи). Объект записи должен
+    // жить, пока устройство читает данные
+    void setRecorder(AudioRecorder *recorder);
+    // Число потоков генерации голосов (1 - без параллельной генерации). Менять
+    // можно только пока устройство не читает данные
+    void setRenderThreads(int threads);
+    int renderThreads() const;
+
+     // Методы для выбора формы волны и строя. Выбор формы волны возвращает
+     // встроенную программу
+    void setWaveform(Wavetable::Waveform waveform);
+    void setTuning(qreal referenceHz, NoteTuning::Temperament temperament);
+    // Огибающая голосов встроенной программы; менять можно только пока
+    // устройство не читает данные
+    void setEnvelope(const EnvelopeShape &shape);
+    const EnvelopeShape &envelope() const;
+    // Граф обработки смеси голосов встроенной программы (фильтр, задержка,
+    // реверберация); менять можно только пока устройство не читает данные
+    EffectGraph &effects();
+    // Передискретизация голосов встроенной программы: 1 (нет), 2 или 4. Голоса
+    // генерируются на кратной частоте и смешиваются, смесь возвращается
+    // к частоте вывода полифазным полуполосным фильтром (Decimator). Чище
+    // верхние частоты, но генерация дороже в factor раз. Действует кратность
+    // текущей программы; менять можно только пока устройство не читает данные
+    void setOversampling(int factor);
+    int oversampling() const;
+    // Набор программ для смены по номеру (selectProgram(), MIDI Program Change).
+    // Менять можно только пока устройство не читает данные, звучащие голоса
+    // замолкают. Набор должен жить, пока синтезатор с ним работает;
+    // nullptr - только встроенная программа
+    void setPatchBank(PatchBank *bank);
+    int activeVoices() const;
+    // Генерация быстрее реального времени (без устройства): голоса сэмплера ждут
+    // подкачки вместо тишины
+    void setOfflineRendering(bool offline);
+    // Куски сэмплов, не подкачанные к моменту воспроизведения
+    quint64 streamUnderruns() const;
+
+    // Целевое значение параметра (любой поток, без блокировок). Поток звука
+    // подхватывает его в начале блока и переходит к нему плавно. Для точной
+    // по сэмплам автоматизации - событие SynthEvent::Type::parameter
+    void setParameter(Parameter parameter, float value);
+    float parameter(Parameter parameter) const;
+    static QString parameterName(Parameter parameter);
+    // Параметр по имени, false - имя неизвестно
+    static bool parseParameter(const QString &name, Parameter *parameter);
+
+    // Постановка события в очередь источника (один поток-писатель на источник).
+    // false - очередь заполнена
+    bool postEvent(const SynthEvent &event, EventPort port = EventPort::gui);
+    // Сэмпл, с которого вступит в силу событие, отправленное сейчас
+    quint64 scheduleFrame() const;
+    // Сэмпл для события, полученного в момент timeNs (монотонное время)
+    quint64 frameAtTime(qint64 timeNs) const;
+    // Монотонное время в наносекундах
+    static qint64 monotonicNs();
+    // Показатели работы readData()
+    AudioTelemetry &telemetry();
+    // Ограничение опережения: readData() отдает не больше, чем нужно, чтобы
+    // в буфере устройства было не более targetBytes. 0 - без ограничения
+    void setOutputLimit(qint64 deviceBufferBytes, qint64 targetBytes);
+    // Замер задержки ввода (один поток-писатель): нота, включенная событием
+    // на сэмпле frame по нажатию в момент timeNs. Поток звука находит первый
+    // ненулевой сэмпл смеси начиная с frame и сообщает в показатели время от
+    // нажатия до начала генерации этого вызова плюс положение сэмпла в нем.
+    // Буфер устройства сюда не входит. Замер учитывается, только если до ноты
+    // вывод и хвосты обработки молчали, новый замер заменяет незаконченный
+    void probeLatency(qint64 timeNs, quint64 frame);
 
 public slots:
     // Слоты для запуска, остановки, включения и выключения ноты
     void start();
     void stop();
-    void noteOn(const QString &note);
-    void noteOff();
+    // Номер ноты MIDI (0..127), громкость нажатия 0..1
+    void noteOn(int note, float velocity = 1.0f);
+    void noteOff(int note);
+    void allNotesOff();
+    // Программа набора для следующих нот, -1 - встроенная. Граф обработки
+    // переключается сразу, хвосты новой программы очищаются
+    void selectProgram(int program);
 
 private:
+    // Состояние одного голоса. Часто используемые в цикле поля идут первыми
+    struct Voice
+    {
+        const float *table;         // Волновая таблица для частоты ноты
+        quint32 phase;              // Текущая фаза (полный период = 2^32)
+        quint32 phaseDelta;         // Приращение фазы за сэмпл
+        const SampleZone *zone;     // Зона сэмплера, nullptr - генератор
+        quint64 samplePos;          // Позиция в сэмпле (32.32, петля развернута)
+        quint64 sampleStep;         // Приращение позиции за сэмпл вывода
+        float velocity;             // Громкость нажатия
+        bool sustained;             // Нота отпущена при нажатой педали
+        Envelope envelope;          // Огибающая голоса
+        const SynthProgram *program; // Программа, с которой нота включена
+        int note;                   // Номер ноты (MIDI), -1 если голос свободен
+        quint64 startOrder;         // Порядковый номер включения (для кражи голосов)
+        SmoothedValue glide;        // Легато: отклонение высоты от ноты в полутонах (к 0)
+    };
+
+    void postNoteEvent(SynthEvent::Type type, int note, float value);
+    void applyEvent(const SynthEvent &event);
+    void applyProgram(int program);
+    const SampleZone *findZone(int note, float velocity) const;
+    void startVoice(int note, float velocity);
+    void legatoVoice(int source, int note, float velocity);
+    void stopVoice(int note);
+    void stopAllVoices();
+    void tuneVoice(Voice &voice) const;
+    void applyController(int controller, float value);
+    void pollParameters();
+    void applyParameter(Parameter parameter, float value);
+    void updatePitch(int frames);
+    void applyVolume(float *out, int frames);
+    void setSustainPedal(bool down);
+    const SynthEvent *nextEvent(int *port) const;
+    Voice *allocateVoice(int note);
+    void releaseVoice(int index);
+    qint64 silentFrames(qint64 frames) const;
+    void skipSilence(int frames);
+    static bool isQuiet(const float *buffer, int frames);
+    void measureLatency(const float *buffer, qint64 offset, int frames, qint64 startNs);
+    void renderBlock(float *out, int frames);
+    void renderVoices(float *out, int frames);
+    void renderVoicesParallel(float *out, int frames);
+    static void renderVoiceTask(void *context, int task);
+    void setRenderOversampling(int factor);
+    void renderVoice(Voice &voice, float *out, int frames);
+    void renderSample(Voice &voice, float *out, int frames, float gain, float gainStep);
+
     QAudioFormat m_format;
-    int m_octave; /* octave 3 */
-    /* Equal temperament scale */
-    // Словарь частот нот в герцах
-    const QMap<QString, qreal> m_freq{{"C'", 261.626},
-                                      {"B", 246.942},
-                                      {"A#", 233.082},
-                                      {"A", 220.000},
-                                      {"G#", 207.652},
-                                      {"G", 195.998},
-                                      {"F#", 184.997},
-                                      {"F", 174.614},
-                                      {"E", 164.814},
-                                      {"D#", 155.563},
-                                      {"D", 146.832},
-                                      {"C#", 138.591},
-                                      {"C", 130.813}};
-    qreal m_angleDelta;  // Приращение фаз для генерации синусоидального сигнала
-    qreal m_currentAngle; // Текущая фаза
-    qint64 m_lastBufferSize;
-    EnvelopeState m_envelState; // Состояние огибающей
-    qreal m_envelVolume; // Громкость огибающей
-    qreal m_envelDelta; // Приращение громкости огибающей
-    quint64 m_envelCount; // Счетчик сэмплов для огибающей
-    quint64 m_attackTime; // Время атаки в сэмплах
-    quint64 m_releaseTime; // Время затухания в сэмплах
+    Voice m_voices[MaxVoices]; // Пул голосов
+    int m_activeList[MaxVoices]; // Индексы звучащих голосов
+    int m_activeCount; // Количество звучащих голосов
+    quint64 m_noteCounter; // Счетчик включений нот
+    const Wavetable &m_wavetable; // Общие волновые таблицы
+    std::atomic<int> m_voicesInUse; // Копия m_activeCount для чтения из GUI
+    RenderKernels::OscillatorKernel m_oscillator; // Выбранное ядро генератора
+    RenderKernels::ConvertKernel m_convert; // Перевод в формат устройства
+    int m_channels; // Каналов в кадре вывода
+    int m_frameBytes; // Байт в кадре вывода
+    int m_blockFrames; // Размер блока генерации (BlockFrames или ParallelBlockFrames)
+    float m_mixBuffer[ParallelBlockFrames]; // Смесь голосов текущего блока
+    // Передискретизация: кратность генерации голосов, смесь на кратной частоте
+    // и фильтр понижения частоты
+    int m_oversampling;
+    float m_overBuffer[ParallelBlockFrames * Decimator::MaxFactor];
+    Decimator m_decimator;
+    QScopedPointer<RenderPool> m_pool; // Потоки параллельной генерации, если включена
+    int m_taskFrames; // Длина отрезка для задач пула
+    // Смеси задач отрезка (на частоте генерации голосов)
+    float m_partials[MaxVoices / VoicesPerTask][ParallelBlockFrames * Decimator::MaxFactor];
+    bool m_silent; // Нет голосов и хвосты графа обработки затихли
+    qint64 m_quietFrames; // Длина тихого вывода без голосов
+    AudioTelemetry m_telemetry;
+    SpscQueue<SynthEvent, 1024> m_events[EventPorts]; // События к readData()
+    quint64 m_lastPostedFrame[EventPorts]; // Метка последнего события (сторона писателя)
+    NoteTuning m_tuning; // Приращения фазы всех нот для текущей частоты дискретизации
+    qreal m_bendFactor; // Множитель приращения фазы от изгиба высоты тона
+    qreal m_octaveFactor; // Множитель приращения фазы от транспонирования
+    std::atomic<float> m_parameterTargets[Parameters]; // Цели, заданные из других потоков
+    float m_polledTargets[Parameters]; // Последние подхваченные цели (поток звука)
+    SmoothedValue m_volume; // Громкость канала (параметр и контроллер 7)
+    SmoothedValue m_octave; // Транспонирование в октавах
+    float m_tunedOctave; // Транспонирование, под которое настроены голоса
+    qreal m_glideMs; // Время перехода высоты
+    bool m_sustainPedal; // Педаль удержания (контроллер 64)
+    quint64 m_framePosition; // Номер первого сэмпла следующего блока
+    // Привязка позиции в сэмплах к монотонному времени, публикуется readData()
+    // под счетчиком последовательности (seqlock)
+    std::atomic<quint32> m_clockSeq;
+    std::atomic<qint64> m_clockNs; // Время начала последнего блока
+    std::atomic<quint64> m_clockFrame; // Первый сэмпл последнего блока
+    std::atomic<quint64> m_clockFrames; // Длина последнего блока в сэмплах
+    std::atomic<int> m_clockRate; // Частота дискретизации для frameAtTime()
+    std::atomic<qint64> m_deviceBufferBytes; // Размер буфера устройства
+    std::atomic<qint64> m_targetBytes; // Желаемое заполнение буфера устройства
+    std::atomic<AudioRecorder *> m_recorder; // Запись вывода, если включена
+    // Встроенная программа: форма волны, огибающая и обработка из GUI
+    SynthProgram m_initProgram;
+    SynthProgram *m_program; // Программа для новых нот и обработки смеси
+    PatchBank *m_patches; // Набор программ, если задан
+    QScopedPointer<SampleStreamer> m_streamer; // Подкачка, если в наборе есть сэмплы
+    bool m_offline; // Генерация без устройства (ожидание подкачки)
+    // Замер задержки ввода: заявка из GUI и замер, который ведет поток звука
+    std::atomic<bool> m_probePosted;
+    std::atomic<qint64> m_probePostedNs;
+    std::atomic<quint64> m_probePostedFrame;
+    bool m_probeActive;
+    qint64 m_probeNs;
+    quint64 m_probeFrame;
 };
 
 #endif // TONESYNTH_H
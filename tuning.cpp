@@ -0,0 +1,79 @@
+#include <QtMath>
+#include "tuning.h"
+#include "wavetable.h" // Приращение фазы
+
+namespace {
+
+// Высота ступеней от C в центах для каждого строя
+const qreal temperamentCents[NoteTuning::TemperamentCount][12] = {
+    // Равномерный
+    {0.0, 100.0, 200.0, 300.0, 400.0, 500.0, 600.0, 700.0, 800.0, 900.0, 1000.0, 1100.0},
+    // Пифагоров (квинты от Eb до G#)
+    {0.0, 113.685, 203.910, 294.135, 407.820, 498.045,
+     611.730, 701.955, 815.640, 905.865, 996.090, 1109.775},
+    // Чистый (пятипредельный)
+    {0.0, 111.731, 203.910, 315.641, 386.314, 498.045,
+     590.224, 701.955, 813.686, 884.359, 1017.596, 1088.269},
+    // Четвертькоммовый среднетоновый
+    {0.0, 76.049, 193.157, 310.265, 386.314, 503.422,
+     579.471, 696.578, 772.627, 889.735, 1006.843, 1082.892},
+    // Веркмейстер III
+    {0.0, 90.225, 192.180, 294.135, 390.225, 498.045,
+     588.270, 696.090, 792.180, 888.270, 996.090, 1092.180},
+};
+
+const char *const temperamentNames[NoteTuning::TemperamentCount]
+    = {"equal", "pythagorean", "just", "meantone", "werckmeister"};
+
+} // namespace
+
+NoteTuning::NoteTuning()
+    : m_referenceHz(440.0)
+    , m_temperament(Temperament::equal)
+{
+    for (int note = 0; note < Notes; ++note) {
+        m_frequency[note] = 0.0;
+        m_increment[note] = 0;
+    }
+}
+
+// Пересчет таблицы. Ступени строя откладываются от C так, чтобы A4 получила
+// частоту referenceHz
+void NoteTuning::build(int sampleRate, qreal referenceHz, Temperament temperament)
+{
+    m_referenceHz = referenceHz;
+    m_temperament = temperament;
+    const qreal *cents = temperamentCents[int(temperament)];
+    const qreal c4 = referenceHz * qPow(2.0, -cents[9] / 1200.0); // C4 = 60, A4 = 69
+    for (int note = 0; note < Notes; ++note) {
+        const int octave = note / 12 - 5;
+        m_frequency[note] = c4 * qPow(2.0, octave + cents[note % 12] / 1200.0);
+        m_increment[note] = Wavetable::phaseIncrement(m_frequency[note], sampleRate);
+    }
+}
+
+qreal NoteTuning::referenceHz() const
+{
+    return m_referenceHz;
+}
+
+NoteTuning::Temperament NoteTuning::temperament() const
+{
+    return m_temperament;
+}
+
+QString NoteTuning::temperamentName(Temperament temperament)
+{
+    return temperamentNames[int(temperament)];
+}
+
+bool NoteTuning::parseTemperament(const QString &name, Temperament *temperament)
+{
+    for (int i = 0; i < TemperamentCount; ++i) {
+        if (name == temperamentNames[i]) {
+            *temperament = Temperament(i);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,40 @@
+#ifndef TUNING_H
+#define TUNING_H
+
+#include <QString>
+#include <QtGlobal>
+
+// Частоты и приращения фазы для всех 128 нот MIDI. Таблица пересчитывается только
+// при смене частоты дискретизации или строя, включение ноты - обращение по индексу
+class NoteTuning
+{
+public:
+    static const int Notes = 128;
+
+    // Строи (от ноты C): равномерный, пифагоров, чистый, четвертькоммовый
+    // среднетоновый и Веркмейстер III
+    enum class Temperament : int { equal, pythagorean, just, meantone, werckmeister };
+    static const int TemperamentCount = 5;
+
+    NoteTuning();
+
+    // referenceHz - частота ноты A4 (69)
+    void build(int sampleRate, qreal referenceHz, Temperament temperament);
+
+    qreal frequency(int note) const { return m_frequency[note]; }
+    quint32 increment(int note) const { return m_increment[note]; }
+    qreal referenceHz() const;
+    Temperament temperament() const;
+
+    static QString temperamentName(Temperament temperament);
+    // Строй по имени, false - имя неизвестно
+    static bool parseTemperament(const QString &name, Temperament *temperament);
+
+private:
+    qreal m_frequency[Notes];
+    quint32 m_increment[Notes];
+    qreal m_referenceHz;
+    Temperament m_temperament;
+};
+
+#endif // TUNING_H
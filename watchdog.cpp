@@ -0,0 +1,161 @@
+#include <limits>
+#include "tonesynth.h" // Монотонное время
+#include "watchdog.h"
+
+namespace {
+// Разгон вывода: обычное отставание данных от времени набирается, о потерях
+// не сообщается
+const qint64 warmupNs = 500000000;
+// Окно, за которое обычное отставание подстраивается под уход часов
+// устройства, и наибольшая поправка за окно (1000 ppm)
+const qint64 driftWindowNs = 1000000000;
+const qint64 driftAllowanceUs = 1000;
+// Устройство остановилось, если не забирает данные столько периодов (не меньше minStallUs)
+const qint64 stallPeriods = 4;
+const qint64 minStallUs = 50000;
+// Период до первого запроса устройства
+const qint64 defaultPeriodUs = 10000;
+} // namespace
+
+AudioWatchdog::AudioWatchdog(QObject *parent)
+    : QObject(parent)
+    , m_output(nullptr)
+    , m_telemetry(nullptr)
+    , m_startNs(0)
+    , m_periodUs(defaultPeriodUs)
+    , m_baselineUs(0)
+    , m_windowStartNs(0)
+    , m_windowMaxUs(0)
+    , m_lastProcessedUs(0)
+    , m_lastAdvanceNs(0)
+    , m_silentFrames(0)
+    , m_stalled(false)
+    , m_xruns(0)
+    , m_framesLost(0)
+{
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &AudioWatchdog::check);
+}
+
+void AudioWatchdog::start(Output *output, AudioTelemetry *telemetry, const QAudioFormat &format)
+{
+    const qint64 nowNs = ToneSynthesizer::monotonicNs();
+    m_output = output;
+    m_telemetry = telemetry;
+    m_format = format;
+    m_startNs = nowNs;
+    m_periodUs = defaultPeriodUs;
+    m_baselineUs = std::numeric_limits<qint64>::min();
+    m_windowStartNs = nowNs;
+    m_windowMaxUs = std::numeric_limits<qint64>::min();
+    m_lastProcessedUs = output->processedUSecs();
+    m_lastAdvanceNs = nowNs;
+    m_silentFrames = telemetry->snapshot().silentFrames;
+    m_stalled = false;
+    m_xruns = 0;
+    m_framesLost = 0;
+    m_timer.start(int(m_periodUs / 2000));
+}
+
+void AudioWatchdog::stop()
+{
+    m_timer.stop();
+    m_output = nullptr;
+    m_stalled = false;
+}
+
+bool AudioWatchdog::isStalled() const
+{
+    return m_stalled;
+}
+
+quint64 AudioWatchdog::xruns() const
+{
+    return m_xruns;
+}
+
+quint64 AudioWatchdog::framesLost() const
+{
+    return m_framesLost;
+}
+
+void AudioWatchdog::reportLoss(qint64 frames, qint64 nowNs)
+{
+    if (frames <= 0) {
+        return;
+    }
+    m_xruns++;
+    m_framesLost += quint64(frames);
+    emit xrunDetected(frames, nowNs);
+}
+
+void AudioWatchdog::check()
+{
+    if (!m_output) {
+        return;
+    }
+    const qint64 nowNs = ToneSynthesizer::monotonicNs();
+    const AudioTelemetry::Snapshot s = m_telemetry->snapshot();
+
+    // Период устройства - наименьший запрос; проверка дважды за период
+    if (s.minRequestBytes > 0) {
+        m_periodUs = qMax<qint64>(1000, m_format.durationForBytes(qint32(s.minRequestBytes)));
+    }
+    const int interval = int(qBound<qint64>(1, m_periodUs / 2000, 20));
+    if (m_timer.interval() != interval) {
+        m_timer.setInterval(interval);
+    }
+
+    // Генерация не успела: кадры тишины уже учтены потоком генерации
+    if (s.silentFrames > m_silentFrames) {
+        reportLoss(qint64(s.silentFrames - m_silentFrames), nowNs);
+    }
+    m_silentFrames = s.silentFrames;
+
+    // Устройство: отставание отданных данных от времени с запуска
+    const qint64 processedUs = m_output->processedUSecs();
+    const qint64 lagUs = m_output->elapsedUSecs() - processedUs;
+    const bool advanced = (processedUs != m_lastProcessedUs);
+    if (advanced) {
+        m_lastProcessedUs = processedUs;
+        m_lastAdvanceNs = nowNs;
+    }
+    if (nowNs - m_startNs < warmupNs) {
+        m_baselineUs = qMax(m_baselineUs, lagUs); // Размах колебаний при нормальной работе
+        return;
+    }
+    if (m_baselineUs == std::numeric_limits<qint64>::min()) {
+        m_baselineUs = lagUs; // Разгон прошел без проверок
+    }
+
+    // Остановка: потери копятся и сообщаются одним событием после возобновления
+    const qint64 stallUs = qMax(minStallUs, stallPeriods * m_periodUs);
+    if (!m_stalled && (nowNs - m_lastAdvanceNs) / 1000 > stallUs) {
+        m_stalled = true;
+        emit stallChanged(true, nowNs);
+    }
+    if (m_stalled) {
+        if (!advanced) {
+            return;
+        }
+        m_stalled = false;
+        emit stallChanged(false, nowNs);
+    }
+
+    const qint64 toleranceUs = qMax<qint64>(1000, m_periodUs / 2);
+    if (lagUs > m_baselineUs + toleranceUs) {
+        const qint64 lostUs = lagUs - m_baselineUs;
+        m_baselineUs = lagUs; // Отставание после потери остается навсегда
+        m_telemetry->reportUnderrun();
+        reportLoss(lostUs * m_format.sampleRate() / 1000000, nowNs);
+    }
+
+    // Медленный уход часов устройства: обычное отставание сдвигается
+    // к наибольшему за окно, не больше чем на допустимый уход
+    m_windowMaxUs = qMax(m_windowMaxUs, lagUs);
+    if (nowNs - m_windowStartNs >= driftWindowNs) {
+        m_baselineUs += qBound(-driftAllowanceUs, m_windowMaxUs - m_baselineUs, driftAllowanceUs);
+        m_windowMaxUs = std::numeric_limits<qint64>::min();
+        m_windowStartNs = nowNs;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <QAudioFormat>
+#include <QObject>
+#include <QTimer>
+#include <QtGlobal>
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+#include <QAudioOutput>
+#else
+#include <QAudioSink>
+#endif
+#include "telemetry.h" // Счетчики кадров звукового потока
+
+// Наблюдение за выводом по часам, а не по опросу буфера. Два источника потерь:
+// - генерация не успела, и поток генерации дополнил вывод тишиной - точное
+//   число кадров берется из атомарного счетчика показателей;
+// - устройство осталось без данных: время с запуска (elapsedUSecs()) уходит
+//   вперед от отданных устройству данных (processedUSecs()) больше, чем
+//   за время разгона. Медленный уход часов устройства потерей не считается.
+// Проверка идет каждые полпериода устройства, поэтому о потере сообщается
+// не позже чем через период. Работает в потоке GUI
+class AudioWatchdog : public QObject
+{
+    Q_OBJECT
+
+public:
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    typedef QAudioOutput Output;
+#else
+    typedef QAudioSink Output;
+#endif
+
+    explicit AudioWatchdog(QObject *parent = nullptr);
+
+    // Наблюдение за запущенным выводом. Потери со стороны устройства
+    // учитываются в telemetry (reportUnderrun()), как и потери генерации
+    void start(Output *output, AudioTelemetry *telemetry, const QAudioFormat &format);
+    void stop();
+    bool isStalled() const;
+    // Итоги с запуска
+    quint64 xruns() const;
+    quint64 framesLost() const;
+
+signals:
+    // Потеря звука: число кадров тишины и время обнаружения
+    // (ToneSynthesizer::monotonicNs())
+    void xrunDetected(qint64 framesLost, qint64 timestampNs);
+    // Устройство перестало забирать данные (true) и снова забирает (false)
+    void stallChanged(bool stalled, qint64 timestampNs);
+
+private:
+    void check();
+    void reportLoss(qint64 frames, qint64 nowNs);
+
+    QTimer m_timer;
+    Output *m_output;
+    AudioTelemetry *m_telemetry;
+    QAudioFormat m_format;
+    qint64 m_startNs;
+    qint64 m_periodUs; // Период устройства по наименьшему запросу
+    qint64 m_baselineUs; // Обычное отставание отданных данных от времени
+    qint64 m_windowStartNs; // Окно подстройки под уход часов
+    qint64 m_windowMaxUs;
+    qint64 m_lastProcessedUs;
+    qint64 m_lastAdvanceNs; // Когда устройство последний раз забрало данные
+    quint64 m_silentFrames; // Уже учтенные кадры тишины генерации
+    bool m_stalled;
+    quint64 m_xruns;
+    quint64 m_framesLost;
+};
+
+#endif // WATCHDOG_H
@@ -0,0 +1,112 @@
+#include <cmath>
+#include <QtMath>
+#include "wavetable.h"
+
+// Общий набор таблиц (инициализация локальной статической переменной потокобезопасна)
+const Wavetable &Wavetable::instance()
+{
+    static const Wavetable wavetable;
+    return wavetable;
+}
+
+// Приращение фазы: доля периода за сэмпл в единицах 2^-32
+quint32 Wavetable::phaseIncrement(qreal freq, int sampleRate)
+{
+    const qreal cyclesPerSample = qBound(0.0, freq / sampleRate, 0.5);
+    return quint32(cyclesPerSample * 4294967296.0);
+}
+
+Wavetable::Wavetable()
+    : m_data(WaveformCount * SetSize)
+{
+    // Амплитуды гармоник встроенных форм (ряды Фурье), косинусных составляющих нет
+    const int harmonics = TableSize / 2;
+    const std::vector<double> cosines(harmonics + 1, 0.0);
+    for (int w = 0; w < WaveformCount; ++w) {
+        std::vector<double> sines(harmonics + 1, 0.0);
+        for (int h = 1; h <= harmonics; ++h) {
+            switch (Waveform(w)) {
+            case Waveform::sine:
+                sines[h] = (h == 1) ? 1.0 : 0.0;
+                break;
+            case Waveform::saw:
+                sines[h] = ((h & 1) ? 1.0 : -1.0) / h;
+                break;
+            case Waveform::square:
+                sines[h] = (h & 1) ? 1.0 / h : 0.0;
+                break;
+            case Waveform::triangle:
+                sines[h] = (h & 1) ? ((h & 2) ? -1.0 : 1.0) / (double(h) * h) : 0.0;
+                break;
+            }
+        }
+        synthesize(sines, cosines, &m_data[w * SetSize]);
+    }
+}
+
+// Разложение периода на гармоники (без постоянной составляющей)
+void Wavetable::buildSet(const float *cycle, int length, float *tables)
+{
+    // Гармоники ниже частоты Найквиста периода, но не больше, чем вмещает таблица
+    const int harmonics = qMin((length - 1) / 2, TableSize / 2);
+    std::vector<double> sine(length);
+    for (int n = 0; n < length; ++n) {
+        sine[n] = std::sin(2.0 * M_PI * n / length);
+    }
+    std::vector<double> sines(harmonics + 1, 0.0);
+    std::vector<double> cosines(harmonics + 1, 0.0);
+    for (int h = 1; h <= harmonics; ++h) {
+        double a = 0.0;
+        double b = 0.0;
+        for (int n = 0; n < length; ++n) {
+            const qint64 index = qint64(h) * n;
+            a += cycle[n] * sine[index % length];
+            b += cycle[n] * sine[(index + length / 4) % length];
+        }
+        sines[h] = 2.0 * a / length;
+        cosines[h] = 2.0 * b / length;
+    }
+    synthesize(sines, cosines, tables);
+}
+
+// Сборка мип-ступеней аддитивным синтезом. sin(2*pi*h*n/N) берется по индексу
+// (h*n) mod N, косинус - со сдвигом на четверть периода, поэтому при сложении
+// гармоник тригонометрические функции не вычисляются
+void Wavetable::synthesize(const std::vector<double> &sines,
+                           const std::vector<double> &cosines,
+                           float *tables)
+{
+    std::vector<double> sine(TableSize);
+    for (int n = 0; n < TableSize; ++n) {
+        sine[n] = std::sin(2.0 * M_PI * n / TableSize);
+    }
+    const int available = int(sines.size()) - 1;
+    for (int level = 0; level < MipLevels; ++level) {
+        const int harmonics = qMin((TableSize / 2) >> level, available);
+        std::vector<double> sum(TableSize, 0.0);
+        for (int h = 1; h <= harmonics; ++h) {
+            const double a = sines[h];
+            const double b = cosines[h];
+            if (a == 0.0 && b == 0.0) {
+                continue;
+            }
+            for (int n = 0; n < TableSize; ++n) {
+                const qint64 index = qint64(h) * n;
+                sum[n] += a * sine[index & (TableSize - 1)]
+                          + b * sine[(index + TableSize / 4) & (TableSize - 1)];
+            }
+        }
+
+        // Нормировка на единичную амплитуду (тишина остается тишиной)
+        double peak = 0.0;
+        for (int n = 0; n < TableSize; ++n) {
+            peak = qMax(peak, std::fabs(sum[n]));
+        }
+        const double scale = (peak > 0.0) ? 1.0 / peak : 0.0;
+        float *table = tables + level * (TableSize + 1);
+        for (int n = 0; n < TableSize; ++n) {
+            table[n] = float(sum[n] * scale);
+        }
+        table[TableSize] = table[0]; // Точка для интерполяции на стыке периодов
+    }
+}
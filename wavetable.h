@@ -0,0 +1,82 @@
+#ifndef WAVETABLE_H
+#define WAVETABLE_H
+
+#include <vector>
+#include <QtAlgorithms> // qCountLeadingZeroBits()
+#include <QtGlobal>
+
+// Набор волновых таблиц с ограниченным спектром: по одной мип-ступени на октаву.
+// Фаза генератора - 32-битный целочисленный аккумулятор (полный период = 2^32),
+// поэтому она переполняется сама и не теряет точность на длинных нотах
+class Wavetable
+{
+public:
+    // Формы волны
+    enum class Waveform : int { sine, saw, square, triangle };
+    static const int WaveformCount = 4;
+
+    static const int TableBits = 11;
+    static const int TableSize = 1 << TableBits; // Точек на период
+    static const int MipLevels = 11; // Ступень k содержит TableSize / 2 >> k гармоник
+    static const int FractionBits = 32 - TableBits;
+    // Точек в наборе мип-ступеней одной формы (у каждой таблицы есть
+    // дополнительная точка для интерполяции)
+    static const int SetSize = MipLevels * (TableSize + 1);
+
+    // Общий набор таблиц, строится один раз при первом обращении
+    static const Wavetable &instance();
+
+    // Приращение фазы за сэмпл для частоты freq
+    static quint32 phaseIncrement(qreal freq, int sampleRate);
+
+    // Набор мип-ступеней встроенной формы
+    const float *tables(Waveform waveform) const { return &m_data[int(waveform) * SetSize]; }
+
+    // Таблица нужной формы, у которой нет гармоник выше частоты Найквиста
+    // для заданного приращения фазы
+    const float *table(Waveform waveform, quint32 increment) const
+    {
+        return mipTable(tables(waveform), increment);
+    }
+
+    // То же для любого набора в формате встроенных (например, из банка)
+    static const float *mipTable(const float *tables, quint32 increment)
+    {
+        // Ступень 0 годится для приращений < 2^21, каждая следующая - вдвое больших
+        const int bits = 32 - int(qCountLeadingZeroBits(increment));
+        const int level = qBound(0, bits - FractionBits, MipLevels - 1);
+        return tables + level * (TableSize + 1);
+    }
+
+    // Значение таблицы в точке phase с линейной интерполяцией
+    static float lookup(const float *table, quint32 phase)
+    {
+        const quint32 index = phase >> FractionBits;
+        const float frac = float(phase & ((1u << FractionBits) - 1))
+                           * (1.0f / float(1u << FractionBits));
+        const float a = table[index];
+        return a + frac * (table[index + 1] - a);
+    }
+
+    // Память таблиц (закрепляется в ОЗУ потоком генерации)
+    const void *storage() const { return m_data.data(); }
+    size_t storageBytes() const { return m_data.size() * sizeof(float); }
+
+    // Набор мип-ступеней (SetSize точек) из одного периода произвольной длины:
+    // гармоники находятся прямым преобразованием Фурье, каждая ступень
+    // собирается заново без гармоник выше своего предела. Для подготовки
+    // банков, не для потока звука
+    static void buildSet(const float *cycle, int length, float *tables);
+
+private:
+    Wavetable();
+    // Набор из амплитуд синусной и косинусной составляющих гармоник 1..harmonics
+    static void synthesize(const std::vector<double> &sines,
+                           const std::vector<double> &cosines,
+                           float *tables);
+
+    // Все таблицы подряд, у каждой дополнительная точка для интерполяции
+    std::vector<float> m_data;
+};
+
+#endif // WAVETABLE_H
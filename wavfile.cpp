@@ -0,0 +1,292 @@
+#include <cstring>
+#include <QtEndian>
+#include "wavfile.h"
+
+namespace {
+
+// Канонический заголовок: RIFF, fmt и заголовок блока data
+const int canonicalHeaderBytes = 44;
+// Заголовок блока RIFF (имя и размер)
+const int chunkHeaderBytes = 8;
+
+// Запись целых в порядке little-endian, как требует формат RIFF
+void putLE16(char *p, quint16 value)
+{
+    qToLittleEndian(value, p);
+}
+
+void putLE32(char *p, quint32 value)
+{
+    qToLittleEndian(value, p);
+}
+
+} // namespace
+
+WavFileWriter::WavFileWriter()
+    : m_container(Container::wav)
+    , m_format(RenderKernels::SampleFormat::float32)
+    , m_sampleRate(0)
+    , m_channels(1)
+    , m_sampleBytes(int(sizeof(float)))
+    , m_headerBytes(canonicalHeaderBytes)
+    , m_samplesWritten(0)
+{}
+
+WavFileWriter::~WavFileWriter()
+{
+    close();
+}
+
+bool WavFileWriter::open(const QString &fileName,
+                         int sampleRate,
+                         int channels,
+                         Container container,
+                         RenderKernels::SampleFormat format,
+                         int dataAlignment)
+{
+    close();
+    m_container = container;
+    m_format = format;
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_sampleBytes = (format == RenderKernels::SampleFormat::int16) ? 2 : 4;
+    m_samplesWritten = 0;
+    m_headerBytes = canonicalHeaderBytes;
+    if (dataAlignment > 0) {
+        // Между fmt и data помещается блок JUNK (минимум его заголовок)
+        const int minimum = canonicalHeaderBytes + chunkHeaderBytes;
+        m_headerBytes = (minimum + dataAlignment - 1) / dataAlignment * dataAlignment;
+    }
+    QIODevice::OpenMode mode = QIODevice::WriteOnly;
+    if (dataAlignment > 0) {
+        mode |= QIODevice::Unbuffered;
+    }
+    if (fileName == "-") {
+        if (!m_file.open(stdout, mode)) {
+            return false;
+        }
+    } else {
+        m_file.setFileName(fileName);
+        if (!m_file.open(mode | QIODevice::Truncate)) {
+            return false;
+        }
+    }
+    // Заголовок с нулевым размером данных, исправляется в close()
+    return (m_container == Container::raw) || writeHeader(0);
+}
+
+bool WavFileWriter::write(const float *samples, qint64 count)
+{
+    Q_ASSERT(m_format == RenderKernels::SampleFormat::float32);
+    return writeSamples(reinterpret_cast<const char *>(samples), count);
+}
+
+bool WavFileWriter::writeData(const char *data, qint64 bytes)
+{
+    return writeSamples(data, bytes / m_sampleBytes);
+}
+
+bool WavFileWriter::writeSamples(const char *data, qint64 count)
+{
+    if (!m_file.isOpen()) {
+        return false;
+    }
+    const qint64 bytes = count * m_sampleBytes;
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    // Перестановка байтов каждого сэмпла порциями через буфер на стеке
+    char le[4096];
+    for (qint64 done = 0; done < bytes;) {
+        const qint64 part = qMin<qint64>(sizeof(le), bytes - done);
+        for (qint64 i = 0; i < part; i += m_sampleBytes) {
+            for (int b = 0; b < m_sampleBytes; ++b) {
+                le[i + b] = data[done + i + m_sampleBytes - 1 - b];
+            }
+        }
+        if (m_file.write(le, part) != part) {
+            return false;
+        }
+        done += part;
+    }
+#else
+    if (m_file.write(data, bytes) != bytes) {
+        return false;
+    }
+#endif
+    m_samplesWritten += count;
+    return true;
+}
+
+bool WavFileWriter::close()
+{
+    if (!m_file.isOpen()) {
+        return true;
+    }
+    bool ok = true;
+    if (m_container == Container::wav && !m_file.isSequential()) {
+        const qint64 dataBytes = m_samplesWritten * m_sampleBytes;
+        ok = m_file.seek(0)
+             && writeHeader(quint32(qMin<qint64>(dataBytes, 0xFFFFFFFFll - m_headerBytes)));
+    }
+    m_file.close();
+    return ok;
+}
+
+QString WavFileWriter::errorString() const
+{
+    return m_file.errorString();
+}
+
+qint64 WavFileWriter::framesWritten() const
+{
+    return m_samplesWritten / qMax(m_channels, 1);
+}
+
+// Заголовок WAVE_FORMAT_PCM или WAVE_FORMAT_IEEE_FLOAT; при выравнивании данных
+// между fmt и data стоит блок JUNK, который читатели пропускают
+bool WavFileWriter::writeHeader(quint32 dataBytes)
+{
+    const bool isFloat = (m_format == RenderKernels::SampleFormat::float32);
+    const quint16 bitsPerSample = quint16(m_sampleBytes * 8);
+    const quint16 blockAlign = quint16(m_channels * m_sampleBytes);
+    QByteArray header(m_headerBytes, '\0');
+    char *p = header.data();
+    memcpy(p, "RIFF", 4);
+    putLE32(p + 4, quint32(m_headerBytes - chunkHeaderBytes) + dataBytes);
+    memcpy(p + 8, "WAVEfmt ", 8);
+    putLE32(p + 16, 16);
+    putLE16(p + 20, isFloat ? 3 : 1);
+    putLE16(p + 22, quint16(m_channels));
+    putLE32(p + 24, quint32(m_sampleRate));
+    putLE32(p + 28, quint32(m_sampleRate) * blockAlign);
+    putLE16(p + 32, blockAlign);
+    putLE16(p + 34, bitsPerSample);
+    int pos = 36;
+    if (m_headerBytes > canonicalHeaderBytes) {
+        memcpy(p + pos, "JUNK", 4);
+        putLE32(p + pos + 4, quint32(m_headerBytes - canonicalHeaderBytes - chunkHeaderBytes));
+        pos = m_headerBytes - chunkHeaderBytes;
+    }
+    memcpy(p + pos, "data", 4);
+    putLE32(p + pos + 4, dataBytes);
+    return m_file.write(header) == qint64(header.size());
+}
+
+WavFileReader::WavFileReader()
+    : m_sampleRate(0)
+    , m_channels(0)
+{}
+
+bool WavFileReader::load(const QString &fileName, QString *error)
+{
+    m_samples.clear();
+    auto fail = [&](const QString &message) {
+        if (error) {
+            *error = QString("%1: %2").arg(fileName, message);
+        }
+        return false;
+    };
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail(file.errorString());
+    }
+    const QByteArray bytes = file.readAll();
+    const uchar *data = reinterpret_cast<const uchar *>(bytes.constData());
+    const qint64 size = bytes.size();
+    if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0) {
+        return fail("not a WAV file");
+    }
+
+    // Блоки fmt и data в любом порядке, остальные пропускаются
+    int format = 0;
+    int bits = 0;
+    const uchar *samples = nullptr;
+    qint64 dataBytes = 0;
+    for (qint64 pos = 12; pos + chunkHeaderBytes <= size;) {
+        const uchar *chunk = data + pos;
+        const qint64 chunkBytes = qFromLittleEndian<quint32>(chunk + 4);
+        const qint64 available = qMin(chunkBytes, size - pos - chunkHeaderBytes);
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && available >= 16) {
+            format = qFromLittleEndian<quint16>(chunk + 8);
+            m_channels = qFromLittleEndian<quint16>(chunk + 10);
+            m_sampleRate = int(qFromLittleEndian<quint32>(chunk + 12));
+            bits = qFromLittleEndian<quint16>(chunk + 22);
+            if (format == 0xfffe && available >= 26) {
+                format = qFromLittleEndian<quint16>(chunk + 32); // Подформат из GUID
+            }
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            samples = chunk + chunkHeaderBytes;
+            dataBytes = available;
+        }
+        pos += chunkHeaderBytes + chunkBytes + (chunkBytes & 1); // Блоки выровнены на 2 байта
+    }
+    const bool pcm = (format == 1 && (bits == 8 || bits == 16 || bits == 24 || bits == 32));
+    const bool ieee = (format == 3 && (bits == 32 || bits == 64));
+    if (!pcm && !ieee) {
+        return fail(QString("unsupported sample format %1 (%2 bits)").arg(format).arg(bits));
+    }
+    if (m_channels <= 0 || m_sampleRate <= 0 || !samples) {
+        return fail("missing fmt or data chunk");
+    }
+
+    const int sampleBytes = bits / 8;
+    const qint64 count = dataBytes / sampleBytes / m_channels * m_channels;
+    m_samples.resize(int(count));
+    for (qint64 i = 0; i < count; ++i) {
+        const uchar *p = samples + i * sampleBytes;
+        float value = 0.0f;
+        if (ieee && bits == 32) {
+            const quint32 raw = qFromLittleEndian<quint32>(p);
+            std::memcpy(&value, &raw, sizeof(value));
+        } else if (ieee) {
+            const quint64 raw = qFromLittleEndian<quint64>(p);
+            double wide;
+            std::memcpy(&wide, &raw, sizeof(wide));
+            value = float(wide);
+        } else if (bits == 8) {
+            value = (int(p[0]) - 128) / 128.0f; // 8 бит - без знака
+        } else if (bits == 16) {
+            value = qint16(qFromLittleEndian<quint16>(p)) / 32768.0f;
+        } else if (bits == 24) {
+            const qint32 raw = qint32(quint32(p[0]) << 8 | quint32(p[1]) << 16 | quint32(p[2]) << 24);
+            value = float(raw / 2147483648.0);
+        } else {
+            value = float(qint32(qFromLittleEndian<quint32>(p)) / 2147483648.0);
+        }
+        m_samples[int(i)] = value;
+    }
+    return true;
+}
+
+int WavFileReader::sampleRate() const
+{
+    return m_sampleRate;
+}
+
+int WavFileReader::channels() const
+{
+    return m_channels;
+}
+
+qint64 WavFileReader::frames() const
+{
+    return m_channels > 0 ? m_samples.size() / m_channels : 0;
+}
+
+const QVector<float> &WavFileReader::samples() const
+{
+    return m_samples;
+}
+
+QVector<float> WavFileReader::mono() const
+{
+    const int frames = int(this->frames());
+    QVector<float> result(frames);
+    for (int i = 0; i < frames; ++i) {
+        float sum = 0.0f;
+        for (int c = 0; c < m_channels; ++c) {
+            sum += m_samples.at(i * m_channels + c);
+        }
+        result[i] = sum / m_channels;
+    }
+    return result;
+}
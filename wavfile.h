@@ -0,0 +1,72 @@
+#ifndef WAVFILE_H
+#define WAVFILE_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include "renderkernels.h" // Форматы сэмплов
+
+// Потоковая запись WAV (16/32-битные целые или 32-битный IEEE float) или "сырых"
+// сэмплов. Размеры в заголовке WAV дописываются при закрытии
+class WavFileWriter
+{
+public:
+    enum class Container : int { wav, raw };
+
+    WavFileWriter();
+    ~WavFileWriter();
+
+    // dataAlignment > 0 - данные WAV начинаются со смещения, кратного ему
+    // (заголовок дополняется блоком JUNK), а файл пишется без буфера QFile:
+    // крупные порции попадают на выровненные смещения файла
+    bool open(const QString &fileName,
+              int sampleRate,
+              int channels,
+              Container container,
+              RenderKernels::SampleFormat format = RenderKernels::SampleFormat::float32,
+              int dataAlignment = 0);
+    // Сэмплы float (только для формата float32)
+    bool write(const float *samples, qint64 count);
+    // Данные в формате файла (целые сэмплы), порядок байтов процессора
+    bool writeData(const char *data, qint64 bytes);
+    bool close();
+    QString errorString() const;
+    qint64 framesWritten() const;
+
+private:
+    bool writeHeader(quint32 dataBytes);
+    bool writeSamples(const char *data, qint64 count);
+
+    QFile m_file;
+    Container m_container;
+    RenderKernels::SampleFormat m_format;
+    int m_sampleRate;
+    int m_channels;
+    int m_sampleBytes; // Байт в сэмпле
+    int m_headerBytes; // Смещение данных в файле
+    qint64 m_samplesWritten;
+};
+
+// Чтение WAV целиком в память: целые 8/16/24/32 бит или IEEE float 32/64 бит,
+// в том числе WAVE_FORMAT_EXTENSIBLE. Сэмплы переводятся во float, кадры
+// чередуются. Для подготовки банков и сравнения результатов, не для потока звука
+class WavFileReader
+{
+public:
+    WavFileReader();
+
+    bool load(const QString &fileName, QString *error = nullptr);
+    int sampleRate() const;
+    int channels() const;
+    qint64 frames() const;
+    const QVector<float> &samples() const;
+    // Среднее по каналам
+    QVector<float> mono() const;
+
+private:
+    int m_sampleRate;
+    int m_channels;
+    QVector<float> m_samples;
+};
+
+#endif // WAVFILE_H